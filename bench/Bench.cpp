@@ -0,0 +1,114 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "Converter.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double getMilliseconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+// Returns the result of the stage, which is added with zero durations for the previous iterations, if it was not recorded before.
+StageResult& getStageResult(std::vector<StageResult>& stageResults, const std::string& name, uint32_t iteration)
+{
+    for (StageResult& stageResult : stageResults) {
+        if (stageResult.name == name) {
+            return stageResult;
+        }
+    }
+
+    StageResult stageResult;
+    stageResult.name = name;
+    stageResult.milliseconds.assign(iteration, 0.0);
+    stageResults.push_back(stageResult);
+
+    return stageResults.back();
+}
+
+}
+
+bool runBenchmark(std::vector<StageResult>& stageResults, const std::string& folder, const BenchOptions& benchOptions, ThreadPool& threadPool)
+{
+    stageResults.clear();
+
+    ConvertOptions convertOptions;
+    convertOptions.pngOptions = benchOptions.pngOptions;
+
+    // The stages are timed by the spans of the converter itself, so only spans of the conversion are recorded
+
+    enableTrace();
+
+    std::vector<StageTotal> stageTotals;
+    takeStageTotals(stageTotals);
+
+    for (uint32_t iteration = 0; iteration < benchOptions.iterationCount; iteration++) {
+        ConvertResult convertResult;
+
+        Clock::time_point begin = Clock::now();
+        if (!convertMaterial(convertResult, folder, convertOptions, threadPool)) {
+            return false;
+        }
+        double milliseconds = getMilliseconds(begin);
+
+        // The material span covers the whole conversion, which is timed as convert
+        takeStageTotals(stageTotals);
+        for (const StageTotal& stageTotal : stageTotals) {
+            if (stageTotal.stage == "material") {
+                continue;
+            }
+
+            getStageResult(stageResults, stageTotal.stage, iteration).milliseconds.push_back(stageTotal.milliseconds);
+        }
+        getStageResult(stageResults, "convert", iteration).milliseconds.push_back(milliseconds);
+
+        // Stages, which were recorded in previous iterations only, took no time
+        for (StageResult& stageResult : stageResults) {
+            stageResult.milliseconds.resize(iteration + 1, 0.0);
+        }
+
+        printf("Info: Finished iteration %u of %u\n", iteration + 1, benchOptions.iterationCount);
+    }
+
+    return true;
+}
+
+json getBenchReport(const std::vector<StageResult>& stageResults)
+{
+    json stages = json::array();
+
+    for (const StageResult& stageResult : stageResults) {
+        json stage = json::object();
+        stage["name"] = stageResult.name;
+        stage["milliseconds"] = stageResult.milliseconds;
+
+        std::vector<double> sorted = stageResult.milliseconds;
+        std::sort(sorted.begin(), sorted.end());
+
+        if (!sorted.empty()) {
+            double sum = 0.0;
+            for (double milliseconds : sorted) {
+                sum += milliseconds;
+            }
+
+            size_t middle = sorted.size() / 2;
+
+            stage["min"] = sorted.front();
+            stage["median"] = (sorted.size() % 2 == 1) ? sorted[middle] : 0.5 * (sorted[middle - 1] + sorted[middle]);
+            stage["mean"] = sum / static_cast<double>(sorted.size());
+            stage["max"] = sorted.back();
+        }
+
+        stages.push_back(stage);
+    }
+
+    return stages;
+}
@@ -0,0 +1,31 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Helper.h"
+#include "Png.h"
+
+class ThreadPool;
+
+struct BenchOptions {
+    uint32_t iterationCount = 5;
+    PngOptions pngOptions;
+};
+
+struct StageResult {
+    std::string name = "";
+    // Duration of each iteration
+    std::vector<double> milliseconds;
+};
+
+// Converts the material once per iteration and times its stages by the trace spans of the converter, e.g. scan, decode, pack, encode,
+// write and json, summed over the spans of each stage. Convert is the wall time of the whole conversion. The outputs are written to the current folder.
+bool runBenchmark(std::vector<StageResult>& stageResults, const std::string& folder, const BenchOptions& benchOptions, ThreadPool& threadPool);
+
+// Returns the durations and their minimum, median, mean and maximum for each stage.
+json getBenchReport(const std::vector<StageResult>& stageResults);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,292 @@
+#include "Generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+#include "ThreadPool.h"
+
+namespace {
+
+const float PI = 3.14159265358979f;
+
+uint32_t hashValues(uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t hash = a * 0x8DA6B343u ^ b * 0xD8163841u ^ c * 0xCB1AB31Fu;
+    hash ^= hash >> 13;
+    hash *= 0x5BD1E995u;
+    hash ^= hash >> 15;
+
+    return hash;
+}
+
+// Returns a value in [-1, 1], which changes smoothly over the image. Each layer has its own phases and frequencies.
+float getPattern(float u, float v, uint32_t layer, uint32_t seed)
+{
+    uint32_t hash = hashValues(layer, seed, 0x9E3779B9u);
+
+    float phase = static_cast<float>(hash & 0xFFFF) / 65536.0f * 2.0f * PI;
+    float frequencyU = 3.0f + static_cast<float>((hash >> 16) & 7);
+    float frequencyV = 2.0f + static_cast<float>((hash >> 19) & 7);
+
+    float warp = 0.3f * std::sin(2.0f * PI * frequencyV * v + phase);
+
+    return 0.65f * std::sin(2.0f * PI * frequencyU * (u + warp) + phase) + 0.35f * std::sin(2.0f * PI * 17.0f * (u + v) + 2.0f * phase);
+}
+
+// Returns small noise in [-amplitude, amplitude].
+float getNoise(uint32_t x, uint32_t y, uint32_t layer, uint32_t seed, float amplitude)
+{
+    uint32_t hash = hashValues(x, y, seed * 8 + layer);
+
+    return (static_cast<float>(hash & 0xFF) / 127.5f - 1.0f) * amplitude;
+}
+
+uint8_t toByte(float value)
+{
+    return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 255.0f) + 0.5f);
+}
+
+uint32_t getChannelCount(ImageRole imageRole)
+{
+    switch (imageRole) {
+        case IMAGE_ROLE_BASE_COLOR:
+        case IMAGE_ROLE_NORMAL:
+        case IMAGE_ROLE_EMISSIVE:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+}
+
+bool parseImageRoles(std::vector<ImageRole>& imageRoles, const std::string& list)
+{
+    imageRoles.clear();
+
+    if (list == "all") {
+        imageRoles = { IMAGE_ROLE_BASE_COLOR, IMAGE_ROLE_OPACITY, IMAGE_ROLE_METALLIC, IMAGE_ROLE_ROUGHNESS, IMAGE_ROLE_OCCLUSION, IMAGE_ROLE_NORMAL, IMAGE_ROLE_EMISSIVE };
+
+        return true;
+    }
+
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        ImageRole imageRole = IMAGE_ROLE_UNKNOWN;
+        if (name == "color") {
+            imageRole = IMAGE_ROLE_BASE_COLOR;
+        } else if (name == "opacity") {
+            imageRole = IMAGE_ROLE_OPACITY;
+        } else if (name == "metallic") {
+            imageRole = IMAGE_ROLE_METALLIC;
+        } else if (name == "roughness") {
+            imageRole = IMAGE_ROLE_ROUGHNESS;
+        } else if (name == "occlusion") {
+            imageRole = IMAGE_ROLE_OCCLUSION;
+        } else if (name == "normal") {
+            imageRole = IMAGE_ROLE_NORMAL;
+        } else if (name == "emissive") {
+            imageRole = IMAGE_ROLE_EMISSIVE;
+        } else {
+            return false;
+        }
+
+        if (std::find(imageRoles.begin(), imageRoles.end(), imageRole) == imageRoles.end()) {
+            imageRoles.push_back(imageRole);
+        }
+    }
+
+    return !imageRoles.empty();
+}
+
+bool parseNamingConvention(NamingConvention& namingConvention, const std::string& name)
+{
+    if (name == "short") {
+        namingConvention = NAMING_CONVENTION_SHORT;
+    } else if (name == "long") {
+        namingConvention = NAMING_CONVENTION_LONG;
+    } else if (name == "resolution") {
+        namingConvention = NAMING_CONVENTION_RESOLUTION;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+std::string getSyntheticFilename(const std::string& stem, ImageRole imageRole, const GeneratorOptions& generatorOptions)
+{
+    uint32_t size = std::max(generatorOptions.width, generatorOptions.height);
+    std::string resolution = std::to_string(std::max((size + 512) / 1024, 1u)) + "k";
+
+    const char* name = "";
+
+    switch (imageRole) {
+        case IMAGE_ROLE_BASE_COLOR:
+            name = (generatorOptions.namingConvention == NAMING_CONVENTION_SHORT) ? "Color" : (generatorOptions.namingConvention == NAMING_CONVENTION_LONG) ? "BaseColor" : "Base_Color";
+            break;
+        case IMAGE_ROLE_OPACITY:
+            name = "Opacity";
+            break;
+        case IMAGE_ROLE_METALLIC:
+            name = "Metallic";
+            break;
+        case IMAGE_ROLE_ROUGHNESS:
+            if (generatorOptions.namingConvention == NAMING_CONVENTION_RESOLUTION) {
+                return stem + "_rough_" + resolution + ".png";
+            }
+            name = "Roughness";
+            break;
+        case IMAGE_ROLE_OCCLUSION:
+            if (generatorOptions.namingConvention == NAMING_CONVENTION_RESOLUTION) {
+                return stem + "_ao_" + resolution + ".png";
+            }
+            name = (generatorOptions.namingConvention == NAMING_CONVENTION_SHORT) ? "AO" : "AmbientOcclusion";
+            break;
+        case IMAGE_ROLE_NORMAL:
+            if (generatorOptions.namingConvention == NAMING_CONVENTION_RESOLUTION) {
+                return stem + "_nor_gl_" + resolution + ".png";
+            }
+            name = "Normal";
+            break;
+        case IMAGE_ROLE_EMISSIVE:
+            name = "Emissive";
+            break;
+        default:
+            break;
+    }
+
+    return stem + "_" + name + ".png";
+}
+
+bool generateImage(ImageDataResource& image, ImageRole imageRole, const GeneratorOptions& generatorOptions)
+{
+    if (generatorOptions.width == 0 || generatorOptions.height == 0) {
+        return false;
+    }
+
+    image.width = generatorOptions.width;
+    image.height = generatorOptions.height;
+    image.channels = getChannelCount(imageRole);
+    if (!image.pixels.allocate(static_cast<size_t>(image.width) * image.height * image.channels)) {
+        return false;
+    }
+
+    // Every role has its own layers, so the images of a material differ from each other
+
+    uint32_t layer = static_cast<uint32_t>(imageRole) * 4;
+    uint32_t seed = generatorOptions.seed;
+
+    float stepU = 1.0f / static_cast<float>(image.width);
+    float stepV = 1.0f / static_cast<float>(image.height);
+
+    for (uint32_t y = 0; y < image.height; y++) {
+        float v = static_cast<float>(y) * stepV;
+
+        uint8_t* row = image.pixels.data() + static_cast<size_t>(y) * image.width * image.channels;
+
+        for (uint32_t x = 0; x < image.width; x++) {
+            float u = static_cast<float>(x) * stepU;
+
+            uint8_t* pixel = row + x * image.channels;
+
+            switch (imageRole) {
+                case IMAGE_ROLE_BASE_COLOR:
+                {
+                    float base = getPattern(u, v, layer, seed);
+                    for (uint32_t channel = 0; channel < 3; channel++) {
+                        float tint = getPattern(u, v, layer + 1 + channel, seed);
+                        pixel[channel] = toByte(110.0f + 60.0f * base + 25.0f * tint - 20.0f * channel + getNoise(x, y, layer + channel, seed, 6.0f));
+                    }
+                    break;
+                }
+                case IMAGE_ROLE_OPACITY:
+                {
+                    // Mostly opaque with soft edged holes
+                    float value = getPattern(u, v, layer, seed);
+                    pixel[0] = (value > -0.5f) ? 255 : toByte(255.0f * (value + 1.0f) * 2.0f);
+                    break;
+                }
+                case IMAGE_ROLE_METALLIC:
+                {
+                    // Mostly either metal or not with short transitions
+                    float value = getPattern(u, v, layer, seed);
+                    pixel[0] = toByte(127.5f + 127.5f * std::max(std::min(value * 4.0f, 1.0f), -1.0f));
+                    break;
+                }
+                case IMAGE_ROLE_NORMAL:
+                {
+                    // Vectors of a height field, which are taken from its differences
+                    float height = getPattern(u, v, layer, seed);
+                    float dx = (getPattern(u + stepU, v, layer, seed) - height) / stepU;
+                    float dy = (getPattern(u, v + stepV, layer, seed) - height) / stepV;
+
+                    float vector[3] = { -dx * 0.01f, -dy * 0.01f, 1.0f };
+                    float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+                    for (uint32_t channel = 0; channel < 3; channel++) {
+                        pixel[channel] = toByte((vector[channel] / length * 0.5f + 0.5f) * 255.0f + getNoise(x, y, layer + channel, seed, 2.0f));
+                    }
+                    break;
+                }
+                case IMAGE_ROLE_EMISSIVE:
+                {
+                    // Mostly black with a few glowing spots
+                    float value = getPattern(u, v, layer, seed);
+                    for (uint32_t channel = 0; channel < 3; channel++) {
+                        pixel[channel] = (value > 0.8f) ? toByte((value - 0.8f) * 5.0f * (255.0f - 60.0f * channel)) : 0;
+                    }
+                    break;
+                }
+                case IMAGE_ROLE_OCCLUSION:
+                {
+                    float value = getPattern(u, v, layer, seed);
+                    pixel[0] = toByte(215.0f + 40.0f * value + getNoise(x, y, layer, seed, 4.0f));
+                    break;
+                }
+                default:
+                {
+                    float value = getPattern(u, v, layer, seed);
+                    pixel[0] = toByte(127.5f + 100.0f * value + getNoise(x, y, layer, seed, 8.0f));
+                    break;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool generateMaterial(const std::string& folder, const std::string& stem, const GeneratorOptions& generatorOptions, ThreadPool& threadPool)
+{
+    std::error_code errorCode;
+    fs::create_directories(folder, errorCode);
+    if (errorCode) {
+        printf("Error: Could not create folder '%s'\n", folder.c_str());
+
+        return false;
+    }
+
+    for (ImageRole imageRole : generatorOptions.imageRoles) {
+        std::string filename = folder + "/" + getSyntheticFilename(stem, imageRole, generatorOptions);
+
+        ImageDataResource image;
+        if (!generateImage(image, imageRole, generatorOptions)) {
+            printf("Error: Could not generate image '%s'\n", filename.c_str());
+
+            return false;
+        }
+
+        if (!savePng(filename, image.pixels.data(), image.width, image.height, image.channels, generatorOptions.pngOptions, threadPool)) {
+            printf("Error: Could not save image '%s'\n", filename.c_str());
+
+            return false;
+        }
+
+        printf("Info: Generated '%s'\n", filename.c_str());
+    }
+
+    return true;
+}
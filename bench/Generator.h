@@ -0,0 +1,42 @@
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Helper.h"
+#include "Png.h"
+
+class ThreadPool;
+
+enum NamingConvention {
+    NAMING_CONVENTION_SHORT,
+    NAMING_CONVENTION_LONG,
+    NAMING_CONVENTION_RESOLUTION
+};
+
+struct GeneratorOptions {
+    uint32_t width = 2048;
+    uint32_t height = 2048;
+    std::vector<ImageRole> imageRoles = { IMAGE_ROLE_BASE_COLOR, IMAGE_ROLE_METALLIC, IMAGE_ROLE_ROUGHNESS, IMAGE_ROLE_OCCLUSION, IMAGE_ROLE_NORMAL };
+    NamingConvention namingConvention = NAMING_CONVENTION_SHORT;
+    uint32_t seed = 1;
+    PngOptions pngOptions;
+};
+
+bool parseImageRoles(std::vector<ImageRole>& imageRoles, const std::string& list);
+
+bool parseNamingConvention(NamingConvention& namingConvention, const std::string& name);
+
+// Short is 'Stem_Color.png', long is 'Stem_BaseColor.png' and resolution is 'Stem_Base_Color.png' or 'Stem_rough_2k.png'.
+std::string getSyntheticFilename(const std::string& stem, ImageRole imageRole, const GeneratorOptions& generatorOptions);
+
+// Smooth patterns with low noise, so the images compress like scanned materials and no image is constant.
+// The pixels only depend on the size, the role and the seed.
+bool generateImage(ImageDataResource& image, ImageRole imageRole, const GeneratorOptions& generatorOptions);
+
+// Writes one material folder with an image for every role of the options.
+bool generateMaterial(const std::string& folder, const std::string& stem, const GeneratorOptions& generatorOptions, ThreadPool& threadPool);
+
+#endif /* GENERATOR_H_ */
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <stb_image_write.h>
+
+#include "Bench.h"
+#include "Generator.h"
+#include "Helper.h"
+#include "ThreadPool.h"
+
+int main(int argc, char* argv[])
+{
+    GeneratorOptions generatorOptions;
+    BenchOptions benchOptions;
+
+    uint32_t workerCount = 0;
+    std::string dataFolder = "bench_data";
+    std::string reportPath = "bench.json";
+
+    std::string roleList = "color,metallic,roughness,occlusion,normal";
+    std::string namingName = "short";
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0) {
+            printf("Usage: pbr2gltf2_bench [-w 2048 -h 2048 -c color,metallic,roughness,occlusion,normal --naming short --seed 1 -i 5 -j 0 -z 6 --png-encoder deflate -d bench_data -o bench.json]\n");
+
+            return 0;
+        } else if (strcmp(argv[i], "-w") == 0 && (i + 1 < argc)) {
+            generatorOptions.width = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "-h") == 0 && (i + 1 < argc)) {
+            generatorOptions.height = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "-c") == 0 && (i + 1 < argc)) {
+            roleList = argv[i + 1];
+        } else if (strcmp(argv[i], "--naming") == 0 && (i + 1 < argc)) {
+            namingName = argv[i + 1];
+        } else if (strcmp(argv[i], "--seed") == 0 && (i + 1 < argc)) {
+            generatorOptions.seed = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "-i") == 0 && (i + 1 < argc)) {
+            benchOptions.iterationCount = std::max(static_cast<uint32_t>(std::stoul(argv[i + 1])), 1u);
+        } else if (strcmp(argv[i], "-j") == 0 && (i + 1 < argc)) {
+            workerCount = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "-z") == 0 && (i + 1 < argc)) {
+            benchOptions.pngOptions.compressionLevel = std::min(std::max(std::stoi(argv[i + 1]), 0), 9);
+        } else if (strcmp(argv[i], "--png-encoder") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "deflate") == 0) {
+                benchOptions.pngOptions.pngEncoder = PNG_ENCODER_DEFLATE;
+            } else if (strcmp(argv[i + 1], "stb") == 0) {
+                benchOptions.pngOptions.pngEncoder = PNG_ENCODER_STB;
+            }
+        } else if (strcmp(argv[i], "-d") == 0 && (i + 1 < argc)) {
+            dataFolder = argv[i + 1];
+        } else if (strcmp(argv[i], "-o") == 0 && (i + 1 < argc)) {
+            reportPath = argv[i + 1];
+        }
+    }
+
+    if (!parseImageRoles(generatorOptions.imageRoles, roleList)) {
+        printf("Error: Unknown channel set '%s'\n", roleList.c_str());
+
+        return -1;
+    }
+
+    if (!parseNamingConvention(generatorOptions.namingConvention, namingName)) {
+        printf("Error: Unknown naming convention '%s'\n", namingName.c_str());
+
+        return -1;
+    }
+
+    // stb_image_write only supports a global compression level
+
+    stbi_write_png_compression_level = std::max(benchOptions.pngOptions.compressionLevel, 1);
+
+    //
+
+    std::error_code errorCode;
+    std::string materialFolder = fs::absolute(fs::path(dataFolder) / "material", errorCode).generic_string();
+    std::string outputFolder = fs::absolute(fs::path(dataFolder) / "output", errorCode).generic_string();
+    reportPath = fs::absolute(reportPath, errorCode).generic_string();
+
+    ThreadPool threadPool(workerCount);
+
+    // The generated images are written with the fastest compression, as they are only the input
+
+    fs::remove_all(materialFolder, errorCode);
+
+    GeneratorOptions inputOptions = generatorOptions;
+    inputOptions.pngOptions.compressionLevel = 1;
+    if (!generateMaterial(materialFolder, "Synthetic", inputOptions, threadPool)) {
+        return -1;
+    }
+
+    fs::create_directories(outputFolder, errorCode);
+    fs::current_path(outputFolder, errorCode);
+    if (errorCode) {
+        printf("Error: Could not open folder '%s'\n", outputFolder.c_str());
+
+        return -1;
+    }
+
+    std::vector<StageResult> stageResults;
+    if (!runBenchmark(stageResults, materialFolder, benchOptions, threadPool)) {
+        return -1;
+    }
+
+    //
+
+    json options = json::object();
+    options["width"] = generatorOptions.width;
+    options["height"] = generatorOptions.height;
+    options["channels"] = roleList;
+    options["naming"] = namingName;
+    options["seed"] = generatorOptions.seed;
+    options["iterations"] = benchOptions.iterationCount;
+    options["workers"] = threadPool.getWorkerCount();
+    options["compressionLevel"] = benchOptions.pngOptions.compressionLevel;
+    options["pngEncoder"] = (benchOptions.pngOptions.pngEncoder == PNG_ENCODER_STB) ? "stb" : "deflate";
+
+    json report = json::object();
+    report["options"] = options;
+    report["stages"] = getBenchReport(stageResults);
+
+    for (const json& stage : report["stages"]) {
+        printf("Info: Stage '%s' median %.3f ms\n", stage["name"].get<std::string>().c_str(), stage["median"].get<double>());
+    }
+
+    if (!saveFile(report.dump(3), reportPath)) {
+        printf("Error: Could not save '%s'\n", reportPath.c_str());
+
+        return -1;
+    }
+
+    printf("Success: Saved '%s'\n", reportPath.c_str());
+
+    return 0;
+}
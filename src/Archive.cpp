@@ -0,0 +1,346 @@
+#include "Archive.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "Deflate.h"
+#include "Helper.h"
+
+namespace {
+
+const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+const uint32_t END_SIGNATURE = 0x06054b50;
+const uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+
+const size_t LOCAL_HEADER_SIZE = 30;
+const size_t CENTRAL_HEADER_SIZE = 46;
+const size_t END_SIZE = 22;
+const size_t ZIP64_END_SIZE = 56;
+const size_t ZIP64_LOCATOR_SIZE = 20;
+
+// The end record is followed by a comment of at most 65535 bytes
+const size_t MAX_END_SEARCH = END_SIZE + 65535;
+
+const size_t READ_SIZE = 65536;
+
+// Deflate encodes at most 258 bytes by a match of 2 bits, so no member inflates to more than 1032 times its compressed size
+const uint64_t MAX_DEFLATE_RATIO = 1032;
+
+uint16_t readUint16(const uint8_t* data)
+{
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t readUint32(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+uint64_t readUint64(const uint8_t* data)
+{
+    return static_cast<uint64_t>(readUint32(data)) | (static_cast<uint64_t>(readUint32(data + 4)) << 32);
+}
+
+bool seekFile(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+bool getFileSize(uint64_t& fileSize, FILE* file)
+{
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    __int64 position = _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    off_t position = ftello(file);
+#endif
+    if (position < 0) {
+        return false;
+    }
+
+    fileSize = static_cast<uint64_t>(position);
+
+    return true;
+}
+
+bool readAt(FILE* file, uint64_t offset, uint8_t* data, size_t size)
+{
+    return seekFile(file, offset) && fread(data, 1, size, file) == size;
+}
+
+// Replaces the sizes and the offset, which do not fit into 32 bits, by the values of the ZIP64 extra field.
+bool readZip64Extra(ArchiveMember& member, const uint8_t* extra, size_t extraSize, bool hasSize, bool hasCompressedSize, bool hasOffset)
+{
+    size_t position = 0;
+    while (position + 4 <= extraSize) {
+        uint16_t id = readUint16(extra + position);
+        uint16_t size = readUint16(extra + position + 2);
+        position += 4;
+        if (position + size > extraSize) {
+            return false;
+        }
+
+        if (id == 0x0001) {
+            const uint8_t* field = extra + position;
+            const uint8_t* end = field + size;
+            for (uint64_t* value : { hasSize ? &member.size : nullptr, hasCompressedSize ? &member.compressedSize : nullptr, hasOffset ? &member.localHeaderOffset : nullptr }) {
+                if (!value) {
+                    continue;
+                }
+                if (field + 8 > end) {
+                    return false;
+                }
+
+                *value = readUint64(field);
+                field += 8;
+            }
+
+            return true;
+        }
+
+        position += size;
+    }
+
+    return !hasSize && !hasCompressedSize && !hasOffset;
+}
+
+// A corrupt or crafted central directory can claim any size, which would be allocated before the member is inflated.
+bool isPlausibleSize(const ArchiveMember& member)
+{
+    if (member.method == 0) {
+        // Encrypted members have a header in front of their data
+        return member.size <= member.compressedSize;
+    }
+
+    return member.size / MAX_DEFLATE_RATIO <= member.compressedSize;
+}
+
+}
+
+bool ZipArchive::open(std::string& error, const std::string& filename)
+{
+    this->filename = filename;
+    members.clear();
+
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        error = "Could not open archive '" + filename + "'";
+
+        return false;
+    }
+
+    // The end record is searched backwards from the end of the file, as it can be followed by a comment
+
+    uint64_t fileSize = 0;
+    if (!getFileSize(fileSize, file) || fileSize < END_SIZE) {
+        fclose(file);
+        error = "Could not read archive '" + filename + "'";
+
+        return false;
+    }
+
+    size_t tailSize = static_cast<size_t>(std::min<uint64_t>(fileSize, MAX_END_SEARCH));
+    uint64_t tailOffset = fileSize - tailSize;
+
+    std::vector<uint8_t> tail(tailSize);
+    if (!readAt(file, tailOffset, tail.data(), tail.size())) {
+        fclose(file);
+        error = "Could not read archive '" + filename + "'";
+
+        return false;
+    }
+
+    size_t endPosition = tailSize - END_SIZE + 1;
+    while (endPosition > 0 && readUint32(tail.data() + endPosition - 1) != END_SIGNATURE) {
+        endPosition--;
+    }
+    if (endPosition == 0) {
+        fclose(file);
+        error = "Could not find the central directory of archive '" + filename + "'";
+
+        return false;
+    }
+    endPosition--;
+
+    const uint8_t* end = tail.data() + endPosition;
+    uint64_t entryCount = readUint16(end + 10);
+    uint64_t directorySize = readUint32(end + 12);
+    uint64_t directoryOffset = readUint32(end + 16);
+
+    // ZIP64 archives have a locator of their own end record in front of the end record
+
+    uint64_t endOffset = tailOffset + endPosition;
+    if (endOffset >= ZIP64_LOCATOR_SIZE) {
+        uint8_t locator[ZIP64_LOCATOR_SIZE];
+        if (readAt(file, endOffset - ZIP64_LOCATOR_SIZE, locator, sizeof(locator)) && readUint32(locator) == ZIP64_LOCATOR_SIGNATURE) {
+            uint8_t zip64End[ZIP64_END_SIZE];
+            if (!readAt(file, readUint64(locator + 8), zip64End, sizeof(zip64End)) || readUint32(zip64End) != ZIP64_END_SIGNATURE) {
+                fclose(file);
+                error = "Could not read the ZIP64 end record of archive '" + filename + "'";
+
+                return false;
+            }
+
+            entryCount = readUint64(zip64End + 32);
+            directorySize = readUint64(zip64End + 40);
+            directoryOffset = readUint64(zip64End + 48);
+        }
+    }
+
+    if (directoryOffset > fileSize || directorySize > fileSize - directoryOffset) {
+        fclose(file);
+        error = "Invalid central directory in archive '" + filename + "'";
+
+        return false;
+    }
+
+    std::vector<uint8_t> directory(static_cast<size_t>(directorySize));
+    bool directoryRead = directory.empty() || readAt(file, directoryOffset, directory.data(), directory.size());
+    fclose(file);
+
+    if (!directoryRead) {
+        error = "Could not read the central directory of archive '" + filename + "'";
+
+        return false;
+    }
+
+    //
+
+    size_t position = 0;
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (position + CENTRAL_HEADER_SIZE > directory.size() || readUint32(directory.data() + position) != CENTRAL_HEADER_SIGNATURE) {
+            error = "Invalid central directory in archive '" + filename + "'";
+
+            return false;
+        }
+
+        const uint8_t* header = directory.data() + position;
+        size_t nameSize = readUint16(header + 28);
+        size_t extraSize = readUint16(header + 30);
+        size_t commentSize = readUint16(header + 32);
+        if (position + CENTRAL_HEADER_SIZE + nameSize + extraSize + commentSize > directory.size()) {
+            error = "Invalid central directory in archive '" + filename + "'";
+
+            return false;
+        }
+
+        ArchiveMember member;
+        member.flags = readUint16(header + 8);
+        member.method = readUint16(header + 10);
+        member.crc32 = readUint32(header + 16);
+        member.compressedSize = readUint32(header + 20);
+        member.size = readUint32(header + 24);
+        member.localHeaderOffset = readUint32(header + 42);
+        member.name.assign(reinterpret_cast<const char*>(header + CENTRAL_HEADER_SIZE), nameSize);
+
+        bool hasSize = member.size == 0xFFFFFFFF;
+        bool hasCompressedSize = member.compressedSize == 0xFFFFFFFF;
+        bool hasOffset = member.localHeaderOffset == 0xFFFFFFFF;
+        if ((hasSize || hasCompressedSize || hasOffset) && !readZip64Extra(member, header + CENTRAL_HEADER_SIZE + nameSize, extraSize, hasSize, hasCompressedSize, hasOffset)) {
+            error = "Invalid ZIP64 field of '" + member.name + "' in archive '" + filename + "'";
+
+            return false;
+        }
+
+        if (member.compressedSize > fileSize || member.localHeaderOffset > fileSize - member.compressedSize || !isPlausibleSize(member)) {
+            error = "Invalid size of '" + member.name + "' in archive '" + filename + "'";
+
+            return false;
+        }
+
+        position += CENTRAL_HEADER_SIZE + nameSize + extraSize + commentSize;
+
+        if (!member.name.empty() && member.name.back() != '/' && member.name.back() != '\\') {
+            members.push_back(member);
+        }
+    }
+
+    return true;
+}
+
+bool ZipArchive::readMember(std::vector<uint8_t>& data, std::string& error, const ArchiveMember& member, uint64_t limit) const
+{
+    data.clear();
+
+    // Encrypted members can not be read
+    if ((member.flags & 0x0001) != 0 || (member.method != 0 && member.method != 8)) {
+        error = "Unsupported compression of '" + member.name + "' in archive '" + filename + "'";
+
+        return false;
+    }
+
+    if (!isPlausibleSize(member)) {
+        error = "Invalid size of '" + member.name + "' in archive '" + filename + "'";
+
+        return false;
+    }
+
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        error = "Could not open archive '" + filename + "'";
+
+        return false;
+    }
+
+    // The local header can have another extra field than the central directory, so the data offset is read from it
+
+    uint8_t header[LOCAL_HEADER_SIZE];
+    if (!readAt(file, member.localHeaderOffset, header, sizeof(header)) || readUint32(header) != LOCAL_HEADER_SIGNATURE ||
+        !seekFile(file, member.localHeaderOffset + LOCAL_HEADER_SIZE + readUint16(header + 26) + readUint16(header + 28))) {
+        fclose(file);
+        error = "Could not read '" + member.name + "' in archive '" + filename + "'";
+
+        return false;
+    }
+
+    uint64_t size = std::min(member.size, limit);
+    data.resize(static_cast<size_t>(size));
+
+    bool result = true;
+    if (member.method == 0) {
+        result = data.empty() || fread(data.data(), 1, data.size(), file) == data.size();
+    } else {
+        uint64_t remaining = member.compressedSize;
+        Inflater inflater([file, &remaining](uint8_t* input, size_t inputSize) {
+            size_t readSize = static_cast<size_t>(std::min<uint64_t>(std::min<uint64_t>(remaining, inputSize), READ_SIZE));
+            size_t readCount = (readSize > 0) ? fread(input, 1, readSize, file) : 0;
+            remaining -= readCount;
+
+            return readCount;
+        }, false);
+
+        result = data.empty() || inflater.read(data.data(), data.size());
+    }
+
+    fclose(file);
+
+    // Only complete members are checked
+    if (result && size == member.size) {
+        result = updateCrc32(0, data.data(), data.size()) == member.crc32;
+    }
+
+    if (!result) {
+        data.clear();
+        error = "Could not inflate '" + member.name + "' in archive '" + filename + "'";
+
+        return false;
+    }
+
+    return true;
+}
+
+bool isArchivePath(const std::string& path)
+{
+    return path.size() >= 4 && toLowercase(path.substr(path.size() - 4)) == ".zip";
+}
@@ -0,0 +1,51 @@
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// File in a ZIP archive as listed by its central directory.
+struct ArchiveMember {
+    std::string name = "";
+    // 0 for stored and 8 for deflated members
+    uint16_t method = 0;
+    uint16_t flags = 0;
+    uint32_t crc32 = 0;
+    uint64_t compressedSize = 0;
+    uint64_t size = 0;
+    uint64_t localHeaderOffset = 0;
+};
+
+// ZIP archive, which members are read without extracting the archive. Only the central directory is read, when it is opened.
+// The members are read by each call on its own file handle, so several members are inflated concurrently.
+class ZipArchive {
+public:
+
+    // Lists the members, also of ZIP64 archives. Folders are left out. Members, which claim a larger size than their compressed
+    // data can inflate to, fail the archive.
+    bool open(std::string& error, const std::string& filename);
+
+    const std::string& getFilename() const
+    {
+        return filename;
+    }
+
+    const std::vector<ArchiveMember>& getMembers() const
+    {
+        return members;
+    }
+
+    // Inflates a member and checks its CRC-32. Its size is checked, before it is allocated. With a limit, only the first bytes are inflated e.g. to read an image header.
+    bool readMember(std::vector<uint8_t>& data, std::string& error, const ArchiveMember& member, uint64_t limit = UINT64_MAX) const;
+
+private:
+
+    std::string filename = "";
+    std::vector<ArchiveMember> members;
+};
+
+// Paths ending with ".zip" in any case are read as archives instead of folders.
+bool isArchivePath(const std::string& path);
+
+#endif /* ARCHIVE_H_ */
@@ -0,0 +1,363 @@
+#include "Batch.h"
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <set>
+
+#include "Archive.h"
+#include "Classifier.h"
+#include "Helper.h"
+#include "MemoryBudget.h"
+#include "PixelBuffer.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+
+// Lists the central directory only, so the archive is not inflated.
+bool hasArchiveImages(const std::string& filename)
+{
+    ZipArchive zipArchive;
+    std::string error;
+    if (!zipArchive.open(error, filename)) {
+        printf("Warning: Skipping archive '%s': %s\n", filename.c_str(), error.c_str());
+
+        return false;
+    }
+
+    for (const ArchiveMember& member : zipArchive.getMembers()) {
+        DecomposedPath decomposedPath;
+        decomposePath(decomposedPath, member.name);
+
+        std::string lowercaseExtension = toLowercase(decomposedPath.extension);
+        if (!(lowercaseExtension == ".png" || lowercaseExtension == ".jpg" || lowercaseExtension == ".jpeg")) {
+            continue;
+        }
+
+        ImageClass imageClass;
+        if (classifyImage(imageClass, member.name)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Path of a folder, which is absolute and has no trailing separator, so the paths of folders can be compared.
+fs::path getFolderPath(const std::string& folder)
+{
+    std::error_code errorCode;
+    fs::path folderPath = fs::absolute(folder, errorCode).lexically_normal();
+    if (!folderPath.has_filename()) {
+        folderPath = folderPath.parent_path();
+    }
+
+    return folderPath;
+}
+
+// Mirrors the path of each material folder below the root folder into the output folder, so materials with the same stem
+// in different folders do not overwrite each other. Without a root folder, the folders are mirrored below their common parent,
+// so a single folder is saved directly into the output folder. An archive is mirrored as a folder named after its stem.
+void planOutputFolders(std::vector<std::string>& outputFolders, const std::vector<std::string>& folders, const std::string& rootFolder, const std::string& outputFolder)
+{
+    std::vector<fs::path> folderPaths;
+    for (const std::string& folder : folders) {
+        folderPaths.push_back(getFolderPath(folder));
+    }
+
+    fs::path rootPath;
+    if (!rootFolder.empty()) {
+        rootPath = getFolderPath(rootFolder);
+    } else if (!folderPaths.empty()) {
+        rootPath = folderPaths[0];
+        for (const fs::path& folderPath : folderPaths) {
+            fs::path commonPath;
+            for (auto it = rootPath.begin(), other = folderPath.begin(); it != rootPath.end() && other != folderPath.end() && *it == *other; ++it, ++other) {
+                commonPath /= *it;
+            }
+            rootPath = commonPath;
+        }
+    }
+
+    outputFolders.clear();
+    for (size_t i = 0; i < folderPaths.size(); i++) {
+        fs::path relativePath = folderPaths[i].lexically_relative(rootPath);
+        if (relativePath.empty() || relativePath == ".") {
+            outputFolders.push_back(outputFolder);
+
+            continue;
+        }
+
+        // The archive file itself can be in the way of the output folder, e.g. when the output folder is the root folder
+        if (isArchivePath(folders[i])) {
+            relativePath.replace_extension();
+        }
+
+        outputFolders.push_back((fs::path(outputFolder) / relativePath).generic_string());
+    }
+}
+
+}
+
+bool gatherMaterialFolders(std::vector<std::string>& folders, const std::string& root)
+{
+    std::error_code errorCode;
+    if (!fs::is_directory(root, errorCode)) {
+        printf("Error: Could not open folder '%s'\n", root.c_str());
+
+        return false;
+    }
+
+    std::set<std::string> materialFolders;
+
+    for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, errorCode); !errorCode && it != fs::recursive_directory_iterator(); it.increment(errorCode)) {
+        // An entry, which can not be inspected e.g. a broken symlink, is skipped and does not end the scan
+        std::error_code entryErrorCode;
+        if (!it->is_regular_file(entryErrorCode)) {
+            continue;
+        }
+
+        DecomposedPath decomposedPath;
+        decomposePath(decomposedPath, it->path().generic_string());
+
+        // An archive is one material, if any of its members is classified
+        if (isArchivePath(it->path().generic_string())) {
+            if (hasArchiveImages(it->path().generic_string())) {
+                materialFolders.insert(it->path().generic_string());
+            }
+
+            continue;
+        }
+
+        std::string lowercaseExtension = toLowercase(decomposedPath.extension);
+        if (!(lowercaseExtension == ".png" || lowercaseExtension == ".jpg" || lowercaseExtension == ".jpeg")) {
+            continue;
+        }
+
+        ImageClass imageClass;
+        if (classifyImage(imageClass, it->path().generic_string())) {
+            materialFolders.insert(decomposedPath.parentPath);
+        }
+    }
+
+    if (errorCode) {
+        printf("Error: Could not scan folder '%s': %s\n", root.c_str(), errorCode.message().c_str());
+
+        return false;
+    }
+
+    folders.insert(folders.end(), materialFolders.begin(), materialFolders.end());
+
+    return true;
+}
+
+bool loadFolderList(std::vector<std::string>& folders, const std::string& filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        printf("Error: Could not load folder list '%s'\n", filename.c_str());
+
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.pop_back();
+        }
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        folders.push_back(line);
+    }
+
+    return true;
+}
+
+bool convertBatch(const std::vector<std::string>& folders, const ConvertOptions& convertOptions, const BatchOptions& batchOptions)
+{
+    // A split folder has one result per material, other folders have one result
+    std::vector<std::vector<ConvertResult>> folderResults(folders.size());
+    std::vector<std::vector<uint8_t>> folderSuccesses(folders.size());
+
+    bool split = batchOptions.splitMode != SPLIT_MODE_OFF;
+
+    // With a memory budget, this thread admits the materials in their order by the estimate of their working set.
+    // A split folder admits its materials itself, so the folders are converted one after another.
+    MemoryBudget* memoryBudget = convertOptions.memoryBudget;
+
+    std::vector<std::string> outputFolders;
+    planOutputFolders(outputFolders, folders, batchOptions.rootFolder, convertOptions.outputFolder);
+
+    std::vector<ConvertOptions> folderOptions(folders.size(), convertOptions);
+    for (size_t i = 0; i < folders.size(); i++) {
+        folderOptions[i].outputFolder = outputFolders[i];
+    }
+
+    {
+        ThreadPool threadPool(batchOptions.workerCount);
+
+        printf("Info: Converting %zu %s using %u workers\n", folders.size(), split ? "folders" : "materials", threadPool.getWorkerCount());
+
+        for (size_t i = 0; i < folders.size(); i++) {
+            // An archive is always converted as one material
+            bool splitFolder = split && !isArchivePath(folders[i]);
+
+            std::error_code errorCode;
+            if (!outputFolders[i].empty()) {
+                fs::create_directories(outputFolders[i], errorCode);
+            }
+            if (errorCode) {
+                folderResults[i].resize(1);
+                folderResults[i][0].folder = folders[i];
+                folderResults[i][0].errorCode = CONVERT_ERROR_OUTPUT;
+                folderResults[i][0].error = "Could not create output folder '" + outputFolders[i] + "'";
+                folderSuccesses[i].push_back(0);
+
+                printf("Error: %s\n", folderResults[i][0].error.c_str());
+
+                continue;
+            }
+
+            if (memoryBudget && splitFolder) {
+                std::vector<ConvertResult>& convertResults = folderResults[i];
+
+                try {
+                    convertMaterials(convertResults, folders[i], batchOptions.splitMode == SPLIT_MODE_SHARED, folderOptions[i], threadPool);
+                } catch (const std::exception& exception) {
+                    convertResults.resize(1);
+                    convertResults[0].folder = folders[i];
+                    convertResults[0].errorCode = CONVERT_ERROR_EXCEPTION;
+                    convertResults[0].error = exception.what();
+
+                    printf("Error: %s\n", convertResults[0].error.c_str());
+                }
+
+                for (const ConvertResult& convertResult : convertResults) {
+                    folderSuccesses[i].push_back(convertResult.errorCode == CONVERT_ERROR_NONE ? 1 : 0);
+                }
+
+                continue;
+            }
+
+            uint64_t estimate = 0;
+            if (memoryBudget) {
+                // A folder, which can not be scanned, fails in its conversion
+                estimateMaterialMemory(estimate, folders[i], folderOptions[i]);
+
+                memoryBudget->reserve(estimate);
+            }
+
+            threadPool.submit([&, i, estimate, splitFolder]() {
+                std::vector<ConvertResult>& convertResults = folderResults[i];
+                std::vector<uint8_t>& successes = folderSuccesses[i];
+
+                try {
+                    if (splitFolder) {
+                        convertMaterials(convertResults, folders[i], batchOptions.splitMode == SPLIT_MODE_SHARED, folderOptions[i], threadPool);
+
+                        for (const ConvertResult& convertResult : convertResults) {
+                            successes.push_back(convertResult.errorCode == CONVERT_ERROR_NONE ? 1 : 0);
+                        }
+                    } else {
+                        convertResults.resize(1);
+                        successes.push_back(convertMaterial(convertResults[0], folders[i], folderOptions[i], threadPool) ? 1 : 0);
+                    }
+                } catch (const std::exception& exception) {
+                    convertResults.resize(1);
+                    convertResults[0].folder = folders[i];
+                    convertResults[0].errorCode = CONVERT_ERROR_EXCEPTION;
+                    convertResults[0].error = exception.what();
+                    successes.assign(1, 0);
+
+                    printf("Error: %s\n", convertResults[0].error.c_str());
+                }
+
+                if (memoryBudget) {
+                    convertResults[0].estimatedMemory = estimate;
+
+                    memoryBudget->release(estimate);
+                }
+            });
+        }
+
+        threadPool.wait();
+    }
+
+    // The batch is finished, so the cached image buffers are returned to the system
+    getImageBufferPool().trim();
+
+    //
+
+    size_t succeeded = 0;
+    size_t failed = 0;
+
+    json summary = json::object();
+    json materials = json::array();
+
+    for (size_t i = 0; i < folders.size(); i++) {
+        for (size_t j = 0; j < folderResults[i].size(); j++) {
+            const ConvertResult& convertResult = folderResults[i][j];
+
+            json material = json::object();
+            material["folder"] = folders[i];
+            if (split) {
+                material["name"] = convertResult.name;
+            }
+            if (memoryBudget) {
+                material["estimatedMemory"] = convertResult.estimatedMemory;
+            }
+
+            if (folderSuccesses[i][j]) {
+                material["success"] = true;
+                material["output"] = convertResult.savename;
+
+                succeeded++;
+            } else {
+                material["success"] = false;
+                material["errorCode"] = getConvertErrorName(convertResult.errorCode);
+                material["error"] = convertResult.error;
+
+                if (split && !convertResult.name.empty()) {
+                    printf("Failure: '%s' in '%s': %s\n", convertResult.name.c_str(), folders[i].c_str(), convertResult.error.c_str());
+                } else {
+                    printf("Failure: '%s': %s\n", folders[i].c_str(), convertResult.error.c_str());
+                }
+
+                failed++;
+            }
+
+            materials.push_back(material);
+        }
+    }
+
+    summary["succeeded"] = succeeded;
+    summary["failed"] = failed;
+    summary["materials"] = materials;
+
+    if (memoryBudget) {
+        uint64_t peakEstimate = memoryBudget->getPeakReserved();
+        uint64_t peakResidentSize = getPeakResidentSize();
+
+        summary["memoryBudget"] = memoryBudget->getByteCount();
+        summary["peakEstimate"] = peakEstimate;
+        summary["peakResidentSize"] = peakResidentSize;
+
+        printf("Info: Memory budget %.1f MiB and %.1f MiB for the buffer cache, peak of estimates %.1f MiB, peak RSS %.1f MiB\n", memoryBudget->getByteCount() / 1048576.0, getImageBufferPool().getMaximumCachedBytes() / 1048576.0, peakEstimate / 1048576.0, peakResidentSize / 1048576.0);
+    }
+
+    printf("Summary: %zu succeeded, %zu failed\n", succeeded, failed);
+
+    if (!batchOptions.summaryPath.empty()) {
+        if (!saveFile(summary.dump(3), batchOptions.summaryPath)) {
+            printf("Error: Could not save '%s'\n", batchOptions.summaryPath.c_str());
+
+            return false;
+        }
+    }
+
+    return failed == 0;
+}
@@ -0,0 +1,37 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Converter.h"
+
+// Flat folders with many materials are split by the material stems of their images.
+enum SplitMode {
+    SPLIT_MODE_OFF,
+    // Each material is saved as its own glTF.
+    SPLIT_MODE_SEPARATE,
+    // All materials of a folder are saved into one glTF named after the folder.
+    SPLIT_MODE_SHARED
+};
+
+struct BatchOptions {
+    uint32_t workerCount = 0;
+    std::string summaryPath = "";
+    SplitMode splitMode = SPLIT_MODE_OFF;
+    // The paths of the material folders below this folder are mirrored below the output folder. If empty, their common parent folder is used.
+    std::string rootFolder = "";
+};
+
+// Recursively collects every folder below root, which contains at least one PBR image, and every ZIP archive, which contains one.
+bool gatherMaterialFolders(std::vector<std::string>& folders, const std::string& root);
+
+// Reads a list file with one material folder per line.
+bool loadFolderList(std::vector<std::string>& folders, const std::string& filename);
+
+// Converts all folders on a thread pool and reports the successes and failures. Archives are converted as one material, also when split.
+// The outputs of each folder are saved into its mirrored path below the output folder.
+bool convertBatch(const std::vector<std::string>& folders, const ConvertOptions& convertOptions, const BatchOptions& batchOptions);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,316 @@
+#include "Bc7.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Interpolation weights of the 4 bit indices in 1/64
+const uint32_t WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 7 bit values and the p-bit, which is appended as lowest bit to each value.
+struct Endpoint {
+    uint8_t values[4] = {};
+    uint32_t pBit = 0;
+};
+
+struct Mode6Block {
+    Endpoint endpoints[2];
+    uint8_t indices[16] = {};
+    uint32_t error = UINT32_MAX;
+};
+
+// Quantizes an endpoint with the given p-bit or with the better one, if the p-bit is negative.
+Endpoint quantizeEndpoint(const float endpoint[4], int32_t pBit)
+{
+    Endpoint bestEndpoint;
+    float bestError = 0.0f;
+
+    for (int32_t candidate = 0; candidate < 2; candidate++) {
+        if (pBit >= 0 && candidate != pBit) {
+            continue;
+        }
+
+        Endpoint quantized;
+        quantized.pBit = static_cast<uint32_t>(candidate);
+
+        float error = 0.0f;
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            float value = std::round((endpoint[channel] - static_cast<float>(candidate)) * 0.5f);
+            quantized.values[channel] = static_cast<uint8_t>(std::min(std::max(value, 0.0f), 127.0f));
+
+            float difference = static_cast<float>(quantized.values[channel] * 2 + quantized.pBit) - endpoint[channel];
+            error += difference * difference;
+        }
+
+        if (candidate == 0 || pBit >= 0 || error < bestError) {
+            bestEndpoint = quantized;
+            bestError = error;
+        }
+    }
+
+    return bestEndpoint;
+}
+
+// Selects the palette entry with the smallest squared error for each pixel and returns the summed error.
+uint32_t findIndices(uint8_t indices[16], const uint8_t pixels[64], const Endpoint endpoints[2])
+{
+    uint32_t palette[16][4];
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            uint32_t color0 = endpoints[0].values[channel] * 2u + endpoints[0].pBit;
+            uint32_t color1 = endpoints[1].values[channel] * 2u + endpoints[1].pBit;
+
+            palette[i][channel] = ((64 - WEIGHTS[i]) * color0 + WEIGHTS[i] * color1 + 32) >> 6;
+        }
+    }
+
+    uint32_t totalError = 0;
+
+    for (uint32_t p = 0; p < 16; p++) {
+        const uint8_t* pixel = pixels + p * 4;
+
+        uint32_t bestError = UINT32_MAX;
+        for (uint32_t i = 0; i < 16; i++) {
+            uint32_t error = 0;
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                int32_t difference = static_cast<int32_t>(pixel[channel]) - static_cast<int32_t>(palette[i][channel]);
+                error += static_cast<uint32_t>(difference * difference);
+            }
+
+            if (error < bestError) {
+                bestError = error;
+                indices[p] = static_cast<uint8_t>(i);
+            }
+        }
+
+        totalError += bestError;
+    }
+
+    return totalError;
+}
+
+// Places the endpoints on the extremes of the pixels projected onto an axis through their mean.
+// The principal axis is found by power iteration, otherwise the diagonal of the bounding box is used.
+void findEndpoints(float endpoints[2][4], const uint8_t pixels[64], bool principalAxis)
+{
+    float mean[4] = {};
+    float minimum[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+    float maximum[4] = {};
+
+    for (uint32_t p = 0; p < 16; p++) {
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            float value = static_cast<float>(pixels[p * 4 + channel]);
+
+            mean[channel] += value / 16.0f;
+            minimum[channel] = std::min(minimum[channel], value);
+            maximum[channel] = std::max(maximum[channel], value);
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t p = 0; p < 16; p++) {
+        float centered[4];
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            centered[channel] = static_cast<float>(pixels[p * 4 + channel]) - mean[channel];
+        }
+
+        for (uint32_t row = 0; row < 4; row++) {
+            for (uint32_t column = 0; column < 4; column++) {
+                covariance[row][column] += centered[row] * centered[column];
+            }
+        }
+    }
+
+    // Channels, which decrease with the channel of the largest range, run against the diagonal
+    uint32_t dominant = 0;
+    for (uint32_t channel = 1; channel < 4; channel++) {
+        if (maximum[channel] - minimum[channel] > maximum[dominant] - minimum[dominant]) {
+            dominant = channel;
+        }
+    }
+
+    float axis[4];
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        axis[channel] = maximum[channel] - minimum[channel];
+        if (covariance[dominant][channel] < 0.0f) {
+            axis[channel] = -axis[channel];
+        }
+    }
+
+    if (principalAxis) {
+        for (uint32_t iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            for (uint32_t row = 0; row < 4; row++) {
+                for (uint32_t column = 0; column < 4; column++) {
+                    next[row] += covariance[row][column] * axis[column];
+                }
+            }
+
+            float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            if (length < 1e-6f) {
+                break;
+            }
+
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                axis[channel] = next[channel] / length;
+            }
+        }
+    }
+
+    float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+    if (length < 1e-6f) {
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            endpoints[0][channel] = mean[channel];
+            endpoints[1][channel] = mean[channel];
+        }
+
+        return;
+    }
+
+    float minimumT = 0.0f;
+    float maximumT = 0.0f;
+    for (uint32_t p = 0; p < 16; p++) {
+        float t = 0.0f;
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            t += (static_cast<float>(pixels[p * 4 + channel]) - mean[channel]) * axis[channel] / length;
+        }
+
+        minimumT = std::min(minimumT, t);
+        maximumT = std::max(maximumT, t);
+    }
+
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        endpoints[0][channel] = std::min(std::max(mean[channel] + axis[channel] / length * minimumT, 0.0f), 255.0f);
+        endpoints[1][channel] = std::min(std::max(mean[channel] + axis[channel] / length * maximumT, 0.0f), 255.0f);
+    }
+}
+
+// Solves the least squares endpoints for the given indices. Returns false, if all pixels use the same weight.
+bool refineEndpoints(float endpoints[2][4], const uint8_t pixels[64], const uint8_t indices[16])
+{
+    float a = 0.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    float right0[4] = {};
+    float right1[4] = {};
+
+    for (uint32_t p = 0; p < 16; p++) {
+        float weight = static_cast<float>(WEIGHTS[indices[p]]) / 64.0f;
+
+        a += (1.0f - weight) * (1.0f - weight);
+        b += (1.0f - weight) * weight;
+        c += weight * weight;
+
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            float value = static_cast<float>(pixels[p * 4 + channel]);
+
+            right0[channel] += (1.0f - weight) * value;
+            right1[channel] += weight * value;
+        }
+    }
+
+    float determinant = a * c - b * b;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        endpoints[0][channel] = std::min(std::max((c * right0[channel] - b * right1[channel]) / determinant, 0.0f), 255.0f);
+        endpoints[1][channel] = std::min(std::max((a * right1[channel] - b * right0[channel]) / determinant, 0.0f), 255.0f);
+    }
+
+    return true;
+}
+
+void evaluateEndpoints(Mode6Block& bestBlock, const uint8_t pixels[64], const float endpoints[2][4], bool searchPBits)
+{
+    // The slow quality tries every p-bit combination, the others choose the p-bit of each endpoint on its own
+    for (int32_t combination = searchPBits ? 0 : -1; combination < (searchPBits ? 4 : 0); combination++) {
+        Mode6Block block;
+        block.endpoints[0] = quantizeEndpoint(endpoints[0], searchPBits ? (combination & 1) : -1);
+        block.endpoints[1] = quantizeEndpoint(endpoints[1], searchPBits ? (combination >> 1) : -1);
+        block.error = findIndices(block.indices, pixels, block.endpoints);
+
+        if (block.error < bestBlock.error) {
+            bestBlock = block;
+        }
+    }
+}
+
+void writeBits(uint8_t block[16], uint32_t& offset, uint32_t value, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if ((value >> i) & 1) {
+            block[(offset + i) >> 3] |= static_cast<uint8_t>(1 << ((offset + i) & 7));
+        }
+    }
+
+    offset += count;
+}
+
+void packBlock(uint8_t block[16], Mode6Block& mode6Block)
+{
+    // The highest index bit of the first pixel is implicit zero, so the endpoints are swapped otherwise
+    if (mode6Block.indices[0] & 8) {
+        std::swap(mode6Block.endpoints[0], mode6Block.endpoints[1]);
+        for (uint32_t p = 0; p < 16; p++) {
+            mode6Block.indices[p] = static_cast<uint8_t>(15 - mode6Block.indices[p]);
+        }
+    }
+
+    memset(block, 0, 16);
+
+    uint32_t offset = 0;
+    writeBits(block, offset, 1 << 6, 7);
+
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        writeBits(block, offset, mode6Block.endpoints[0].values[channel], 7);
+        writeBits(block, offset, mode6Block.endpoints[1].values[channel], 7);
+    }
+
+    writeBits(block, offset, mode6Block.endpoints[0].pBit, 1);
+    writeBits(block, offset, mode6Block.endpoints[1].pBit, 1);
+
+    writeBits(block, offset, mode6Block.indices[0], 3);
+    for (uint32_t p = 1; p < 16; p++) {
+        writeBits(block, offset, mode6Block.indices[p], 4);
+    }
+}
+
+}
+
+void encodeBc7Block(uint8_t block[16], const uint8_t pixels[64], Bc7Quality bc7Quality)
+{
+    float endpoints[2][4];
+    findEndpoints(endpoints, pixels, bc7Quality != BC7_QUALITY_FAST);
+
+    bool searchPBits = (bc7Quality == BC7_QUALITY_SLOW);
+
+    Mode6Block bestBlock;
+    evaluateEndpoints(bestBlock, pixels, endpoints, searchPBits);
+
+    uint32_t iterationCount = 0;
+    if (bc7Quality == BC7_QUALITY_NORMAL) {
+        iterationCount = 1;
+    } else if (bc7Quality == BC7_QUALITY_SLOW) {
+        iterationCount = 4;
+    }
+
+    for (uint32_t iteration = 0; iteration < iterationCount && bestBlock.error > 0; iteration++) {
+        uint32_t previousError = bestBlock.error;
+
+        if (!refineEndpoints(endpoints, pixels, bestBlock.indices)) {
+            break;
+        }
+
+        evaluateEndpoints(bestBlock, pixels, endpoints, searchPBits);
+
+        if (bestBlock.error >= previousError) {
+            break;
+        }
+    }
+
+    packBlock(block, bestBlock);
+}
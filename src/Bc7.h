@@ -0,0 +1,17 @@
+#ifndef BC7_H_
+#define BC7_H_
+
+#include <cstdint>
+
+enum Bc7Quality {
+    BC7_QUALITY_FAST,
+    BC7_QUALITY_NORMAL,
+    BC7_QUALITY_SLOW
+};
+
+// Encodes 4x4 RGBA pixels, stored row by row, into one 16 byte BC7 block. Only mode 6 is used: One subset with 7 bit RGBA endpoints,
+// a p-bit per endpoint and 4 bit indices, which suits color, packed data and normal images alike.
+// The fast quality uses the bounding box of the pixels, the others the principal axis refined by least squares.
+void encodeBc7Block(uint8_t block[16], const uint8_t pixels[64], Bc7Quality bc7Quality);
+
+#endif /* BC7_H_ */
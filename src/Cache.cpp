@@ -0,0 +1,182 @@
+#include "Cache.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <exception>
+
+#include "Hash.h"
+#include "Helper.h"
+
+namespace {
+
+const uint32_t CACHE_VERSION = 3;
+
+std::string toHex(uint64_t value)
+{
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016" PRIx64, value);
+
+    return buffer;
+}
+
+uint64_t fromHex(const std::string& value)
+{
+    return static_cast<uint64_t>(std::stoull(value, nullptr, 16));
+}
+
+bool getFileStatus(uint64_t& size, int64_t& modified, const std::string& filename)
+{
+    std::error_code errorCode;
+
+    uintmax_t fileSize = fs::file_size(filename, errorCode);
+    if (errorCode) {
+        return false;
+    }
+
+    auto lastWriteTime = fs::last_write_time(filename, errorCode);
+    if (errorCode) {
+        return false;
+    }
+
+    size = static_cast<uint64_t>(fileSize);
+    modified = static_cast<int64_t>(lastWriteTime.time_since_epoch().count());
+
+    return true;
+}
+
+}
+
+bool loadCacheManifest(CacheManifest& cacheManifest, const std::string& filename)
+{
+    cacheManifest = CacheManifest();
+
+    std::string content;
+    if (!loadFile(content, filename)) {
+        return false;
+    }
+
+    // The manifest is only a hint, so any error just invalidates it
+    try {
+        json manifest = json::parse(content);
+
+        if (manifest.value("version", 0u) != CACHE_VERSION) {
+            return false;
+        }
+
+        CacheManifest result;
+
+        for (const auto& input : manifest.at("inputs").items()) {
+            CachedInput cachedInput;
+            cachedInput.size = input.value().at("size").get<uint64_t>();
+            cachedInput.modified = input.value().at("modified").get<int64_t>();
+            cachedInput.hash = fromHex(input.value().at("hash").get<std::string>());
+
+            result.inputs[input.key()] = cachedInput;
+        }
+
+        for (const auto& output : manifest.at("outputs").items()) {
+            CachedOutput cachedOutput;
+            cachedOutput.key = fromHex(output.value().at("key").get<std::string>());
+            cachedOutput.size = output.value().at("size").get<uint64_t>();
+            cachedOutput.imageRoles = output.value().at("roles").get<std::vector<uint32_t>>();
+            cachedOutput.alphaCoverage = output.value().at("alpha").get<uint32_t>();
+
+            // Each constant is stored as role followed by its values
+            for (const auto& constant : output.value().at("constants")) {
+                std::vector<uint32_t> values = constant.get<std::vector<uint32_t>>();
+                if (values.size() != 4) {
+                    return false;
+                }
+
+                CachedConstant cachedConstant;
+                cachedConstant.imageRole = values[0];
+                for (uint32_t i = 0; i < 3; i++) {
+                    cachedConstant.values[i] = static_cast<uint8_t>(values[i + 1]);
+                }
+                cachedOutput.constants.push_back(cachedConstant);
+            }
+
+            result.outputs[output.key()] = cachedOutput;
+        }
+
+        result.materialKey = fromHex(manifest.at("material").get<std::string>());
+        result.savename = manifest.at("savename").get<std::string>();
+
+        cacheManifest = std::move(result);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+bool saveCacheManifest(const CacheManifest& cacheManifest, const std::string& filename)
+{
+    json manifest = json::object();
+    manifest["version"] = CACHE_VERSION;
+
+    json inputs = json::object();
+    for (const auto& input : cacheManifest.inputs) {
+        json cachedInput = json::object();
+        cachedInput["size"] = input.second.size;
+        cachedInput["modified"] = input.second.modified;
+        cachedInput["hash"] = toHex(input.second.hash);
+
+        inputs[input.first] = cachedInput;
+    }
+    manifest["inputs"] = inputs;
+
+    json outputs = json::object();
+    for (const auto& output : cacheManifest.outputs) {
+        json cachedOutput = json::object();
+        cachedOutput["key"] = toHex(output.second.key);
+        cachedOutput["size"] = output.second.size;
+        cachedOutput["roles"] = output.second.imageRoles;
+        cachedOutput["alpha"] = output.second.alphaCoverage;
+
+        json constants = json::array();
+        for (const CachedConstant& cachedConstant : output.second.constants) {
+            constants.push_back({ cachedConstant.imageRole, cachedConstant.values[0], cachedConstant.values[1], cachedConstant.values[2] });
+        }
+        cachedOutput["constants"] = constants;
+
+        outputs[output.first] = cachedOutput;
+    }
+    manifest["outputs"] = outputs;
+
+    manifest["material"] = toHex(cacheManifest.materialKey);
+    manifest["savename"] = cacheManifest.savename;
+
+    return saveFile(manifest.dump(3), filename);
+}
+
+bool hashInput(uint64_t& hash, CacheManifest& nextManifest, const CacheManifest& previousManifest, const std::string& filename)
+{
+    CachedInput cachedInput;
+    if (!getFileStatus(cachedInput.size, cachedInput.modified, filename)) {
+        return false;
+    }
+
+    auto it = previousManifest.inputs.find(filename);
+    if (it != previousManifest.inputs.end() && it->second.size == cachedInput.size && it->second.modified == cachedInput.modified) {
+        cachedInput.hash = it->second.hash;
+    } else {
+        if (!hashFile(cachedInput.hash, filename)) {
+            return false;
+        }
+    }
+
+    nextManifest.inputs[filename] = cachedInput;
+    hash = cachedInput.hash;
+
+    return true;
+}
+
+bool isFileUnchanged(const std::string& filename, uint64_t size)
+{
+    std::error_code errorCode;
+
+    uintmax_t fileSize = fs::file_size(filename, errorCode);
+
+    return !errorCode && static_cast<uint64_t>(fileSize) == size;
+}
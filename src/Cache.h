@@ -0,0 +1,52 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Input file as seen by the last conversion. The content hash is only recomputed, if size or modification time differ.
+struct CachedInput {
+    uint64_t size = 0;
+    int64_t modified = 0;
+    uint64_t hash = 0;
+};
+
+// Source of an output, which was replaced by a factor.
+struct CachedConstant {
+    uint32_t imageRole = 0;
+    uint8_t values[3] = {};
+};
+
+// Output file and the key of the inputs and options, it was built from. The roles are the image roles found in the inputs.
+// An output, which sources are all constant, has no file. The alpha coverage belongs to a written opacity.
+struct CachedOutput {
+    uint64_t key = 0;
+    uint64_t size = 0;
+    std::vector<uint32_t> imageRoles;
+    std::vector<CachedConstant> constants;
+    uint32_t alphaCoverage = 0;
+};
+
+// Manifest, which is saved next to the outputs of a material.
+struct CacheManifest {
+    std::map<std::string, CachedInput> inputs;
+    std::map<std::string, CachedOutput> outputs;
+    uint64_t materialKey = 0;
+    std::string savename = "";
+};
+
+// A missing or invalid manifest leaves the manifest empty and returns false.
+bool loadCacheManifest(CacheManifest& cacheManifest, const std::string& filename);
+
+bool saveCacheManifest(const CacheManifest& cacheManifest, const std::string& filename);
+
+// Returns the content hash of an input. The hash of the previous manifest is reused, if size and modification time still match.
+// The input is recorded in the next manifest.
+bool hashInput(uint64_t& hash, CacheManifest& nextManifest, const CacheManifest& previousManifest, const std::string& filename);
+
+// Returns true, if the file exists and has the given size.
+bool isFileUnchanged(const std::string& filename, uint64_t size);
+
+#endif /* CACHE_H_ */
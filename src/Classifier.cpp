@@ -0,0 +1,557 @@
+#include "Classifier.h"
+
+#include <cstdio>
+#include <deque>
+#include <sstream>
+
+namespace {
+
+// Symbols of the automaton: Other characters, the letters in either case, the digits, ' ', '_', '-' and '.'
+const uint32_t SYMBOL_COUNT = 41;
+
+struct SymbolTable {
+    uint8_t symbols[256] = {};
+
+    SymbolTable()
+    {
+        for (uint32_t i = 0; i < 26; i++) {
+            symbols['a' + i] = static_cast<uint8_t>(1 + i);
+            symbols['A' + i] = static_cast<uint8_t>(1 + i);
+        }
+        for (uint32_t i = 0; i < 10; i++) {
+            symbols['0' + i] = static_cast<uint8_t>(27 + i);
+        }
+        symbols[static_cast<uint8_t>(' ')] = 37;
+        symbols[static_cast<uint8_t>('_')] = 38;
+        symbols[static_cast<uint8_t>('-')] = 39;
+        symbols[static_cast<uint8_t>('.')] = 40;
+    }
+};
+
+const SymbolTable symbolTable;
+
+uint32_t getSymbol(char c)
+{
+    return symbolTable.symbols[static_cast<uint8_t>(c)];
+}
+
+// Characters, which start a word
+bool isWordSeparator(char c)
+{
+    return c == '_' || c == '-' || c == ' ';
+}
+
+// Resolution words like 2k, 4K, 2048 or 2048x2048, which can follow the role word
+bool isResolutionWord(const char* word, size_t length)
+{
+    size_t digits = 0;
+    while (digits < length && word[digits] >= '0' && word[digits] <= '9') {
+        digits++;
+    }
+    if (digits == 0) {
+        return false;
+    }
+
+    if (digits == length) {
+        return true;
+    }
+
+    if (digits + 1 == length) {
+        return word[digits] == 'k' || word[digits] == 'K';
+    }
+
+    if (word[digits] != 'x' && word[digits] != 'X') {
+        return false;
+    }
+    for (size_t i = digits + 1; i < length; i++) {
+        if (word[i] < '0' || word[i] > '9') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::string trim(const std::string& input)
+{
+    size_t begin = input.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = input.find_last_not_of(" \t\r");
+
+    return input.substr(begin, end - begin + 1);
+}
+
+bool parseRole(ImageRole& imageRole, uint32_t& sourceChannel, bool& hasChannel, const std::string& token)
+{
+    std::string name = toLowercase(token);
+
+    sourceChannel = 0;
+    hasChannel = false;
+
+    size_t dot = name.find('.');
+    if (dot != std::string::npos) {
+        hasChannel = true;
+
+        std::string channel = name.substr(dot + 1);
+        name = name.substr(0, dot);
+
+        if (channel == "r") {
+            sourceChannel = 0;
+        } else if (channel == "g") {
+            sourceChannel = 1;
+        } else if (channel == "b") {
+            sourceChannel = 2;
+        } else if (channel == "a") {
+            sourceChannel = 3;
+        } else {
+            return false;
+        }
+    }
+
+    if (name == "basecolor") {
+        imageRole = IMAGE_ROLE_BASE_COLOR;
+    } else if (name == "opacity") {
+        imageRole = IMAGE_ROLE_OPACITY;
+    } else if (name == "metallic") {
+        imageRole = IMAGE_ROLE_METALLIC;
+    } else if (name == "roughness") {
+        imageRole = IMAGE_ROLE_ROUGHNESS;
+    } else if (name == "occlusion") {
+        imageRole = IMAGE_ROLE_OCCLUSION;
+    } else if (name == "normal") {
+        imageRole = IMAGE_ROLE_NORMAL;
+    } else if (name == "emissive") {
+        imageRole = IMAGE_ROLE_EMISSIVE;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+// Parses "role[.channel]" or the roles of a packed image, which name the channel of each role.
+bool parseRoles(std::vector<ChannelRole>& channelRoles, std::string& error, const std::string& roles)
+{
+    channelRoles.clear();
+
+    bool allChannels = true;
+
+    std::istringstream tokens(roles);
+    std::string token;
+    while (tokens >> token) {
+        ChannelRole channelRole;
+        bool hasChannel = false;
+        if (!parseRole(channelRole.imageRole, channelRole.sourceChannel, hasChannel, token)) {
+            error = "Unknown role '" + token + "'";
+
+            return false;
+        }
+
+        allChannels = allChannels && hasChannel;
+        channelRoles.push_back(channelRole);
+    }
+
+    if (channelRoles.empty()) {
+        error = "Unknown role '" + roles + "'";
+
+        return false;
+    }
+
+    if (channelRoles.size() == 1) {
+        return true;
+    }
+
+    // The channels of a packed image are read from one decoded image, so each role needs its own channel
+
+    if (!allChannels) {
+        error = "Packed roles need a channel in '" + roles + "'";
+
+        return false;
+    }
+
+    for (size_t i = 0; i < channelRoles.size(); i++) {
+        ImageRole imageRole = channelRoles[i].imageRole;
+        if (!(imageRole == IMAGE_ROLE_OCCLUSION || imageRole == IMAGE_ROLE_ROUGHNESS || imageRole == IMAGE_ROLE_METALLIC)) {
+            error = "Only occlusion, roughness and metallic can be packed in '" + roles + "'";
+
+            return false;
+        }
+
+        for (size_t j = 0; j < i; j++) {
+            if (channelRoles[j].imageRole == imageRole || channelRoles[j].sourceChannel == channelRoles[i].sourceChannel) {
+                error = "Duplicate role or channel in '" + roles + "'";
+
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Names of the original rules of pbr2gltf2. "nor_gl" is the "_nor_" of the original rules, which was followed by "gl"
+const char* const DEFAULT_RULES = R"(
+baseColor: color, base_color, basecolor, base color
+opacity: opacity
+metallic: metallic
+roughness: roughness, rough
+occlusion: ao, ambientocclusion
+normal: normal, nor, nor_gl
+emissive: emissive
+
+occlusion.r roughness.g metallic.b: orm, arm, occlusionroughnessmetallic
+roughness.r metallic.g occlusion.b: rma
+)";
+
+// e.g. Bricks036_2K_Color.jpg, Bricks036_2K_NormalGL.jpg
+const char* const CC0TEXTURES_RULES = R"(
+baseColor: color
+opacity: opacity
+metallic: metalness
+roughness: roughness
+occlusion: ambientocclusion
+normal: normalgl
+emissive: emission
+)";
+
+// e.g. BrickWall01_2K_BaseColor.png, BrickWall01_2K_AO.png
+const char* const CGBOOKCASE_RULES = R"(
+baseColor: basecolor
+opacity: opacity
+metallic: metallic
+roughness: roughness
+occlusion: ao
+normal: normal
+emissive: emissive
+)";
+
+// e.g. Concrete_Wall_Albedo.png, Concrete_Wall_Metalness.png
+const char* const GAMETEXTURES_RULES = R"(
+baseColor: basecolor, albedo
+opacity: opacity, alpha
+metallic: metallic, metalness
+roughness: roughness
+occlusion: ao
+normal: normal
+emissive: emissive
+)";
+
+// e.g. wood_01_basecolor.jpg, wood_01_rough.jpg
+const char* const SHARETEXTURES_RULES = R"(
+baseColor: basecolor, albedo, diffuse
+opacity: opacity
+metallic: metallic
+roughness: roughness, rough
+occlusion: ao
+normal: normal
+emissive: emissive
+)";
+
+// e.g. rock_wall_diff_2k.jpg, rock_wall_nor_gl_2k.jpg, rock_wall_arm_2k.jpg
+const char* const POLYHAVEN_RULES = R"(
+baseColor: diff, diffuse
+opacity: alpha
+metallic: metal
+roughness: rough
+occlusion: ao
+normal: nor_gl
+emissive: emission
+occlusion.r roughness.g metallic.b: arm
+)";
+
+Classifier createDefaultClassifier()
+{
+    Classifier classifier;
+
+    std::string error;
+    if (!classifier.addRules(error, DEFAULT_RULES)) {
+        printf("Error: %s\n", error.c_str());
+    }
+    classifier.compile();
+
+    return classifier;
+}
+
+Classifier& getImageClassifier()
+{
+    static Classifier classifier = createDefaultClassifier();
+
+    return classifier;
+}
+
+}
+
+bool Classifier::addRules(std::string& error, const std::string& rules)
+{
+    std::istringstream stream(rules);
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(stream, line)) {
+        lineNumber++;
+
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+
+        std::string prefix = "Line " + std::to_string(lineNumber) + ": ";
+
+        if (line.compare(0, 7, "preset ") == 0) {
+            std::string presetRules;
+            if (!getPresetRules(presetRules, trim(line.substr(7)))) {
+                error = prefix + "Unknown preset '" + trim(line.substr(7)) + "'";
+
+                return false;
+            }
+
+            if (!addRules(error, presetRules)) {
+                return false;
+            }
+
+            continue;
+        }
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            error = prefix + "Expected 'role: patterns'";
+
+            return false;
+        }
+
+        std::vector<ChannelRole> channelRoles;
+        if (!parseRoles(channelRoles, error, trim(line.substr(0, colon)))) {
+            error = prefix + error;
+
+            return false;
+        }
+
+        std::istringstream patterns(line.substr(colon + 1));
+        std::string pattern;
+        while (std::getline(patterns, pattern, ',')) {
+            if (!addRule(error, trim(pattern), channelRoles)) {
+                error = prefix + error;
+
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Classifier::addRule(std::string& error, const std::string& pattern, ImageRole imageRole, uint32_t sourceChannel)
+{
+    ChannelRole channelRole;
+    channelRole.imageRole = imageRole;
+    channelRole.sourceChannel = sourceChannel;
+
+    return addRule(error, pattern, { channelRole });
+}
+
+bool Classifier::addRule(std::string& error, const std::string& pattern, const std::vector<ChannelRole>& channelRoles)
+{
+    if (pattern.empty()) {
+        error = "Empty pattern";
+
+        return false;
+    }
+
+    // The extension can not be matched, as a word ends before it
+    for (char c : pattern) {
+        uint32_t symbol = getSymbol(c);
+        if (symbol == 0 || symbol == getSymbol('.')) {
+            error = "Invalid character in pattern '" + pattern + "'";
+
+            return false;
+        }
+    }
+
+    Rule rule;
+    rule.pattern = toLowercase(pattern);
+    rule.channelRoles = channelRoles;
+
+    for (Rule& otherRule : rules) {
+        if (otherRule.pattern == rule.pattern) {
+            otherRule = rule;
+
+            return true;
+        }
+    }
+
+    rules.push_back(rule);
+
+    return true;
+}
+
+void Classifier::compile()
+{
+    nextStates.assign(SYMBOL_COUNT, 0);
+    stateRules.assign(1, -1);
+    outputStates.assign(1, 0);
+
+    // Trie of the patterns
+
+    for (size_t i = 0; i < rules.size(); i++) {
+        uint32_t state = 0;
+        for (char c : rules[i].pattern) {
+            size_t index = static_cast<size_t>(state) * SYMBOL_COUNT + getSymbol(c);
+            if (nextStates[index] == 0) {
+                nextStates[index] = static_cast<uint32_t>(stateRules.size());
+
+                nextStates.resize(nextStates.size() + SYMBOL_COUNT, 0);
+                stateRules.push_back(-1);
+                outputStates.push_back(0);
+            }
+            state = nextStates[index];
+        }
+
+        stateRules[state] = static_cast<int32_t>(i);
+    }
+
+    // Breadth first, so the suffix state of each state is complete, before the missing transitions are taken from it
+
+    std::vector<uint32_t> suffixStates(stateRules.size(), 0);
+    std::deque<uint32_t> states;
+
+    for (uint32_t symbol = 0; symbol < SYMBOL_COUNT; symbol++) {
+        if (nextStates[symbol] != 0) {
+            states.push_back(nextStates[symbol]);
+        }
+    }
+
+    while (!states.empty()) {
+        uint32_t state = states.front();
+        states.pop_front();
+
+        uint32_t suffixState = suffixStates[state];
+        outputStates[state] = (stateRules[suffixState] >= 0) ? suffixState : outputStates[suffixState];
+
+        for (uint32_t symbol = 0; symbol < SYMBOL_COUNT; symbol++) {
+            uint32_t& nextState = nextStates[static_cast<size_t>(state) * SYMBOL_COUNT + symbol];
+            uint32_t suffixNextState = nextStates[static_cast<size_t>(suffixState) * SYMBOL_COUNT + symbol];
+
+            if (nextState != 0) {
+                suffixStates[nextState] = suffixNextState;
+                states.push_back(nextState);
+            } else {
+                nextState = suffixNextState;
+            }
+        }
+    }
+}
+
+bool Classifier::classify(ImageClass& imageClass, const std::string& filename) const
+{
+    imageClass = ImageClass();
+
+    if (nextStates.empty()) {
+        return false;
+    }
+
+    // Only the file name is matched, not the folders
+
+    size_t begin = filename.find_last_of("/\\");
+    begin = (begin == std::string::npos) ? 0 : begin + 1;
+
+    const char* name = filename.data();
+
+    // The role is the last word before the extension and the resolution words e.g. "Color" of "Bricks036_Color_2K.jpg"
+
+    size_t end = filename.find_last_of('.');
+    end = (end == std::string::npos || end < begin) ? filename.size() : end;
+
+    while (end > begin) {
+        size_t separator = end - 1;
+        while (separator > begin && !isWordSeparator(name[separator])) {
+            separator--;
+        }
+        if (separator == begin || !isResolutionWord(name + separator + 1, end - separator - 1)) {
+            break;
+        }
+
+        end = separator;
+    }
+
+    uint32_t state = 0;
+    for (size_t i = begin; i < end; i++) {
+        state = nextStates[static_cast<size_t>(state) * SYMBOL_COUNT + getSymbol(name[i])];
+    }
+
+    // The suffix chain lists the patterns ending there from the longest to the shortest
+    int32_t bestRule = -1;
+    size_t bestStart = 0;
+    for (uint32_t outputState = (stateRules[state] >= 0) ? state : outputStates[state]; outputState != 0; outputState = outputStates[outputState]) {
+        int32_t ruleIndex = stateRules[outputState];
+        size_t start = end - rules[ruleIndex].pattern.size();
+        if (start <= begin || !isWordSeparator(name[start - 1])) {
+            continue;
+        }
+
+        bestRule = ruleIndex;
+        bestStart = start;
+
+        break;
+    }
+
+    if (bestRule < 0) {
+        return false;
+    }
+
+    imageClass.channelRoles = rules[bestRule].channelRoles;
+    imageClass.stemLength = bestStart - 1 - begin;
+
+    return true;
+}
+
+bool getPresetRules(std::string& rules, const std::string& name)
+{
+    std::string lowercaseName = toLowercase(name);
+
+    if (lowercaseName == "default") {
+        rules = DEFAULT_RULES;
+    } else if (lowercaseName == "cc0textures") {
+        rules = CC0TEXTURES_RULES;
+    } else if (lowercaseName == "cgbookcase") {
+        rules = CGBOOKCASE_RULES;
+    } else if (lowercaseName == "gametextures") {
+        rules = GAMETEXTURES_RULES;
+    } else if (lowercaseName == "sharetextures") {
+        rules = SHARETEXTURES_RULES;
+    } else if (lowercaseName == "polyhaven") {
+        rules = POLYHAVEN_RULES;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool loadClassifierRules(std::string& error, const std::string& presetOrFilename)
+{
+    std::string rules;
+    if (!getPresetRules(rules, presetOrFilename) && !loadFile(rules, presetOrFilename)) {
+        error = "Could not load rules '" + presetOrFilename + "'";
+
+        return false;
+    }
+
+    Classifier classifier;
+    if (!classifier.addRules(error, rules)) {
+        error = "Invalid rules '" + presetOrFilename + "': " + error;
+
+        return false;
+    }
+    classifier.compile();
+
+    getImageClassifier() = std::move(classifier);
+
+    return true;
+}
+
+bool classifyImage(ImageClass& imageClass, const std::string& filename)
+{
+    return getImageClassifier().classify(imageClass, filename);
+}
@@ -0,0 +1,75 @@
+#ifndef CLASSIFIER_H_
+#define CLASSIFIER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Helper.h"
+
+// Role of an image or of one channel of a packed image.
+struct ChannelRole {
+    ImageRole imageRole = IMAGE_ROLE_UNKNOWN;
+    // Channel of the image, which is read for opacity, metallic, roughness and occlusion.
+    uint32_t sourceChannel = 0;
+};
+
+// Roles of an image and its material stem found by the file name.
+struct ImageClass {
+    // One role or the roles of the channels of a packed image e.g. occlusion, roughness and metallic of an ORM image.
+    std::vector<ChannelRole> channelRoles;
+    // Length of the material stem at the start of the file name e.g. 4 for "Wood_Color.png".
+    size_t stemLength = 0;
+};
+
+// Maps name patterns to roles. The patterns are compiled into one automaton, which reads the file name once
+// and ignores the case without converting it.
+// A pattern matches the last word of the name, which follows '_', '-' or ' ' and is only followed by the extension and
+// resolution words like 2K or 2048. The longer match wins e.g. "base_color" over "color".
+class Classifier {
+public:
+
+    // Adds rules, one per line: "role[.channel]: pattern, pattern, ..." with the roles baseColor, opacity, metallic, roughness,
+    // occlusion, normal and emissive and the channels r, g, b and a. "preset name" adds the rules of a built-in preset.
+    // A packed image lists the role of each channel: "occlusion.r roughness.g metallic.b: orm". Only occlusion, roughness
+    // and metallic can be packed.
+    // '#' starts a comment. A rule replaces an earlier rule with the same pattern.
+    bool addRules(std::string& error, const std::string& rules);
+
+    bool addRule(std::string& error, const std::string& pattern, ImageRole imageRole, uint32_t sourceChannel);
+
+    bool addRule(std::string& error, const std::string& pattern, const std::vector<ChannelRole>& channelRoles);
+
+    // Builds the automaton. Has to be called after the rules are added and before classifying.
+    void compile();
+
+    bool classify(ImageClass& imageClass, const std::string& filename) const;
+
+private:
+
+    struct Rule {
+        std::string pattern = "";
+        std::vector<ChannelRole> channelRoles;
+    };
+
+    std::vector<Rule> rules;
+
+    // Next state by state and symbol. State zero is the root
+    std::vector<uint32_t> nextStates;
+    // Rule, which pattern ends in the state, or -1
+    std::vector<int32_t> stateRules;
+    // Nearest state on the suffix chain with a rule or zero
+    std::vector<uint32_t> outputStates;
+};
+
+// Rules of a built-in preset: default, cc0textures, cgbookcase, gametextures, sharetextures or polyhaven.
+// The default preset contains the names of the original rules and the packed images. The other presets are only used, if loaded.
+bool getPresetRules(std::string& rules, const std::string& name);
+
+// Replaces the rules used by classifyImage by a preset or a rules file. Has to be called before the conversion starts.
+bool loadClassifierRules(std::string& error, const std::string& presetOrFilename);
+
+// Classifies the file name of an image with the current rules, which are the default preset, if none were loaded.
+bool classifyImage(ImageClass& imageClass, const std::string& filename);
+
+#endif /* CLASSIFIER_H_ */
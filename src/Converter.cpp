@@ -0,0 +1,3135 @@
+#include "Converter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+
+#include "Archive.h"
+#include "Cache.h"
+#include "Classifier.h"
+#include "Dedup.h"
+#include "Downscale.h"
+#include "Hash.h"
+#include "Helper.h"
+#include "Ktx2.h"
+#include "MemoryBudget.h"
+#include "Stream.h"
+#include "Swizzle.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "Writer.h"
+
+namespace {
+
+// Source, which has the same value in every pixel. Base color keeps three values, the other roles one.
+struct ConstantSource {
+    bool constant = false;
+    uint8_t values[3] = { 255, 255, 255 };
+};
+
+// Encoded KTX2 copy of a packed image. The path stays empty, if no copy is written.
+struct Ktx2Output {
+    std::string path = "";
+    EncodedData data;
+};
+
+// Planned source images and the outputs of one material.
+struct MaterialImages {
+    std::string stem = "pbr";
+    // Folder of the outputs or an empty string for the current folder
+    std::string outputFolder = "";
+
+    std::vector<PlannedImage> plannedImages;
+
+    bool writeBaseColor = false;
+    bool writeOpacity = false;
+    bool writeMetallic = false;
+    bool writeRoughness = false;
+    bool writeOcclusion = false;
+    bool writeNormal = false;
+    bool writeEmissive = false;
+
+    // The base color keeps its original data, as no opacity is merged into it
+    bool keepBaseColor = false;
+    // A packed image has occlusion, roughness and metallic in the channels of glTF, so it keeps its original data
+    bool keepMetallicRoughness = false;
+
+    std::string baseColorPath = "";
+    std::string metallicRoughnessPath = "";
+    std::string normalPath = "";
+    std::string emissivePath = "";
+
+    // Encoded outputs, which are embedded into the binary glTF instead of saved
+    EncodedData baseColorData;
+    EncodedData metallicRoughnessData;
+    EncodedData normalData;
+    EncodedData emissiveData;
+
+    Ktx2Output baseColorKtx2;
+    Ktx2Output metallicRoughnessKtx2;
+    Ktx2Output normalKtx2;
+    Ktx2Output emissiveKtx2;
+
+    // Constant sources, which are emitted as factors instead of being packed
+    ConstantSource constantSources[IMAGE_ROLE_EMISSIVE + 1];
+
+    // Content of the written opacity, which selects the alpha mode
+    AlphaCoverage alphaCoverage = ALPHA_COVERAGE_OPAQUE;
+};
+
+const PlannedImage* findPlannedImage(const std::vector<PlannedImage>& plannedImages, ImageRole imageRole)
+{
+    for (const PlannedImage& plannedImage : plannedImages) {
+        if (plannedImage.imageRole == imageRole) {
+            return &plannedImage;
+        }
+    }
+
+    return nullptr;
+}
+
+// Planned images of the channels of a packed image share the file or the data in memory.
+bool isSameSource(const PlannedImage& plannedImage, const PlannedImage& otherImage)
+{
+    return plannedImage.filename == otherImage.filename && plannedImage.data == otherImage.data;
+}
+
+bool isMetallicRoughnessRole(ImageRole imageRole)
+{
+    return imageRole == IMAGE_ROLE_METALLIC || imageRole == IMAGE_ROLE_ROUGHNESS || imageRole == IMAGE_ROLE_OCCLUSION;
+}
+
+// Channel of the metallic roughness image, which glTF reads for the role.
+uint32_t getMetallicRoughnessChannel(ImageRole imageRole)
+{
+    switch (imageRole) {
+        case IMAGE_ROLE_ROUGHNESS:
+            return 1;
+        case IMAGE_ROLE_METALLIC:
+            return 2;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+// Probes the header of a classified image and adds it to the plan, unless its role is already planned or its size differs.
+// Skipped images are only reported, if not quiet.
+bool planImage(MaterialImages& materialImages, PlannedImage& plannedImage, bool quiet = false)
+{
+    std::vector<PlannedImage>& plannedImages = materialImages.plannedImages;
+    const std::string& filename = plannedImage.filename;
+
+    bool duplicate = false;
+    for (const PlannedImage& otherImage : plannedImages) {
+        duplicate = duplicate || (otherImage.imageRole == plannedImage.imageRole);
+    }
+    if (duplicate) {
+        if (!quiet) {
+            printf("Warning: Skipping image '%s' because of duplicate role\n", filename.c_str());
+        }
+
+        return false;
+    }
+
+    // The header of a packed image is only read for its first channel
+    ImageDataResource imageInfo;
+    bool loaded = false;
+    for (const PlannedImage& otherImage : plannedImages) {
+        if (!loaded && isSameSource(plannedImage, otherImage)) {
+            imageInfo.width = otherImage.imageInfo.width;
+            imageInfo.height = otherImage.imageInfo.height;
+            imageInfo.channels = otherImage.imageInfo.channels;
+            loaded = true;
+        }
+    }
+    if (!loaded) {
+        loaded = plannedImage.data ? loadImageInfo(imageInfo, plannedImage.data, plannedImage.size) : loadImageInfo(imageInfo, filename);
+    }
+    if (!loaded) {
+        if (!quiet) {
+            printf("Warning: Skipping image '%s' because could not load size\n", filename.c_str());
+        }
+
+        return false;
+    }
+
+    // Gray images have the color in the first channel and the alpha in the second
+    if (imageInfo.channels < 3) {
+        plannedImage.sourceChannel = (plannedImage.sourceChannel == 3 && imageInfo.channels == 2) ? 1 : 0;
+    }
+    if (plannedImage.sourceChannel >= imageInfo.channels) {
+        if (!quiet) {
+            printf("Warning: Skipping image '%s' because of missing channel\n", filename.c_str());
+        }
+
+        return false;
+    }
+
+    if (!plannedImages.empty()) {
+        if ((imageInfo.width != plannedImages[0].imageInfo.width) || (imageInfo.height != plannedImages[0].imageInfo.height)) {
+            if (!quiet) {
+                printf("Warning: Skipping image '%s' because of size\n", filename.c_str());
+            }
+
+            return false;
+        }
+    }
+
+    plannedImage.imageInfo = std::move(imageInfo);
+    plannedImages.push_back(std::move(plannedImage));
+
+    return true;
+}
+
+std::string getOutputPath(const MaterialImages& materialImages, const std::string& name)
+{
+    if (materialImages.outputFolder.empty()) {
+        return name;
+    }
+
+    return (fs::path(materialImages.outputFolder) / name).generic_string();
+}
+
+// Sets the paths of the outputs by the stem. Kept base color, metallic roughness, normal and emissive images keep their extension.
+// Outputs kept in memory are relative to the glTF, so they ignore the output folder.
+void planOutputs(MaterialImages& materialImages, const ConvertOptions& convertOptions)
+{
+    materialImages.outputFolder = convertOptions.keepOutputs ? "" : convertOptions.outputFolder;
+
+    materialImages.keepBaseColor = convertOptions.keepBaseColorImageData;
+    for (const PlannedImage& plannedImage : materialImages.plannedImages) {
+        if (plannedImage.imageRole == IMAGE_ROLE_OPACITY) {
+            materialImages.keepBaseColor = false;
+        }
+    }
+
+    // The channels of a packed image can also be in another order or partly replaced by other images, then it is repacked
+    const PlannedImage* occlusionImage = findPlannedImage(materialImages.plannedImages, IMAGE_ROLE_OCCLUSION);
+    const PlannedImage* roughnessImage = findPlannedImage(materialImages.plannedImages, IMAGE_ROLE_ROUGHNESS);
+    const PlannedImage* metallicImage = findPlannedImage(materialImages.plannedImages, IMAGE_ROLE_METALLIC);
+    materialImages.keepMetallicRoughness = occlusionImage && roughnessImage && metallicImage && isSameSource(*occlusionImage, *roughnessImage) && isSameSource(*occlusionImage, *metallicImage) &&
+        metallicImage->imageInfo.channels >= 3 && occlusionImage->sourceChannel == 0 && roughnessImage->sourceChannel == 1 && metallicImage->sourceChannel == 2;
+
+    std::string baseColorExtension = ".png";
+    std::string metallicRoughnessExtension = materialImages.keepMetallicRoughness ? metallicImage->extension : ".png";
+    std::string normalExtension = ".png";
+    std::string emissiveExtension = ".png";
+    for (const PlannedImage& plannedImage : materialImages.plannedImages) {
+        if (plannedImage.imageRole == IMAGE_ROLE_BASE_COLOR && materialImages.keepBaseColor) {
+            baseColorExtension = plannedImage.extension;
+        }
+        if (plannedImage.imageRole == IMAGE_ROLE_NORMAL && convertOptions.keepNormalImageData) {
+            normalExtension = plannedImage.extension;
+        }
+        if (plannedImage.imageRole == IMAGE_ROLE_EMISSIVE && convertOptions.keepEmissiveImageData) {
+            emissiveExtension = plannedImage.extension;
+        }
+    }
+
+    materialImages.baseColorPath = getOutputPath(materialImages, materialImages.stem + "_baseColor" + baseColorExtension);
+    materialImages.metallicRoughnessPath = getOutputPath(materialImages, materialImages.stem + "_metallicRoughness" + metallicRoughnessExtension);
+    materialImages.normalPath = getOutputPath(materialImages, materialImages.stem + "_normal" + normalExtension);
+    materialImages.emissivePath = getOutputPath(materialImages, materialImages.stem + "_emissive" + emissiveExtension);
+}
+
+// Plans one image per role of a classified image, so a packed image is planned once for each of its channels.
+void addChannelRoles(std::vector<PlannedImage>& plannedImages, const PlannedImage& plannedImage, const ImageClass& imageClass)
+{
+    for (const ChannelRole& channelRole : imageClass.channelRoles) {
+        plannedImages.emplace_back();
+        plannedImages.back().filename = plannedImage.filename;
+        plannedImages.back().extension = plannedImage.extension;
+        plannedImages.back().imageRole = channelRole.imageRole;
+        plannedImages.back().sourceChannel = channelRole.sourceChannel;
+        plannedImages.back().data = plannedImage.data;
+        plannedImages.back().size = plannedImage.size;
+    }
+}
+
+// Classifies a file of a folder by its name only. Returns false for files, which are no images. No image is planned,
+// if the name matches no rule.
+bool scanImage(std::vector<PlannedImage>& plannedImages, std::string& stem, const std::string& filename)
+{
+    plannedImages.clear();
+
+    DecomposedPath decomposedPath;
+    decomposePath(decomposedPath, filename);
+
+    std::string lowercaseExtension = toLowercase(decomposedPath.extension);
+    if (!(lowercaseExtension == ".png" || lowercaseExtension == ".jpg" || lowercaseExtension == ".jpeg")) {
+        return false;
+    }
+
+    ImageClass imageClass;
+    if (!classifyImage(imageClass, filename)) {
+        return true;
+    }
+
+    PlannedImage plannedImage;
+    plannedImage.filename = filename;
+    plannedImage.extension = decomposedPath.extension;
+    addChannelRoles(plannedImages, plannedImage, imageClass);
+
+    stem = decomposedPath.stem.substr(0, imageClass.stemLength);
+
+    return true;
+}
+
+// Plan the conversion by file name and image header, so only the images being repacked are decoded.
+void planImages(MaterialImages& materialImages, const std::string& path, const ConvertOptions& convertOptions)
+{
+    TraceSpan scanSpan("scan", path);
+
+    for (const auto& directoryEntry : fs::directory_iterator(path)) {
+        std::string filename = directoryEntry.path().generic_string();
+
+        printf("Info: Processing '%s'\n", filename.c_str());
+
+        std::vector<PlannedImage> plannedImages;
+        std::string stem;
+        if (!scanImage(plannedImages, stem, filename)) {
+            continue;
+        }
+        if (plannedImages.empty()) {
+            printf("Info: Skipping image '%s' because of unknown role\n", filename.c_str());
+
+            continue;
+        }
+
+        for (PlannedImage& plannedImage : plannedImages) {
+            bool first = materialImages.plannedImages.empty();
+
+            if (!planImage(materialImages, plannedImage)) {
+                continue;
+            }
+
+            if (first) {
+                materialImages.stem = stem;
+            }
+        }
+    }
+
+    planOutputs(materialImages, convertOptions);
+}
+
+// Bytes of a member, which are inflated to read the image header, when only the working set is estimated
+const uint64_t ARCHIVE_HEADER_SIZE = 65536;
+
+// Classified member of an archive. Its byte data is inflated into memory, which stays valid during the conversion.
+struct ArchiveImage {
+    const ArchiveMember* member = nullptr;
+    std::string stem = "";
+    std::vector<PlannedImage> plannedImages;
+    std::vector<uint8_t> data;
+};
+
+// Classifies the members of an archive by their name, so only the images of the material are inflated. The folders inside
+// the archive are ignored. Skipped members are only reported, if not quiet.
+void scanArchive(std::vector<ArchiveImage>& archiveImages, const ZipArchive& zipArchive, bool quiet)
+{
+    for (const ArchiveMember& member : zipArchive.getMembers()) {
+        std::string filename = zipArchive.getFilename() + "/" + member.name;
+
+        if (!quiet) {
+            printf("Info: Processing '%s'\n", filename.c_str());
+        }
+
+        ArchiveImage archiveImage;
+        if (!scanImage(archiveImage.plannedImages, archiveImage.stem, filename)) {
+            continue;
+        }
+        if (archiveImage.plannedImages.empty()) {
+            if (!quiet) {
+                printf("Info: Skipping image '%s' because of unknown role\n", filename.c_str());
+            }
+
+            continue;
+        }
+
+        archiveImage.member = &member;
+        archiveImages.push_back(std::move(archiveImage));
+    }
+}
+
+// Inflates the classified members concurrently, each one from its own file handle. With a limit, only the first bytes are inflated.
+bool inflateArchive(std::string& error, std::vector<ArchiveImage>& archiveImages, const ZipArchive& zipArchive, uint64_t limit, ThreadPool& threadPool)
+{
+    std::vector<std::string> inflateErrors(archiveImages.size());
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        for (size_t i = 0; i < archiveImages.size(); i++) {
+            taskGroup.run([&archiveImages, &inflateErrors, &zipArchive, limit, i]() {
+                ArchiveImage& archiveImage = archiveImages[i];
+
+                TraceSpan inflateSpan("inflate", zipArchive.getFilename() + "/" + archiveImage.member->name);
+
+                // The size is checked against the compressed data, but a large member can still fail to allocate, which fails it like corrupt data
+                try {
+                    if (zipArchive.readMember(archiveImage.data, inflateErrors[i], *archiveImage.member, limit)) {
+                        inflateSpan.addBytesRead(std::min(archiveImage.member->compressedSize, limit));
+                    }
+                } catch (const std::exception& exception) {
+                    inflateErrors[i] = exception.what();
+                }
+
+                for (PlannedImage& plannedImage : archiveImage.plannedImages) {
+                    plannedImage.data = archiveImage.data.data();
+                    plannedImage.size = archiveImage.data.size();
+                }
+            });
+        }
+
+        taskGroup.wait();
+    }
+
+    for (const std::string& inflateError : inflateErrors) {
+        if (!inflateError.empty()) {
+            error = inflateError;
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Plans the inflated members of an archive in the order of its central directory.
+void planArchive(MaterialImages& materialImages, std::vector<ArchiveImage>& archiveImages, bool quiet)
+{
+    for (ArchiveImage& archiveImage : archiveImages) {
+        for (PlannedImage& plannedImage : archiveImage.plannedImages) {
+            bool first = materialImages.plannedImages.empty();
+
+            if (!planImage(materialImages, plannedImage, quiet)) {
+                continue;
+            }
+
+            if (first) {
+                materialImages.stem = archiveImage.stem;
+            }
+        }
+    }
+}
+
+// Classified images of one material in a folder with many materials.
+struct MaterialGroup {
+    std::string stem = "";
+    std::vector<PlannedImage> plannedImages;
+};
+
+// Scans the folder once and groups the classified images by their material stem. No image header is read yet,
+// so the groups are probed concurrently. The groups are sorted by their stem.
+bool scanMaterialGroups(std::vector<MaterialGroup>& materialGroups, std::string& error, const std::string& path)
+{
+    TraceSpan scanSpan("scan", path);
+
+    std::map<std::string, size_t> groupIndices;
+
+    std::error_code errorCode;
+    for (fs::directory_iterator it(path, errorCode); !errorCode && it != fs::directory_iterator(); it.increment(errorCode)) {
+        std::vector<PlannedImage> plannedImages;
+        std::string stem;
+        if (!scanImage(plannedImages, stem, it->path().generic_string())) {
+            continue;
+        }
+        if (plannedImages.empty()) {
+            printf("Info: Skipping image '%s' because of unknown role\n", it->path().generic_string().c_str());
+
+            continue;
+        }
+
+        auto groupIndex = groupIndices.emplace(stem, materialGroups.size());
+        if (groupIndex.second) {
+            materialGroups.emplace_back();
+            materialGroups.back().stem = stem;
+        }
+
+        for (PlannedImage& plannedImage : plannedImages) {
+            materialGroups[groupIndex.first->second].plannedImages.push_back(std::move(plannedImage));
+        }
+    }
+
+    if (errorCode) {
+        error = "Could not scan folder '" + path + "': " + errorCode.message();
+
+        return false;
+    }
+
+    std::sort(materialGroups.begin(), materialGroups.end(), [](const MaterialGroup& a, const MaterialGroup& b) { return a.stem < b.stem; });
+
+    return true;
+}
+
+// Plans the images of a group like the images of a folder. Images are probed in the order of the scan.
+void planGroup(MaterialImages& materialImages, MaterialGroup& materialGroup, const ConvertOptions& convertOptions)
+{
+    if (!materialGroup.stem.empty()) {
+        materialImages.stem = materialGroup.stem;
+    }
+
+    for (PlannedImage& plannedImage : materialGroup.plannedImages) {
+        printf("Info: Processing '%s'\n", plannedImage.filename.c_str());
+
+        planImage(materialImages, plannedImage);
+    }
+    materialGroup.plannedImages.clear();
+
+    planOutputs(materialImages, convertOptions);
+}
+
+void setWriteFlag(MaterialImages& materialImages, ImageRole imageRole)
+{
+    switch (imageRole) {
+        case IMAGE_ROLE_BASE_COLOR:
+            materialImages.writeBaseColor = true;
+            break;
+        case IMAGE_ROLE_OPACITY:
+            materialImages.writeOpacity = true;
+            break;
+        case IMAGE_ROLE_METALLIC:
+            materialImages.writeMetallic = true;
+            break;
+        case IMAGE_ROLE_ROUGHNESS:
+            materialImages.writeRoughness = true;
+            break;
+        case IMAGE_ROLE_OCCLUSION:
+            materialImages.writeOcclusion = true;
+            break;
+        case IMAGE_ROLE_NORMAL:
+            materialImages.writeNormal = true;
+            break;
+        case IMAGE_ROLE_EMISSIVE:
+            materialImages.writeEmissive = true;
+            break;
+        default:
+            break;
+    }
+}
+
+// Seeds, which separate the keys of raw, decoded, encoded and KTX2 outputs
+const uint64_t RAW_OUTPUT_SEED = 1;
+const uint64_t DECODED_OUTPUT_SEED = 2;
+const uint64_t ENCODED_OUTPUT_SEED = 3;
+const uint64_t KTX2_OUTPUT_SEED = 4;
+
+// Encoded outputs are kept instead of saved, if they are embedded into the binary glTF or kept in memory.
+bool keepEncodedData(const ConvertOptions& convertOptions)
+{
+    return convertOptions.saveBinary || convertOptions.keepOutputs;
+}
+
+bool isSyncingFiles(const ConvertOptions& convertOptions)
+{
+    return convertOptions.outputWriter && convertOptions.outputWriter->isSyncing();
+}
+
+// Saves encoded data under a temporary name, which is renamed, in the writer stage, if there is one, or at once.
+// Shared outputs are always written at once, as they have to exist, when the other materials link to them.
+bool saveOutput(EncodedData& encodedData, const std::string& savePath, bool shared, const ConvertOptions& convertOptions)
+{
+    std::vector<DataSegment> segments;
+    appendSegments(segments, encodedData);
+
+    if (convertOptions.writeGroup && !shared) {
+        convertOptions.outputWriter->write(*convertOptions.writeGroup, savePath, std::move(segments), std::move(encodedData));
+
+        return true;
+    }
+
+    TraceSpan writeSpan("write", savePath);
+    writeSpan.addBytesWritten(getEncodedSize(encodedData));
+
+    return saveSegmentsAtomically(segments, savePath, isSyncingFiles(convertOptions));
+}
+
+// Saves the original byte data of an image or keeps it as encoded data, if given.
+// Identical byte data of another material is shared instead of saved again.
+bool saveImageRaw(std::string& error, std::vector<uint8_t>& imageRaw, std::string& savePath, EncodedData* encodedData, const ConvertOptions& convertOptions)
+{
+    if (encodedData) {
+        encodedData->parts.clear();
+        encodedData->parts.push_back(std::move(imageRaw));
+
+        return true;
+    }
+
+    OutputRegistry* outputRegistry = convertOptions.outputRegistry;
+
+    uint64_t key = 0;
+    if (outputRegistry) {
+        key = hashData(imageRaw.data(), imageRaw.size(), RAW_OUTPUT_SEED);
+
+        std::string sharedPath;
+        AcquireResult acquireResult = outputRegistry->acquire(sharedPath, key, savePath);
+        if (acquireResult == ACQUIRE_RESULT_SHARED) {
+            return shareOutput(error, savePath, sharedPath, outputRegistry->getDedupMode());
+        }
+        if (acquireResult == ACQUIRE_RESULT_BUSY) {
+            outputRegistry = nullptr;
+        }
+    }
+
+    EncodedData savedData;
+    savedData.parts.push_back(std::move(imageRaw));
+
+    bool result = saveOutput(savedData, savePath, outputRegistry != nullptr, convertOptions);
+
+    if (outputRegistry) {
+        outputRegistry->complete(key, result);
+    }
+
+    if (!result) {
+        error = "Could not save image raw '" + savePath + "'";
+
+        return false;
+    }
+
+    return true;
+}
+
+// Encodes and saves an image or keeps it as encoded data, if given.
+// An image with the same pixels as the one of another material is shared instead of encoded again.
+bool saveImage(std::string& error, const ImageDataResource& image, std::string& savePath, EncodedData* encodedData, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    OutputRegistry* outputRegistry = encodedData ? nullptr : convertOptions.outputRegistry;
+
+    uint64_t key = 0;
+    if (outputRegistry) {
+        Hasher hasher(DECODED_OUTPUT_SEED);
+        hasher.update(static_cast<uint64_t>(image.width));
+        hasher.update(static_cast<uint64_t>(image.height));
+        hasher.update(static_cast<uint64_t>(image.channels));
+        hasher.update(static_cast<uint64_t>(convertOptions.pngOptions.pngEncoder));
+        hasher.update(static_cast<uint64_t>(convertOptions.pngOptions.compressionLevel));
+        hasher.update(image.pixels.data(), static_cast<size_t>(image.width) * image.height * image.channels);
+        key = hasher.finish();
+
+        std::string sharedPath;
+        AcquireResult acquireResult = outputRegistry->acquire(sharedPath, key, savePath);
+        if (acquireResult == ACQUIRE_RESULT_SHARED) {
+            return shareOutput(error, savePath, sharedPath, outputRegistry->getDedupMode());
+        }
+        if (acquireResult == ACQUIRE_RESULT_BUSY) {
+            outputRegistry = nullptr;
+        }
+    }
+
+    // Encoded data, which is not embedded, is only kept until it is written
+
+    EncodedData savedData;
+    EncodedData& outputData = encodedData ? *encodedData : savedData;
+
+    bool result = false;
+    {
+        TraceSpan encodeSpan("encode", savePath);
+        encodeSpan.addPixels(static_cast<uint64_t>(image.width) * image.height);
+
+        result = encodePng(outputData, image.pixels.data(), image.width, image.height, image.channels, convertOptions.pngOptions, threadPool);
+    }
+
+    if (result && !encodedData) {
+        result = saveOutput(outputData, savePath, outputRegistry != nullptr, convertOptions);
+    }
+
+    if (outputRegistry) {
+        outputRegistry->complete(key, result);
+    }
+
+    if (!result) {
+        error = "Could not save image '" + savePath + "'";
+
+        return false;
+    }
+
+    return true;
+}
+
+// Encodes the KTX2 copy of a packed image, which is saved next to it or embedded like the image. Images, which were not decoded, have no copy.
+// The copy is named after the path of the image, so it is saved before the image may be shared under another path.
+bool saveKtx2Image(std::string& error, const ImageDataResource& image, bool normal, bool srgb, const std::string& path, Ktx2Output& ktx2Output, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    if (!convertOptions.saveKtx2 || image.channels == 0) {
+        return true;
+    }
+
+    ktx2Output.path = path.substr(0, path.rfind('.')) + ".ktx2";
+
+    Ktx2Options ktx2Options;
+    ktx2Options.bc7Quality = convertOptions.bc7Quality;
+    ktx2Options.srgb = srgb;
+    ktx2Options.normal = normal;
+
+    OutputRegistry* outputRegistry = keepEncodedData(convertOptions) ? nullptr : convertOptions.outputRegistry;
+
+    uint64_t key = 0;
+    if (outputRegistry) {
+        Hasher hasher(KTX2_OUTPUT_SEED);
+        hasher.update(static_cast<uint64_t>(image.width));
+        hasher.update(static_cast<uint64_t>(image.height));
+        hasher.update(static_cast<uint64_t>(image.channels));
+        hasher.update(static_cast<uint64_t>(ktx2Options.bc7Quality));
+        hasher.update(static_cast<uint64_t>(ktx2Options.srgb));
+        hasher.update(static_cast<uint64_t>(ktx2Options.normal));
+        hasher.update(image.pixels.data(), static_cast<size_t>(image.width) * image.height * image.channels);
+        key = hasher.finish();
+
+        std::string sharedPath;
+        AcquireResult acquireResult = outputRegistry->acquire(sharedPath, key, ktx2Output.path);
+        if (acquireResult == ACQUIRE_RESULT_SHARED) {
+            return shareOutput(error, ktx2Output.path, sharedPath, outputRegistry->getDedupMode());
+        }
+        if (acquireResult == ACQUIRE_RESULT_BUSY) {
+            outputRegistry = nullptr;
+        }
+    }
+
+    bool result = false;
+    {
+        TraceSpan encodeSpan("ktx2", ktx2Output.path);
+        encodeSpan.addPixels(static_cast<uint64_t>(image.width) * image.height);
+
+        result = encodeKtx2(ktx2Output.data, image, ktx2Options, threadPool);
+    }
+
+    if (result && !keepEncodedData(convertOptions)) {
+        result = saveOutput(ktx2Output.data, ktx2Output.path, outputRegistry != nullptr, convertOptions);
+
+        ktx2Output.data.parts.clear();
+    }
+
+    if (outputRegistry) {
+        outputRegistry->complete(key, result);
+    }
+
+    if (!result) {
+        error = "Could not save image '" + ktx2Output.path + "'";
+
+        return false;
+    }
+
+    return true;
+}
+
+// Shares a streamed output, if its encoded bytes are identical to the output of another material.
+bool shareStreamedImage(std::string& error, std::string& savePath, const ConvertOptions& convertOptions)
+{
+    OutputRegistry* outputRegistry = convertOptions.outputRegistry;
+
+    uint64_t key = 0;
+    if (!hashFile(key, savePath)) {
+        error = "Could not load image '" + savePath + "'";
+
+        return false;
+    }
+    key ^= ENCODED_OUTPUT_SEED;
+
+    std::string sharedPath;
+    AcquireResult acquireResult = outputRegistry->acquire(sharedPath, key, savePath);
+    if (acquireResult == ACQUIRE_RESULT_FIRST) {
+        outputRegistry->complete(key, true);
+    }
+    if (acquireResult != ACQUIRE_RESULT_SHARED) {
+        return true;
+    }
+
+    if (outputRegistry->getDedupMode() == DEDUP_MODE_REFERENCE) {
+        std::error_code errorCode;
+        fs::remove(savePath, errorCode);
+    }
+
+    return shareOutput(error, savePath, sharedPath, outputRegistry->getDedupMode());
+}
+
+const char* getRoleName(ImageRole imageRole)
+{
+    switch (imageRole) {
+        case IMAGE_ROLE_BASE_COLOR:
+            return "base color";
+        case IMAGE_ROLE_OPACITY:
+            return "alpha";
+        case IMAGE_ROLE_METALLIC:
+            return "metallic";
+        case IMAGE_ROLE_ROUGHNESS:
+            return "roughness";
+        case IMAGE_ROLE_OCCLUSION:
+            return "occlusion";
+        case IMAGE_ROLE_NORMAL:
+            return "normal";
+        case IMAGE_ROLE_EMISSIVE:
+            return "emissive";
+        default:
+            break;
+    }
+
+    return "unknown";
+}
+
+// Roles, which can be replaced by a factor, if their source is constant.
+bool isFoldableRole(ImageRole imageRole)
+{
+    return imageRole == IMAGE_ROLE_BASE_COLOR || imageRole == IMAGE_ROLE_OPACITY || imageRole == IMAGE_ROLE_METALLIC || imageRole == IMAGE_ROLE_ROUGHNESS || imageRole == IMAGE_ROLE_OCCLUSION;
+}
+
+// Color images are checked in the color channels, the others in their source channel.
+std::vector<uint32_t> getFoldChannels(ImageRole imageRole, uint32_t channels, uint32_t sourceChannel)
+{
+    if (imageRole == IMAGE_ROLE_BASE_COLOR && channels >= 3) {
+        return { 0, 1, 2 };
+    }
+
+    return { sourceChannel };
+}
+
+// Stores the value of a uniform source. Returns false, if it can not be expressed as factor:
+// There is no occlusion factor, so only a white occlusion image, which has no effect, is dropped.
+bool setConstantSource(ConstantSource& constantSource, ImageRole imageRole, const uint8_t* firstPixel, uint32_t channels, uint32_t sourceChannel)
+{
+    std::vector<uint32_t> foldChannels = getFoldChannels(imageRole, channels, sourceChannel);
+    for (uint32_t i = 0; i < 3; i++) {
+        constantSource.values[i] = firstPixel[foldChannels[std::min(i, static_cast<uint32_t>(foldChannels.size()) - 1)]];
+    }
+
+    if (imageRole == IMAGE_ROLE_OCCLUSION && constantSource.values[0] != 255) {
+        return false;
+    }
+
+    constantSource.constant = true;
+
+    return true;
+}
+
+// Keeps one channel for gray colors and the alpha channel only if requested.
+bool minimizeChannels(ImageDataResource& image, bool keepAlpha)
+{
+    if (image.channels < 3) {
+        return true;
+    }
+
+    std::vector<uint32_t> channels = { 0, 1, 2 };
+    if (isGrayImage(image)) {
+        channels = { 0 };
+    }
+    if (keepAlpha && image.channels == 4) {
+        channels.push_back(3);
+    }
+
+    if (channels.size() == image.channels) {
+        return true;
+    }
+
+    return compactChannels(image, channels);
+}
+
+bool getWriteFlag(const MaterialImages& materialImages, ImageRole imageRole)
+{
+    switch (imageRole) {
+        case IMAGE_ROLE_BASE_COLOR:
+            return materialImages.writeBaseColor;
+        case IMAGE_ROLE_OPACITY:
+            return materialImages.writeOpacity;
+        case IMAGE_ROLE_METALLIC:
+            return materialImages.writeMetallic;
+        case IMAGE_ROLE_ROUGHNESS:
+            return materialImages.writeRoughness;
+        case IMAGE_ROLE_OCCLUSION:
+            return materialImages.writeOcclusion;
+        case IMAGE_ROLE_NORMAL:
+            return materialImages.writeNormal;
+        case IMAGE_ROLE_EMISSIVE:
+            return materialImages.writeEmissive;
+        default:
+            break;
+    }
+
+    return false;
+}
+
+// Output and the image roles, which are packed into it.
+struct PlannedOutput {
+    std::string path = "";
+    std::vector<ImageRole> imageRoles;
+};
+
+std::vector<PlannedOutput> getPlannedOutputs(const MaterialImages& materialImages)
+{
+    return {
+        { materialImages.baseColorPath, { IMAGE_ROLE_BASE_COLOR, IMAGE_ROLE_OPACITY } },
+        { materialImages.metallicRoughnessPath, { IMAGE_ROLE_METALLIC, IMAGE_ROLE_ROUGHNESS, IMAGE_ROLE_OCCLUSION } },
+        { materialImages.normalPath, { IMAGE_ROLE_NORMAL } },
+        { materialImages.emissivePath, { IMAGE_ROLE_EMISSIVE } }
+    };
+}
+
+uint64_t getFloatBits(float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+// Compares the inputs and options with the previous manifest. Outputs, which keys still match and which files still exist, are reused:
+// Their sources are removed from the plan and reusedImageRoles receives the roles found in them. Returns true, if the whole material is unchanged.
+// cacheKeys receives the key of each planned output or zero, if the output has no source.
+bool applyCache(std::vector<uint64_t>& cacheKeys, std::vector<ImageRole>& reusedImageRoles, CacheManifest& cacheManifest, MaterialImages& materialImages, const CacheManifest& previousManifest, const ConvertOptions& convertOptions)
+{
+    std::vector<PlannedImage>& plannedImages = materialImages.plannedImages;
+    std::vector<PlannedOutput> plannedOutputs = getPlannedOutputs(materialImages);
+
+    cacheKeys.clear();
+
+    // Options, which change the bytes of the outputs
+
+    Hasher optionsHasher;
+    optionsHasher.update(static_cast<uint64_t>(convertOptions.pngOptions.pngEncoder));
+    optionsHasher.update(static_cast<uint64_t>(convertOptions.pngOptions.compressionLevel));
+    optionsHasher.update(static_cast<uint64_t>(convertOptions.keepBaseColorImageData));
+    optionsHasher.update(static_cast<uint64_t>(convertOptions.keepNormalImageData));
+    optionsHasher.update(static_cast<uint64_t>(convertOptions.keepEmissiveImageData));
+    optionsHasher.update(static_cast<uint64_t>(convertOptions.foldConstants));
+    uint64_t optionsHash = optionsHasher.finish();
+
+    // The channels of a packed image share the hash of its file
+    std::vector<uint64_t> inputHashes(plannedImages.size(), 0);
+    for (size_t i = 0; i < plannedImages.size(); i++) {
+        size_t first = 0;
+        while (!isSameSource(plannedImages[first], plannedImages[i])) {
+            first++;
+        }
+        if (first < i) {
+            inputHashes[i] = inputHashes[first];
+
+            continue;
+        }
+
+        if (!hashInput(inputHashes[i], cacheManifest, previousManifest, plannedImages[i].filename)) {
+            printf("Warning: Could not hash '%s'\n", plannedImages[i].filename.c_str());
+
+            return false;
+        }
+    }
+
+    cacheKeys.assign(plannedOutputs.size(), 0);
+
+    Hasher materialHasher(optionsHash);
+    materialHasher.update(getFloatBits(convertOptions.defaultMetallicFactor));
+    materialHasher.update(getFloatBits(convertOptions.defaultRoughnessFactor));
+    materialHasher.update(static_cast<uint64_t>(convertOptions.saveBinary));
+    materialHasher.update(materialImages.stem);
+
+    bool allReused = true;
+    std::vector<uint8_t> reusedRoles(IMAGE_ROLE_EMISSIVE + 1, 0);
+
+    for (size_t output = 0; output < plannedOutputs.size(); output++) {
+        const PlannedOutput& plannedOutput = plannedOutputs[output];
+
+        Hasher outputHasher(optionsHash);
+        bool hasSource = false;
+        for (ImageRole imageRole : plannedOutput.imageRoles) {
+            for (size_t i = 0; i < plannedImages.size(); i++) {
+                if (plannedImages[i].imageRole == imageRole) {
+                    outputHasher.update(static_cast<uint64_t>(imageRole));
+                    outputHasher.update(static_cast<uint64_t>(plannedImages[i].sourceChannel));
+                    outputHasher.update(inputHashes[i]);
+                    hasSource = true;
+                }
+            }
+        }
+
+        if (!hasSource) {
+            continue;
+        }
+
+        cacheKeys[output] = outputHasher.finish();
+        materialHasher.update(plannedOutput.path);
+        materialHasher.update(cacheKeys[output]);
+
+        // Embedded images are only reused with the whole binary glTF, as it is written in one pass
+        if (convertOptions.saveBinary) {
+            continue;
+        }
+
+        // Outputs, which are completely replaced by factors, have no file
+        auto it = previousManifest.outputs.find(plannedOutput.path);
+        if (it == previousManifest.outputs.end() || it->second.key != cacheKeys[output] || (!it->second.imageRoles.empty() && !isFileUnchanged(plannedOutput.path, it->second.size))) {
+            allReused = false;
+
+            continue;
+        }
+
+        printf("Info: Reusing unchanged '%s'\n", plannedOutput.path.c_str());
+
+        cacheManifest.outputs[plannedOutput.path] = it->second;
+
+        for (ImageRole imageRole : plannedOutput.imageRoles) {
+            reusedRoles[imageRole] = 1;
+        }
+        for (uint32_t imageRole : it->second.imageRoles) {
+            if (imageRole <= IMAGE_ROLE_EMISSIVE) {
+                reusedImageRoles.push_back(static_cast<ImageRole>(imageRole));
+            }
+            if (imageRole == IMAGE_ROLE_OPACITY && it->second.alphaCoverage <= ALPHA_COVERAGE_BLEND) {
+                materialImages.alphaCoverage = static_cast<AlphaCoverage>(it->second.alphaCoverage);
+            }
+        }
+        for (const CachedConstant& cachedConstant : it->second.constants) {
+            if (cachedConstant.imageRole <= IMAGE_ROLE_EMISSIVE) {
+                ConstantSource& constantSource = materialImages.constantSources[cachedConstant.imageRole];
+                constantSource.constant = true;
+                memcpy(constantSource.values, cachedConstant.values, sizeof(constantSource.values));
+            }
+        }
+    }
+
+    cacheManifest.materialKey = materialHasher.finish();
+    cacheManifest.savename = previousManifest.savename;
+
+    std::error_code errorCode;
+    if (cacheManifest.materialKey == previousManifest.materialKey && allReused && !previousManifest.savename.empty() && fs::is_regular_file(previousManifest.savename, errorCode)) {
+        return true;
+    }
+
+    plannedImages.erase(std::remove_if(plannedImages.begin(), plannedImages.end(), [&reusedRoles](const PlannedImage& plannedImage) { return reusedRoles[plannedImage.imageRole] != 0; }), plannedImages.end());
+
+    return false;
+}
+
+// Records the outputs, which were built in this run.
+void updateCache(CacheManifest& cacheManifest, const std::vector<uint64_t>& cacheKeys, const MaterialImages& materialImages)
+{
+    std::vector<PlannedOutput> plannedOutputs = getPlannedOutputs(materialImages);
+
+    for (size_t output = 0; output < plannedOutputs.size(); output++) {
+        const PlannedOutput& plannedOutput = plannedOutputs[output];
+
+        if (cacheKeys[output] == 0 || cacheManifest.outputs.count(plannedOutput.path) > 0) {
+            continue;
+        }
+
+        CachedOutput cachedOutput;
+        cachedOutput.key = cacheKeys[output];
+        for (ImageRole imageRole : plannedOutput.imageRoles) {
+            if (getWriteFlag(materialImages, imageRole)) {
+                cachedOutput.imageRoles.push_back(static_cast<uint32_t>(imageRole));
+
+                if (imageRole == IMAGE_ROLE_OPACITY) {
+                    cachedOutput.alphaCoverage = static_cast<uint32_t>(materialImages.alphaCoverage);
+                }
+            }
+
+            const ConstantSource& constantSource = materialImages.constantSources[imageRole];
+            if (constantSource.constant) {
+                CachedConstant cachedConstant;
+                cachedConstant.imageRole = static_cast<uint32_t>(imageRole);
+                memcpy(cachedConstant.values, constantSource.values, sizeof(cachedConstant.values));
+                cachedOutput.constants.push_back(cachedConstant);
+            }
+        }
+
+        if (!cachedOutput.imageRoles.empty()) {
+            std::error_code errorCode;
+            uintmax_t fileSize = fs::file_size(plannedOutput.path, errorCode);
+            if (errorCode) {
+                continue;
+            }
+            cachedOutput.size = static_cast<uint64_t>(fileSize);
+        } else if (cachedOutput.constants.empty()) {
+            continue;
+        }
+
+        cacheManifest.outputs[plannedOutput.path] = cachedOutput;
+    }
+}
+
+// Reads the original byte data of a planned image from its file or from memory.
+bool loadPlannedFile(std::vector<uint8_t>& imageRaw, const PlannedImage& plannedImage)
+{
+    if (plannedImage.data) {
+        imageRaw.assign(plannedImage.data, plannedImage.data + plannedImage.size);
+
+        return true;
+    }
+
+    return loadFile(imageRaw, plannedImage.filename);
+}
+
+bool loadPlannedImage(ImageDataResource& imageDataResource, const PlannedImage& plannedImage, uint32_t desiredChannels)
+{
+    if (plannedImage.data) {
+        return loadImage(imageDataResource, plannedImage.data, plannedImage.size, desiredChannels);
+    }
+
+    return loadImage(imageDataResource, plannedImage.filename, desiredChannels);
+}
+
+// PNG files are read row by row, so a scan stopping at the first differing row does not decode the whole image.
+bool isRowReadable(const PlannedImage& plannedImage)
+{
+    return !plannedImage.data && toLowercase(plannedImage.extension) == ".png";
+}
+
+// The file of a kept image is passed through, unless its byte data is needed in memory: It is embedded, kept as output or hashed to share it.
+bool canPassThrough(const PlannedImage& plannedImage, const ConvertOptions& convertOptions)
+{
+    return !plannedImage.data && !keepEncodedData(convertOptions) && !convertOptions.outputRegistry;
+}
+
+// Copies or hardlinks the file of a kept image to savePath without reading it into memory.
+bool passImageThrough(std::string& error, const PlannedImage& plannedImage, const std::string& savePath, const ConvertOptions& convertOptions)
+{
+    // The output can already be the source file itself or a hardlink to it from a previous run. The renamed copy replaces
+    // such a hardlink, but the source file itself is kept
+    std::error_code errorCode;
+    if (fs::equivalent(plannedImage.filename, savePath, errorCode) && !errorCode) {
+        uintmax_t linkCount = fs::hard_link_count(savePath, errorCode);
+        if (convertOptions.passthroughMode == PASSTHROUGH_MODE_HARDLINK || errorCode || linkCount <= 1) {
+            return true;
+        }
+    }
+
+    if (convertOptions.passthroughMode == PASSTHROUGH_MODE_HARDLINK) {
+        TraceSpan linkSpan("write", savePath);
+
+        errorCode.clear();
+        fs::remove(savePath, errorCode);
+
+        errorCode.clear();
+        fs::create_hard_link(plannedImage.filename, savePath, errorCode);
+        if (!errorCode) {
+            return true;
+        }
+    }
+
+    // Hardlinks fall back to a copy e.g. between file systems
+    if (convertOptions.writeGroup) {
+        convertOptions.outputWriter->copy(*convertOptions.writeGroup, plannedImage.filename, savePath);
+
+        return true;
+    }
+
+    TraceSpan writeSpan("write", savePath);
+
+    if (!copyFileAtomically(plannedImage.filename, savePath, isSyncingFiles(convertOptions))) {
+        error = "Could not copy image '" + savePath + "'";
+
+        return false;
+    }
+    writeSpan.addFileWritten(savePath);
+
+    return true;
+}
+
+// Saves a kept image, which byte data was read before, unless its file is passed through.
+bool saveKeptImage(std::string& error, const PlannedImage& plannedImage, std::vector<uint8_t>& imageRaw, std::string& savePath, EncodedData* encodedData, const ConvertOptions& convertOptions)
+{
+    if (canPassThrough(plannedImage, convertOptions)) {
+        return passImageThrough(error, plannedImage, savePath, convertOptions);
+    }
+
+    return saveImageRaw(error, imageRaw, savePath, encodedData, convertOptions);
+}
+
+// Keeps the original byte data of a base color, normal or emissive image without decoding the pixels.
+bool copyImage(std::string& error, const PlannedImage& plannedImage, std::string& savePath, EncodedData* encodedData, const ConvertOptions& convertOptions)
+{
+    if (canPassThrough(plannedImage, convertOptions)) {
+        return passImageThrough(error, plannedImage, savePath, convertOptions);
+    }
+
+    std::vector<uint8_t> imageRaw;
+    {
+        TraceSpan readSpan("read", plannedImage.filename);
+        if (!loadPlannedFile(imageRaw, plannedImage)) {
+            error = "Could not load image raw '" + plannedImage.filename + "'";
+
+            return false;
+        }
+        readSpan.addBytesRead(imageRaw.size());
+    }
+
+    return saveImageRaw(error, imageRaw, savePath, encodedData, convertOptions);
+}
+
+// Returns the encoded data of an output, if it is embedded into the binary glTF.
+EncodedData* getEmbeddedData(EncodedData& encodedData, const ConvertOptions& convertOptions)
+{
+    return keepEncodedData(convertOptions) ? &encodedData : nullptr;
+}
+
+// Outputs of a level of detail, which share the flags and factors of the material. The images are always encoded again as PNG.
+void initLevelImages(MaterialImages& levelImages, const MaterialImages& materialImages, uint32_t level)
+{
+    levelImages.stem = materialImages.stem + "_lod" + std::to_string(level);
+    levelImages.outputFolder = materialImages.outputFolder;
+
+    levelImages.writeBaseColor = materialImages.writeBaseColor;
+    levelImages.writeOpacity = materialImages.writeOpacity;
+    levelImages.writeMetallic = materialImages.writeMetallic;
+    levelImages.writeRoughness = materialImages.writeRoughness;
+    levelImages.writeOcclusion = materialImages.writeOcclusion;
+    levelImages.writeNormal = materialImages.writeNormal;
+    levelImages.writeEmissive = materialImages.writeEmissive;
+
+    levelImages.baseColorPath = getOutputPath(levelImages, levelImages.stem + "_baseColor.png");
+    levelImages.metallicRoughnessPath = getOutputPath(levelImages, levelImages.stem + "_metallicRoughness.png");
+    levelImages.normalPath = getOutputPath(levelImages, levelImages.stem + "_normal.png");
+    levelImages.emissivePath = getOutputPath(levelImages, levelImages.stem + "_emissive.png");
+
+    for (uint32_t imageRole = 0; imageRole <= IMAGE_ROLE_EMISSIVE; imageRole++) {
+        levelImages.constantSources[imageRole] = materialImages.constantSources[imageRole];
+    }
+    levelImages.alphaCoverage = materialImages.alphaCoverage;
+}
+
+// Saves one packed image and its KTX2 copy for every level of detail. Each level is downscaled from the previous one.
+bool saveImageLevels(std::string& error, const ImageDataResource& image, bool normal, bool srgb, std::vector<MaterialImages>& lodImages, std::string MaterialImages::*path, EncodedData MaterialImages::*data, Ktx2Output MaterialImages::*ktx2Output, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    BufferPool& bufferPool = getImageBufferPool();
+
+    ImageDataResource previousImage;
+    const ImageDataResource* sourceImage = &image;
+
+    for (MaterialImages& levelImages : lodImages) {
+        ImageDataResource levelImage;
+        {
+            TraceSpan downscaleSpan("downscale", levelImages.*path);
+            if (!downscaleImage(levelImage, *sourceImage, normal, &bufferPool)) {
+                error = "Could not downscale image '" + levelImages.*path + "'";
+
+                return false;
+            }
+            downscaleSpan.addPixels(static_cast<uint64_t>(levelImage.width) * levelImage.height);
+        }
+
+        if (!saveKtx2Image(error, levelImage, normal, srgb, levelImages.*path, levelImages.*ktx2Output, convertOptions, threadPool)) {
+            return false;
+        }
+
+        if (!saveImage(error, levelImage, levelImages.*path, getEmbeddedData(levelImages.*data, convertOptions), convertOptions, threadPool)) {
+            return false;
+        }
+
+        previousImage = std::move(levelImage);
+        sourceImage = &previousImage;
+    }
+
+    return true;
+}
+
+// Decodes all images at once, packs them in memory and encodes the outputs.
+bool packImages(ConvertResult& convertResult, MaterialImages& materialImages, std::vector<MaterialImages>& lodImages, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    const std::vector<PlannedImage>& plannedImages = materialImages.plannedImages;
+
+    ImageDataResource baseColorImage;
+
+    std::vector<uint8_t> baseColorImageRaw;
+
+    ImageDataResource metallicRoughnessImage;
+
+    std::vector<uint8_t> metallicRoughnessImageRaw;
+
+    ImageDataResource normalImage;
+
+    std::vector<uint8_t> normalImageRaw;
+
+    ImageDataResource emissiveImage;
+
+    std::vector<uint8_t> emissiveImageRaw;
+
+    bool plannedRoles[IMAGE_ROLE_EMISSIVE + 1] = {};
+    for (const PlannedImage& plannedImage : plannedImages) {
+        plannedRoles[plannedImage.imageRole] = true;
+    }
+
+    BufferPool& bufferPool = getImageBufferPool();
+
+    // The levels of detail and the KTX2 copy are encoded from the decoded pixels
+    bool decodePixels = convertOptions.lodCount > 0 || convertOptions.saveKtx2;
+
+    // A kept image is only packed, when its decoded pixels are needed
+    bool packBaseColor = (plannedRoles[IMAGE_ROLE_BASE_COLOR] || plannedRoles[IMAGE_ROLE_OPACITY]) && (!materialImages.keepBaseColor || decodePixels);
+    bool packMetallicRoughness = (plannedRoles[IMAGE_ROLE_METALLIC] || plannedRoles[IMAGE_ROLE_ROUGHNESS] || plannedRoles[IMAGE_ROLE_OCCLUSION]) && (!materialImages.keepMetallicRoughness || decodePixels);
+
+    if (!plannedImages.empty()) {
+        uint32_t width = plannedImages[0].imageInfo.width;
+        uint32_t height = plannedImages[0].imageInfo.height;
+
+        // Only the packed images with a source are allocated and only the channels without a source are filled
+
+        if (packBaseColor) {
+            baseColorImage.width = width;
+            baseColorImage.height = height;
+            baseColorImage.channels = 4;
+            if (!baseColorImage.pixels.allocate(static_cast<size_t>(baseColorImage.channels) * baseColorImage.width * baseColorImage.height, &bufferPool)) {
+                convertResult.errorCode = CONVERT_ERROR_ALLOCATE;
+                convertResult.error = "Could not allocate base color image";
+                printf("Error: %s\n", convertResult.error.c_str());
+
+                return false;
+            }
+
+            std::vector<uint32_t> defaultChannels;
+            if (!plannedRoles[IMAGE_ROLE_BASE_COLOR]) {
+                defaultChannels = { 0, 1, 2 };
+            }
+            if (!plannedRoles[IMAGE_ROLE_OPACITY]) {
+                defaultChannels.push_back(3);
+            }
+            fillChannels(baseColorImage, defaultChannels, 255);
+        }
+
+        //
+
+        if (packMetallicRoughness) {
+            metallicRoughnessImage.width = width;
+            metallicRoughnessImage.height = height;
+            metallicRoughnessImage.channels = 3;
+            if (!metallicRoughnessImage.pixels.allocate(static_cast<size_t>(metallicRoughnessImage.channels) * metallicRoughnessImage.width * metallicRoughnessImage.height, &bufferPool)) {
+                convertResult.errorCode = CONVERT_ERROR_ALLOCATE;
+                convertResult.error = "Could not allocate metallic roughness image";
+                printf("Error: %s\n", convertResult.error.c_str());
+
+                return false;
+            }
+
+            std::vector<uint32_t> defaultChannels;
+            if (!plannedRoles[IMAGE_ROLE_OCCLUSION]) {
+                defaultChannels.push_back(0);
+            }
+            if (!plannedRoles[IMAGE_ROLE_ROUGHNESS]) {
+                defaultChannels.push_back(1);
+            }
+            if (!plannedRoles[IMAGE_ROLE_METALLIC]) {
+                defaultChannels.push_back(2);
+            }
+            fillChannels(metallicRoughnessImage, defaultChannels, 255);
+        }
+
+        // Normal and emissive images are allocated, when they are decoded
+    }
+
+    // Decode the images in parallel and pack each one, as soon as it is available
+
+    // Packing into the same image is serialized, as the vector kernels write whole pixels
+
+    std::mutex baseColorMutex;
+    std::mutex metallicRoughnessMutex;
+
+    std::vector<uint8_t> foundImages(plannedImages.size(), 0);
+    std::vector<std::string> imageErrors(plannedImages.size());
+    std::vector<ConstantSource> constantSources(plannedImages.size());
+
+    // The channels of a packed image are decoded once and moved in one pass, so only its first planned image is processed
+
+    std::vector<std::vector<size_t>> channelIndices(plannedImages.size());
+    for (size_t i = 0; i < plannedImages.size(); i++) {
+        size_t first = 0;
+        while (!isSameSource(plannedImages[first], plannedImages[i])) {
+            first++;
+        }
+
+        channelIndices[first].push_back(i);
+    }
+
+    auto processImage = [&](size_t i) {
+        const PlannedImage& plannedImage = plannedImages[i];
+        const std::string& filename = plannedImage.filename;
+
+        // Original byte data is kept without decoding the pixels. Files, which are passed through, are not read at all
+
+        std::vector<uint8_t>* imageRaw = nullptr;
+        if (plannedImage.imageRole == IMAGE_ROLE_BASE_COLOR && materialImages.keepBaseColor) {
+            imageRaw = &baseColorImageRaw;
+        } else if (isMetallicRoughnessRole(plannedImage.imageRole) && materialImages.keepMetallicRoughness) {
+            imageRaw = &metallicRoughnessImageRaw;
+        } else if (plannedImage.imageRole == IMAGE_ROLE_NORMAL && convertOptions.keepNormalImageData) {
+            imageRaw = &normalImageRaw;
+        } else if (plannedImage.imageRole == IMAGE_ROLE_EMISSIVE && convertOptions.keepEmissiveImageData) {
+            imageRaw = &emissiveImageRaw;
+        }
+
+        // A kept packed image keeps all its channels, so a channel replaced by a factor would be applied twice
+        bool foldConstants = convertOptions.foldConstants && !(imageRaw && channelIndices[i].size() > 1);
+
+        if (imageRaw) {
+            if (!decodePixels && foldConstants && isFoldableRole(plannedImage.imageRole) && isRowReadable(plannedImage)) {
+                TraceSpan prescanSpan("prescan", filename);
+
+                bool uniform = false;
+                std::vector<uint8_t> firstPixel;
+                if (scanUniformImage(uniform, firstPixel, filename, getFoldChannels(plannedImage.imageRole, plannedImage.imageInfo.channels, plannedImage.sourceChannel), convertOptions.bandHeight) && uniform) {
+                    if (setConstantSource(constantSources[i], plannedImage.imageRole, firstPixel.data(), static_cast<uint32_t>(firstPixel.size()), plannedImage.sourceChannel)) {
+                        printf("Info: Found constant %s\n", getRoleName(plannedImage.imageRole));
+
+                        foundImages[i] = 1;
+
+                        return;
+                    }
+                }
+            }
+
+            if (!canPassThrough(plannedImage, convertOptions)) {
+                TraceSpan readSpan("read", filename);
+                if (!loadPlannedFile(*imageRaw, plannedImage)) {
+                    imageErrors[i] = "Could not load image raw '" + filename + "'";
+
+                    return;
+                }
+                readSpan.addBytesRead(imageRaw->size());
+            }
+
+            // With decoded pixels, the kept image is only found, once it could be decoded
+            if (!decodePixels) {
+                for (size_t j : channelIndices[i]) {
+                    printf("Info: Found %s\n", getRoleName(plannedImages[j].imageRole));
+
+                    foundImages[j] = 1;
+                }
+
+                return;
+            }
+        }
+
+        // Color images are expanded to at least three channels
+
+        uint32_t desiredChannels = 0;
+        if ((plannedImage.imageRole == IMAGE_ROLE_BASE_COLOR || plannedImage.imageRole == IMAGE_ROLE_NORMAL || plannedImage.imageRole == IMAGE_ROLE_EMISSIVE) && plannedImage.imageInfo.channels < 3) {
+            desiredChannels = 3;
+        }
+
+        ImageDataResource imageDataResource;
+        {
+            TraceSpan decodeSpan("decode", filename);
+            if (plannedImage.data) {
+                decodeSpan.addBytesRead(plannedImage.size);
+            } else {
+                decodeSpan.addFileRead(filename);
+            }
+            if (!loadPlannedImage(imageDataResource, plannedImage, desiredChannels)) {
+                printf("Warning: Skipping image '%s' because could not decode\n", filename.c_str());
+
+                return;
+            }
+            decodeSpan.addPixels(static_cast<uint64_t>(imageDataResource.width) * imageDataResource.height);
+        }
+
+        if (imageRaw) {
+            for (size_t j : channelIndices[i]) {
+                foundImages[j] = 1;
+            }
+        }
+
+        // Constant sources become factors and are not packed. Each channel of a packed image is checked on its own
+
+        std::vector<size_t> packedIndices;
+        for (size_t j : channelIndices[i]) {
+            const PlannedImage& channelImage = plannedImages[j];
+
+            if (foldConstants && isFoldableRole(channelImage.imageRole)) {
+                std::vector<uint32_t> foldChannels = getFoldChannels(channelImage.imageRole, imageDataResource.channels, channelImage.sourceChannel);
+                if (isUniformImage(imageDataResource, foldChannels) && setConstantSource(constantSources[j], channelImage.imageRole, imageDataResource.pixels.data(), imageDataResource.channels, channelImage.sourceChannel)) {
+                    printf("Info: Found constant %s\n", getRoleName(channelImage.imageRole));
+
+                    foundImages[j] = 1;
+
+                    continue;
+                }
+            }
+
+            packedIndices.push_back(j);
+        }
+
+        if (packedIndices.empty()) {
+            return;
+        }
+
+        //
+
+        TraceSpan packSpan("pack", filename);
+        packSpan.addPixels(static_cast<uint64_t>(imageDataResource.width) * imageDataResource.height);
+
+        if (plannedImage.imageRole == IMAGE_ROLE_BASE_COLOR) {
+            {
+                std::lock_guard<std::mutex> lock(baseColorMutex);
+                swizzleChannels(baseColorImage, imageDataResource, { { 0, 0 }, { 1, 1 }, { 2, 2 } });
+            }
+
+            printf("Info: Found base color\n");
+
+            foundImages[i] = 1;
+        }
+
+        if (plannedImage.imageRole == IMAGE_ROLE_OPACITY) {
+            {
+                std::lock_guard<std::mutex> lock(baseColorMutex);
+                swizzleChannels(baseColorImage, imageDataResource, { { plannedImage.sourceChannel, 3 } });
+            }
+
+            printf("Info: Found alpha\n");
+
+            foundImages[i] = 1;
+        }
+
+        if (isMetallicRoughnessRole(plannedImage.imageRole)) {
+            // The channels of a packed image are reordered in one pass
+            std::vector<ChannelMove> channelMoves;
+            for (size_t j : packedIndices) {
+                channelMoves.push_back({ plannedImages[j].sourceChannel, getMetallicRoughnessChannel(plannedImages[j].imageRole) });
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(metallicRoughnessMutex);
+                swizzleChannels(metallicRoughnessImage, imageDataResource, channelMoves);
+            }
+
+            for (size_t j : packedIndices) {
+                printf("Info: Found %s\n", getRoleName(plannedImages[j].imageRole));
+
+                foundImages[j] = 1;
+            }
+        }
+
+        if (plannedImage.imageRole == IMAGE_ROLE_NORMAL) {
+            if (imageDataResource.channels == 3) {
+                normalImage = std::move(imageDataResource);
+            } else {
+                normalImage.width = imageDataResource.width;
+                normalImage.height = imageDataResource.height;
+                normalImage.channels = 3;
+                if (!normalImage.pixels.allocate(static_cast<size_t>(normalImage.channels) * normalImage.width * normalImage.height, &bufferPool)) {
+                    printf("Warning: Skipping image '%s' because could not allocate\n", filename.c_str());
+
+                    return;
+                }
+
+                swizzleChannels(normalImage, imageDataResource, { { 0, 0 }, { 1, 1 }, { 2, 2 } });
+            }
+
+            printf("Info: Found normal\n");
+
+            foundImages[i] = 1;
+        }
+
+        if (plannedImage.imageRole == IMAGE_ROLE_EMISSIVE) {
+            if (imageDataResource.channels == 3) {
+                emissiveImage = std::move(imageDataResource);
+            } else {
+                emissiveImage.width = imageDataResource.width;
+                emissiveImage.height = imageDataResource.height;
+                emissiveImage.channels = 3;
+                if (!emissiveImage.pixels.allocate(static_cast<size_t>(emissiveImage.channels) * emissiveImage.width * emissiveImage.height, &bufferPool)) {
+                    printf("Warning: Skipping image '%s' because could not allocate\n", filename.c_str());
+
+                    return;
+                }
+
+                swizzleChannels(emissiveImage, imageDataResource, { { 0, 0 }, { 1, 1 }, { 2, 2 } });
+            }
+
+            printf("Info: Found emissive\n");
+
+            foundImages[i] = 1;
+        }
+    };
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        for (size_t i = 0; i < plannedImages.size(); i++) {
+            if (!channelIndices[i].empty()) {
+                taskGroup.run([&processImage, i]() { processImage(i); });
+            }
+        }
+
+        taskGroup.wait();
+    }
+
+    for (size_t i = 0; i < plannedImages.size(); i++) {
+        if (!imageErrors[i].empty()) {
+            convertResult.errorCode = CONVERT_ERROR_INPUT;
+            convertResult.error = imageErrors[i];
+            printf("Error: %s\n", convertResult.error.c_str());
+
+            return false;
+        }
+
+        if (!foundImages[i] || constantSources[i].constant) {
+            // Channels of images, which could not be decoded or are replaced by a factor, keep the default value
+            switch (plannedImages[i].imageRole) {
+                case IMAGE_ROLE_BASE_COLOR:
+                    fillChannels(baseColorImage, { 0, 1, 2 }, 255);
+                    break;
+                case IMAGE_ROLE_OPACITY:
+                    fillChannels(baseColorImage, { 3 }, 255);
+                    break;
+                case IMAGE_ROLE_METALLIC:
+                    fillChannels(metallicRoughnessImage, { 2 }, 255);
+                    break;
+                case IMAGE_ROLE_ROUGHNESS:
+                    fillChannels(metallicRoughnessImage, { 1 }, 255);
+                    break;
+                case IMAGE_ROLE_OCCLUSION:
+                    fillChannels(metallicRoughnessImage, { 0 }, 255);
+                    break;
+                default:
+                    break;
+            }
+
+            if (constantSources[i].constant) {
+                materialImages.constantSources[plannedImages[i].imageRole] = constantSources[i];
+            }
+
+            continue;
+        }
+
+        setWriteFlag(materialImages, plannedImages[i].imageRole);
+    }
+
+    // Channels without information are dropped, so the smallest lossless PNG color type is written
+
+    if (materialImages.writeOpacity) {
+        materialImages.alphaCoverage = getAlphaCoverageImage(baseColorImage, 3);
+    }
+
+    if ((materialImages.writeBaseColor || materialImages.writeOpacity) && baseColorImage.channels > 0) {
+        minimizeChannels(baseColorImage, materialImages.alphaCoverage != ALPHA_COVERAGE_OPAQUE);
+    }
+    if ((materialImages.writeMetallic || materialImages.writeRoughness || materialImages.writeOcclusion) && metallicRoughnessImage.channels > 0) {
+        minimizeChannels(metallicRoughnessImage, false);
+    }
+    if (materialImages.writeEmissive && emissiveImage.channels > 0) {
+        minimizeChannels(emissiveImage, false);
+    }
+
+    // Encode and save the images in parallel
+
+    std::string& baseColorPath = materialImages.baseColorPath;
+    std::string& metallicRoughnessPath = materialImages.metallicRoughnessPath;
+    std::string& normalPath = materialImages.normalPath;
+    std::string& emissivePath = materialImages.emissivePath;
+
+    std::string baseColorError;
+    std::string metallicRoughnessError;
+    std::string normalError;
+    std::string emissiveError;
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        if (materialImages.writeBaseColor || materialImages.writeOpacity) {
+            taskGroup.run([&]() {
+                if (!saveKtx2Image(baseColorError, baseColorImage, false, true, baseColorPath, materialImages.baseColorKtx2, convertOptions, threadPool)) {
+                    return;
+                }
+
+                if (materialImages.keepBaseColor) {
+                    saveKeptImage(baseColorError, *findPlannedImage(plannedImages, IMAGE_ROLE_BASE_COLOR), baseColorImageRaw, baseColorPath, getEmbeddedData(materialImages.baseColorData, convertOptions), convertOptions);
+                } else {
+                    saveImage(baseColorError, baseColorImage, baseColorPath, getEmbeddedData(materialImages.baseColorData, convertOptions), convertOptions, threadPool);
+                }
+            });
+        }
+
+        if (materialImages.writeMetallic || materialImages.writeRoughness || materialImages.writeOcclusion) {
+            taskGroup.run([&]() {
+                if (!saveKtx2Image(metallicRoughnessError, metallicRoughnessImage, false, false, metallicRoughnessPath, materialImages.metallicRoughnessKtx2, convertOptions, threadPool)) {
+                    return;
+                }
+
+                if (materialImages.keepMetallicRoughness) {
+                    saveKeptImage(metallicRoughnessError, *findPlannedImage(plannedImages, IMAGE_ROLE_METALLIC), metallicRoughnessImageRaw, metallicRoughnessPath, getEmbeddedData(materialImages.metallicRoughnessData, convertOptions), convertOptions);
+                } else {
+                    saveImage(metallicRoughnessError, metallicRoughnessImage, metallicRoughnessPath, getEmbeddedData(materialImages.metallicRoughnessData, convertOptions), convertOptions, threadPool);
+                }
+            });
+        }
+
+        if (materialImages.writeNormal) {
+            taskGroup.run([&]() {
+                if (!saveKtx2Image(normalError, normalImage, true, false, normalPath, materialImages.normalKtx2, convertOptions, threadPool)) {
+                    return;
+                }
+
+                if (convertOptions.keepNormalImageData) {
+                    saveKeptImage(normalError, *findPlannedImage(plannedImages, IMAGE_ROLE_NORMAL), normalImageRaw, normalPath, getEmbeddedData(materialImages.normalData, convertOptions), convertOptions);
+                } else {
+                    saveImage(normalError, normalImage, normalPath, getEmbeddedData(materialImages.normalData, convertOptions), convertOptions, threadPool);
+                }
+            });
+        }
+
+        if (materialImages.writeEmissive) {
+            taskGroup.run([&]() {
+                if (!saveKtx2Image(emissiveError, emissiveImage, false, true, emissivePath, materialImages.emissiveKtx2, convertOptions, threadPool)) {
+                    return;
+                }
+
+                if (convertOptions.keepEmissiveImageData) {
+                    saveKeptImage(emissiveError, *findPlannedImage(plannedImages, IMAGE_ROLE_EMISSIVE), emissiveImageRaw, emissivePath, getEmbeddedData(materialImages.emissiveData, convertOptions), convertOptions);
+                } else {
+                    saveImage(emissiveError, emissiveImage, emissivePath, getEmbeddedData(materialImages.emissiveData, convertOptions), convertOptions, threadPool);
+                }
+            });
+        }
+
+        taskGroup.wait();
+    }
+
+    for (const std::string* error : { &baseColorError, &metallicRoughnessError, &normalError, &emissiveError }) {
+        if (!error->empty()) {
+            convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+            convertResult.error = *error;
+            printf("Error: %s\n", convertResult.error.c_str());
+
+            return false;
+        }
+    }
+
+    if (convertOptions.lodCount == 0 || plannedImages.empty()) {
+        return true;
+    }
+
+    // Levels of detail halve the size, until a side of one pixel is reached
+
+    uint32_t width = plannedImages[0].imageInfo.width;
+    uint32_t height = plannedImages[0].imageInfo.height;
+
+    uint32_t levelCount = 0;
+    while (levelCount < convertOptions.lodCount && (width > 1 || height > 1)) {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+
+        levelCount++;
+    }
+
+    lodImages.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        initLevelImages(lodImages[level], materialImages, level + 1);
+
+        // Kept original data, which could not be decoded, is only part of the first level
+        lodImages[level].writeNormal = materialImages.writeNormal && normalImage.channels > 0;
+        lodImages[level].writeEmissive = materialImages.writeEmissive && emissiveImage.channels > 0;
+    }
+
+    // Each packed image is downscaled in a cascade, so the images are independent of each other
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        if (materialImages.writeBaseColor || materialImages.writeOpacity) {
+            taskGroup.run([&]() {
+                saveImageLevels(baseColorError, baseColorImage, false, true, lodImages, &MaterialImages::baseColorPath, &MaterialImages::baseColorData, &MaterialImages::baseColorKtx2, convertOptions, threadPool);
+            });
+        }
+
+        if (materialImages.writeMetallic || materialImages.writeRoughness || materialImages.writeOcclusion) {
+            taskGroup.run([&]() {
+                saveImageLevels(metallicRoughnessError, metallicRoughnessImage, false, false, lodImages, &MaterialImages::metallicRoughnessPath, &MaterialImages::metallicRoughnessData, &MaterialImages::metallicRoughnessKtx2, convertOptions, threadPool);
+            });
+        }
+
+        if (levelCount > 0 && lodImages[0].writeNormal) {
+            taskGroup.run([&]() {
+                saveImageLevels(normalError, normalImage, true, false, lodImages, &MaterialImages::normalPath, &MaterialImages::normalData, &MaterialImages::normalKtx2, convertOptions, threadPool);
+            });
+        }
+
+        if (levelCount > 0 && lodImages[0].writeEmissive) {
+            taskGroup.run([&]() {
+                saveImageLevels(emissiveError, emissiveImage, false, true, lodImages, &MaterialImages::emissivePath, &MaterialImages::emissiveData, &MaterialImages::emissiveKtx2, convertOptions, threadPool);
+            });
+        }
+
+        taskGroup.wait();
+    }
+
+    for (const std::string* error : { &baseColorError, &metallicRoughnessError, &normalError, &emissiveError }) {
+        if (!error->empty()) {
+            convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+            convertResult.error = *error;
+            printf("Error: %s\n", convertResult.error.c_str());
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Packs and encodes each output band by band, so the memory does not grow with the image height.
+bool streamImages(ConvertResult& convertResult, MaterialImages& materialImages, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    const std::vector<PlannedImage>& plannedImages = materialImages.plannedImages;
+
+    if (plannedImages.empty()) {
+        return true;
+    }
+
+    uint32_t width = plannedImages[0].imageInfo.width;
+    uint32_t height = plannedImages[0].imageInfo.height;
+
+    // Each output is one job with its sources, which are indices into the planned images. The channels of a packed image
+    // are one source, so it is read once
+
+    struct StreamJob {
+        std::string* savePath = nullptr;
+        uint32_t channels = 0;
+        std::vector<std::vector<size_t>> plannedIndices;
+        std::vector<BandSource> bandSources;
+        std::vector<uint8_t> foundSources;
+        EncodedData* encodedData = nullptr;
+        std::string error = "";
+    };
+
+    StreamJob baseColorJob;
+    baseColorJob.savePath = &materialImages.baseColorPath;
+    baseColorJob.encodedData = getEmbeddedData(materialImages.baseColorData, convertOptions);
+
+    StreamJob metallicRoughnessJob;
+    metallicRoughnessJob.savePath = &materialImages.metallicRoughnessPath;
+    metallicRoughnessJob.channels = 3;
+    metallicRoughnessJob.encodedData = getEmbeddedData(materialImages.metallicRoughnessData, convertOptions);
+
+    StreamJob normalJob;
+    normalJob.savePath = &materialImages.normalPath;
+    normalJob.channels = 3;
+    normalJob.encodedData = getEmbeddedData(materialImages.normalData, convertOptions);
+
+    StreamJob emissiveJob;
+    emissiveJob.savePath = &materialImages.emissivePath;
+    emissiveJob.encodedData = getEmbeddedData(materialImages.emissiveData, convertOptions);
+
+    // Constant sources are found by a scan, which stops at the first differing pixel, and are not packed
+
+    // The alpha coverage of the opacity is scanned the same way, as the layout of the PNG has to be known before the first band
+
+    std::vector<ConstantSource> constantSources(plannedImages.size());
+    std::vector<AlphaCoverage> alphaCoverages(plannedImages.size(), ALPHA_COVERAGE_BLEND);
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        for (size_t i = 0; i < plannedImages.size(); i++) {
+            // A kept base color is only scanned, if that does not decode the whole image. A kept packed image keeps all its channels
+            bool foldable = convertOptions.foldConstants && isFoldableRole(plannedImages[i].imageRole);
+            if (plannedImages[i].imageRole == IMAGE_ROLE_BASE_COLOR && materialImages.keepBaseColor) {
+                foldable = foldable && isRowReadable(plannedImages[i]);
+            }
+            if (isMetallicRoughnessRole(plannedImages[i].imageRole) && materialImages.keepMetallicRoughness) {
+                foldable = false;
+            }
+            if (!foldable && plannedImages[i].imageRole != IMAGE_ROLE_OPACITY) {
+                continue;
+            }
+
+            taskGroup.run([&plannedImages, &constantSources, &alphaCoverages, &convertOptions, foldable, i]() {
+                const PlannedImage& plannedImage = plannedImages[i];
+
+                TraceSpan prescanSpan("prescan", plannedImage.filename);
+
+                if (foldable) {
+                    bool uniform = false;
+                    std::vector<uint8_t> firstPixel;
+                    if (scanUniformImage(uniform, firstPixel, plannedImage.filename, getFoldChannels(plannedImage.imageRole, plannedImage.imageInfo.channels, plannedImage.sourceChannel), convertOptions.bandHeight) && uniform) {
+                        if (setConstantSource(constantSources[i], plannedImage.imageRole, firstPixel.data(), static_cast<uint32_t>(firstPixel.size()), plannedImage.sourceChannel)) {
+                            printf("Info: Found constant %s\n", getRoleName(plannedImage.imageRole));
+
+                            return;
+                        }
+                    }
+                }
+
+                if (plannedImage.imageRole == IMAGE_ROLE_OPACITY) {
+                    scanAlphaCoverage(alphaCoverages[i], plannedImage.filename, plannedImage.sourceChannel, convertOptions.bandHeight);
+                }
+            });
+        }
+
+        taskGroup.wait();
+    }
+
+    // Gray color sources give a gray output. An opaque opacity is not streamed at all
+
+    uint32_t colorChannels = 1;
+    bool streamOpacity = false;
+
+    for (size_t i = 0; i < plannedImages.size(); i++) {
+        if (constantSources[i].constant) {
+            continue;
+        }
+
+        if (plannedImages[i].imageRole == IMAGE_ROLE_BASE_COLOR && plannedImages[i].imageInfo.channels >= 3) {
+            colorChannels = 3;
+        } else if (plannedImages[i].imageRole == IMAGE_ROLE_OPACITY && alphaCoverages[i] != ALPHA_COVERAGE_OPAQUE) {
+            streamOpacity = true;
+            materialImages.alphaCoverage = alphaCoverages[i];
+        }
+    }
+
+    baseColorJob.channels = colorChannels + (streamOpacity ? 1 : 0);
+
+    std::vector<size_t> copiedIndices;
+
+    for (size_t i = 0; i < plannedImages.size(); i++) {
+        const PlannedImage& plannedImage = plannedImages[i];
+
+        if (constantSources[i].constant) {
+            materialImages.constantSources[plannedImage.imageRole] = constantSources[i];
+
+            continue;
+        }
+
+        // Gray color images stay gray, except for normal images
+        std::vector<ChannelMove> colorMoves = { { 0, 0 }, { 1, 1 }, { 2, 2 } };
+        if (plannedImage.imageInfo.channels < 3) {
+            colorMoves = { { 0, 0 } };
+        }
+
+        StreamJob* streamJob = nullptr;
+        std::vector<ChannelMove> channelMoves;
+
+        switch (plannedImage.imageRole) {
+            case IMAGE_ROLE_BASE_COLOR:
+                if (materialImages.keepBaseColor) {
+                    copiedIndices.push_back(i);
+                } else {
+                    streamJob = &baseColorJob;
+                    channelMoves = colorMoves;
+                }
+                break;
+            case IMAGE_ROLE_OPACITY:
+                if (streamOpacity) {
+                    streamJob = &baseColorJob;
+                    channelMoves = { { plannedImage.sourceChannel, colorChannels } };
+                }
+                break;
+            case IMAGE_ROLE_METALLIC:
+            case IMAGE_ROLE_ROUGHNESS:
+            case IMAGE_ROLE_OCCLUSION:
+                // A kept packed image is copied once for all its channels
+                if (materialImages.keepMetallicRoughness) {
+                    if (plannedImage.imageRole == IMAGE_ROLE_METALLIC) {
+                        copiedIndices.push_back(i);
+                    }
+                } else {
+                    streamJob = &metallicRoughnessJob;
+                    channelMoves = { { plannedImage.sourceChannel, getMetallicRoughnessChannel(plannedImage.imageRole) } };
+                }
+                break;
+            case IMAGE_ROLE_NORMAL:
+                if (convertOptions.keepNormalImageData) {
+                    copiedIndices.push_back(i);
+                } else {
+                    streamJob = &normalJob;
+                    channelMoves = { { 0, 0 }, { 1, 1 }, { 2, 2 } };
+                    if (plannedImage.imageInfo.channels < 3) {
+                        channelMoves = { { 0, 0 }, { 0, 1 }, { 0, 2 } };
+                    }
+                }
+                break;
+            case IMAGE_ROLE_EMISSIVE:
+                if (convertOptions.keepEmissiveImageData) {
+                    copiedIndices.push_back(i);
+                } else {
+                    streamJob = &emissiveJob;
+                    emissiveJob.channels = (plannedImage.imageInfo.channels < 3) ? 1 : 3;
+                    channelMoves = colorMoves;
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (streamJob) {
+            size_t source = 0;
+            while (source < streamJob->bandSources.size() && streamJob->bandSources[source].filename != plannedImage.filename) {
+                source++;
+            }
+
+            if (source == streamJob->bandSources.size()) {
+                BandSource bandSource;
+                bandSource.filename = plannedImage.filename;
+
+                streamJob->plannedIndices.emplace_back();
+                streamJob->bandSources.push_back(bandSource);
+            }
+
+            BandSource& bandSource = streamJob->bandSources[source];
+            bandSource.channelMoves.insert(bandSource.channelMoves.end(), channelMoves.begin(), channelMoves.end());
+
+            streamJob->plannedIndices[source].push_back(i);
+        }
+    }
+
+    std::vector<std::string> copyErrors(copiedIndices.size());
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        for (StreamJob* streamJob : { &baseColorJob, &metallicRoughnessJob, &normalJob, &emissiveJob }) {
+            if (streamJob->bandSources.empty()) {
+                continue;
+            }
+
+            taskGroup.run([streamJob, width, height, &convertOptions]() {
+                std::vector<uint8_t>* output = nullptr;
+                if (streamJob->encodedData) {
+                    streamJob->encodedData->parts.resize(1);
+                    output = &streamJob->encodedData->parts[0];
+                }
+
+                // A streamed file is written under a temporary name and renamed, when it is complete. Shared outputs are hashed
+                // under their final name, so they are written there
+                bool renamed = !output && !convertOptions.outputRegistry;
+                std::string streamPath = renamed ? getTemporaryFilename(*streamJob->savePath) : *streamJob->savePath;
+
+                if (!output && !renamed) {
+                    unlinkOutput(streamPath);
+                }
+
+                TraceSpan streamSpan("stream", *streamJob->savePath);
+                if (streamSpan.isActive()) {
+                    for (const BandSource& bandSource : streamJob->bandSources) {
+                        streamSpan.addFileRead(bandSource.filename);
+                    }
+                    streamSpan.addPixels(static_cast<uint64_t>(width) * height);
+                }
+
+                if (!streamImage(streamJob->foundSources, streamJob->error, streamPath, width, height, streamJob->channels, streamJob->bandSources, convertOptions.bandHeight, convertOptions.pngOptions, output)) {
+                    if (renamed) {
+                        std::error_code errorCode;
+                        fs::remove(streamPath, errorCode);
+                    }
+
+                    return;
+                }
+
+                if (output) {
+                    streamSpan.addBytesWritten(output->size());
+                } else {
+                    streamSpan.addFileWritten(streamPath);
+                }
+
+                bool saved = std::find(streamJob->foundSources.begin(), streamJob->foundSources.end(), 1) != streamJob->foundSources.end();
+                if (saved && renamed) {
+                    if (convertOptions.writeGroup) {
+                        convertOptions.outputWriter->commit(*convertOptions.writeGroup, streamPath, *streamJob->savePath);
+                    } else if (!commitFile(streamPath, *streamJob->savePath, isSyncingFiles(convertOptions))) {
+                        streamJob->error = "Could not save image '" + *streamJob->savePath + "'";
+                    }
+                }
+
+                // The pixels are never complete in memory, so identical outputs are found by their encoded bytes
+                if (saved && !output && convertOptions.outputRegistry) {
+                    shareStreamedImage(streamJob->error, *streamJob->savePath, convertOptions);
+                }
+            });
+        }
+
+        for (size_t i = 0; i < copiedIndices.size(); i++) {
+            taskGroup.run([&copyErrors, &copiedIndices, &materialImages, &convertOptions, i]() {
+                const PlannedImage& plannedImage = materialImages.plannedImages[copiedIndices[i]];
+                std::string* savePath = &materialImages.emissivePath;
+                EncodedData* encodedData = &materialImages.emissiveData;
+                if (plannedImage.imageRole == IMAGE_ROLE_BASE_COLOR) {
+                    savePath = &materialImages.baseColorPath;
+                    encodedData = &materialImages.baseColorData;
+                } else if (plannedImage.imageRole == IMAGE_ROLE_METALLIC) {
+                    savePath = &materialImages.metallicRoughnessPath;
+                    encodedData = &materialImages.metallicRoughnessData;
+                } else if (plannedImage.imageRole == IMAGE_ROLE_NORMAL) {
+                    savePath = &materialImages.normalPath;
+                    encodedData = &materialImages.normalData;
+                }
+
+                copyImage(copyErrors[i], plannedImage, *savePath, getEmbeddedData(*encodedData, convertOptions), convertOptions);
+            });
+        }
+
+        taskGroup.wait();
+    }
+
+    for (StreamJob* streamJob : { &baseColorJob, &metallicRoughnessJob, &normalJob, &emissiveJob }) {
+        if (!streamJob->error.empty()) {
+            convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+            convertResult.error = streamJob->error;
+            printf("Error: %s\n", convertResult.error.c_str());
+
+            return false;
+        }
+
+        for (size_t i = 0; i < streamJob->foundSources.size(); i++) {
+            if (!streamJob->foundSources[i]) {
+                continue;
+            }
+
+            for (size_t plannedIndex : streamJob->plannedIndices[i]) {
+                setWriteFlag(materialImages, plannedImages[plannedIndex].imageRole);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < copiedIndices.size(); i++) {
+        if (!copyErrors[i].empty()) {
+            convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+            convertResult.error = copyErrors[i];
+            printf("Error: %s\n", convertResult.error.c_str());
+
+            return false;
+        }
+
+        // A copied packed image has all its roles
+        for (const PlannedImage& plannedImage : plannedImages) {
+            if (isSameSource(plannedImage, plannedImages[copiedIndices[i]])) {
+                setWriteFlag(materialImages, plannedImage.imageRole);
+            }
+        }
+    }
+
+    return true;
+}
+
+void appendUint32(std::vector<uint8_t>& output, uint32_t value)
+{
+    for (uint32_t i = 0; i < 4; i++) {
+        output.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+// Collects the embedded images as buffer views of the one binary buffer.
+struct BinaryBuffer {
+    json bufferViews = json::array();
+    std::vector<DataSegment> segments;
+    size_t byteLength = 0;
+};
+
+// Returns the image referencing the file or the buffer view of the embedded data.
+json getImage(BinaryBuffer& binaryBuffer, const std::string& path, const EncodedData& encodedData, const std::string& outputFolder, const ConvertOptions& convertOptions)
+{
+    static const uint8_t zeros[4] = { 0, 0, 0, 0 };
+
+    json image = json::object();
+
+    // The images are referenced relative to the glTF, as a shared image can be in the folder of another material
+    if (!convertOptions.saveBinary) {
+        image["uri"] = outputFolder.empty() ? path : fs::path(path).lexically_relative(outputFolder).generic_string();
+
+        return image;
+    }
+
+    DecomposedPath decomposedPath;
+    decomposePath(decomposedPath, path);
+
+    std::string lowercaseExtension = toLowercase(decomposedPath.extension);
+
+    size_t byteLength = getEncodedSize(encodedData);
+
+    json bufferView = json::object();
+    bufferView["buffer"] = 0;
+    bufferView["byteOffset"] = binaryBuffer.byteLength;
+    bufferView["byteLength"] = byteLength;
+
+    image["bufferView"] = binaryBuffer.bufferViews.size();
+    if (lowercaseExtension == ".jpg" || lowercaseExtension == ".jpeg") {
+        image["mimeType"] = "image/jpeg";
+    } else if (lowercaseExtension == ".ktx2") {
+        image["mimeType"] = "image/ktx2";
+    } else {
+        image["mimeType"] = "image/png";
+    }
+
+    binaryBuffer.bufferViews.push_back(bufferView);
+
+    // Each image starts 4 byte aligned
+    appendSegments(binaryBuffer.segments, encodedData);
+    binaryBuffer.byteLength += byteLength;
+
+    size_t paddingSize = (4 - binaryBuffer.byteLength % 4) % 4;
+    if (paddingSize > 0) {
+        binaryBuffer.segments.push_back({ zeros, paddingSize });
+        binaryBuffer.byteLength += paddingSize;
+    }
+
+    return image;
+}
+
+// Adds the texture and the image of a packed output and returns the index of the texture. KHR_texture_basisu only allows Basis Universal payloads,
+// so a KTX2 copy with BC7 blocks is referenced from the extras of the texture and the image stays the source for every client.
+size_t addTexture(json& textures, json& images, BinaryBuffer& binaryBuffer, const std::string& path, const EncodedData& encodedData, const Ktx2Output& ktx2Output, const std::string& outputFolder, const ConvertOptions& convertOptions)
+{
+    size_t index = textures.size();
+
+    json texture = json::object();
+    texture["source"] = images.size();
+
+    images.push_back(getImage(binaryBuffer, path, encodedData, outputFolder, convertOptions));
+
+    if (!ktx2Output.path.empty()) {
+        json extras = json::object();
+        extras["ktx2"] = getImage(binaryBuffer, ktx2Output.path, ktx2Output.data, outputFolder, convertOptions);
+
+        texture["extras"] = extras;
+    }
+
+    textures.push_back(texture);
+
+    return index;
+}
+
+// Saves a glTF or binary glTF, writes it to the output descriptor or keeps it as an output in memory.
+// The segments point into the owned data, which is handed to the writer stage, or into the images of the material.
+bool saveContent(std::string& error, const std::vector<DataSegment>& segments, EncodedData& ownedData, const std::string& savename, std::vector<OutputFile>& outputFiles, const ConvertOptions& convertOptions)
+{
+    bool result = false;
+    if (convertOptions.keepOutputs) {
+        OutputFile outputFile;
+        outputFile.path = savename;
+        for (const DataSegment& segment : segments) {
+            outputFile.data.insert(outputFile.data.end(), segment.data, segment.data + segment.size);
+        }
+        outputFiles.push_back(std::move(outputFile));
+
+        result = true;
+    } else if (convertOptions.outputDescriptor >= 0) {
+        result = writeSegments(segments, convertOptions.outputDescriptor);
+    } else if (convertOptions.writeGroup) {
+        convertOptions.outputWriter->write(*convertOptions.writeGroup, savename, segments, std::move(ownedData));
+
+        result = true;
+    } else {
+        TraceSpan writeSpan("write", savename);
+
+        result = saveSegmentsAtomically(segments, savename, isSyncingFiles(convertOptions));
+        writeSpan.addFileWritten(savename);
+    }
+
+    if (!result) {
+        error = "Could not save '" + savename + "'";
+
+        return false;
+    }
+
+    return true;
+}
+
+// Writes the binary glTF: The header, the JSON chunk and the binary chunk are written with one gathering write,
+// so the encoded images are not copied into one buffer.
+bool saveBinary(std::string& error, json& glTF, BinaryBuffer& binaryBuffer, const std::string& savename, std::vector<OutputFile>& outputFiles, const ConvertOptions& convertOptions)
+{
+    if (binaryBuffer.byteLength > 0) {
+        json buffer = json::object();
+        buffer["byteLength"] = binaryBuffer.byteLength;
+
+        json buffers = json::array();
+        buffers.push_back(buffer);
+
+        glTF["bufferViews"] = binaryBuffer.bufferViews;
+        glTF["buffers"] = buffers;
+    }
+
+    std::string content = glTF.dump();
+    content.append((4 - content.size() % 4) % 4, ' ');
+
+    size_t totalLength = 12 + 8 + content.size();
+    if (binaryBuffer.byteLength > 0) {
+        totalLength += 8 + binaryBuffer.byteLength;
+    }
+
+    if (totalLength > UINT32_MAX) {
+        error = "Could not save '" + savename + "' because of size";
+
+        return false;
+    }
+
+    // The header, the JSON chunk and the binary chunk header are owned, the embedded images are referenced
+
+    EncodedData ownedData;
+    ownedData.parts.resize(3);
+
+    std::vector<uint8_t>& header = ownedData.parts[0];
+    appendUint32(header, 0x46546C67);
+    appendUint32(header, 2);
+    appendUint32(header, static_cast<uint32_t>(totalLength));
+    appendUint32(header, static_cast<uint32_t>(content.size()));
+    appendUint32(header, 0x4E4F534A);
+
+    ownedData.parts[1].assign(content.begin(), content.end());
+
+    std::vector<uint8_t>& binaryHeader = ownedData.parts[2];
+    appendUint32(binaryHeader, static_cast<uint32_t>(binaryBuffer.byteLength));
+    appendUint32(binaryHeader, 0x004E4942);
+
+    std::vector<DataSegment> segments;
+    segments.push_back({ header.data(), header.size() });
+    segments.push_back({ ownedData.parts[1].data(), ownedData.parts[1].size() });
+    if (binaryBuffer.byteLength > 0) {
+        segments.push_back({ binaryHeader.data(), binaryHeader.size() });
+        segments.insert(segments.end(), binaryBuffer.segments.begin(), binaryBuffer.segments.end());
+    }
+
+    return saveContent(error, segments, ownedData, savename, outputFiles, convertOptions);
+}
+
+// Adds the material, its textures and its images to the glTF.
+void addMaterial(json& materials, json& textures, json& images, BinaryBuffer& binaryBuffer, const MaterialImages& materialImages, const std::string& name, const ConvertOptions& convertOptions)
+{
+    json material = json::object();
+    json pbrMetallicRoughness = json::object();
+
+    //
+
+    const ConstantSource* constantSources = materialImages.constantSources;
+
+    // Opaque is the default alpha mode. Mask is enough, if the opacity is only 0 or 255
+
+    bool constantOpacity = constantSources[IMAGE_ROLE_OPACITY].constant;
+
+    AlphaCoverage alphaCoverage = ALPHA_COVERAGE_OPAQUE;
+    if (constantOpacity) {
+        alphaCoverage = getAlphaCoverage(constantSources[IMAGE_ROLE_OPACITY].values, 1, 1, 0);
+    } else if (materialImages.writeOpacity) {
+        alphaCoverage = materialImages.alphaCoverage;
+    }
+
+    if (alphaCoverage != ALPHA_COVERAGE_OPAQUE) {
+        material["alphaMode"] = (alphaCoverage == ALPHA_COVERAGE_MASK) ? "MASK" : "BLEND";
+        material["doubleSided"] = true;
+    }
+
+    if (constantSources[IMAGE_ROLE_BASE_COLOR].constant || constantOpacity) {
+        json baseColorFactor = json::array();
+        for (uint32_t i = 0; i < 3; i++) {
+            baseColorFactor.push_back(constantSources[IMAGE_ROLE_BASE_COLOR].values[i] / 255.0f);
+        }
+        baseColorFactor.push_back(constantSources[IMAGE_ROLE_OPACITY].values[0] / 255.0f);
+
+        pbrMetallicRoughness["baseColorFactor"] = baseColorFactor;
+    }
+
+    if (constantSources[IMAGE_ROLE_METALLIC].constant) {
+        pbrMetallicRoughness["metallicFactor"] = constantSources[IMAGE_ROLE_METALLIC].values[0] / 255.0f;
+    }
+    if (constantSources[IMAGE_ROLE_ROUGHNESS].constant) {
+        pbrMetallicRoughness["roughnessFactor"] = constantSources[IMAGE_ROLE_ROUGHNESS].values[0] / 255.0f;
+    }
+
+    if (materialImages.writeBaseColor || materialImages.writeOpacity) {
+        size_t index = addTexture(textures, images, binaryBuffer, materialImages.baseColorPath, materialImages.baseColorData, materialImages.baseColorKtx2, materialImages.outputFolder, convertOptions);
+
+        json baseColorTexture = json::object();
+        baseColorTexture["index"] = index;
+
+        pbrMetallicRoughness["baseColorTexture"] = baseColorTexture;
+    }
+
+    if (materialImages.writeMetallic || materialImages.writeRoughness || materialImages.writeOcclusion) {
+        size_t index = addTexture(textures, images, binaryBuffer, materialImages.metallicRoughnessPath, materialImages.metallicRoughnessData, materialImages.metallicRoughnessKtx2, materialImages.outputFolder, convertOptions);
+
+        json metallicRoughnessTexture = json::object();
+        metallicRoughnessTexture["index"] = index;
+
+        if (!materialImages.writeMetallic && !constantSources[IMAGE_ROLE_METALLIC].constant) {
+            pbrMetallicRoughness["metallicFactor"] = convertOptions.defaultMetallicFactor;
+        }
+        if (!materialImages.writeRoughness && !constantSources[IMAGE_ROLE_ROUGHNESS].constant) {
+            pbrMetallicRoughness["roughnessFactor"] = convertOptions.defaultRoughnessFactor;
+        }
+
+        pbrMetallicRoughness["metallicRoughnessTexture"] = metallicRoughnessTexture;
+
+        if (!materialImages.writeOcclusion) {
+            // Do nothing
+        } else {
+            json occlusionTexture = json::object();
+            occlusionTexture["index"] = index;
+
+            material["occlusionTexture"] = occlusionTexture;
+        }
+    }
+
+    if (materialImages.writeNormal) {
+        size_t index = addTexture(textures, images, binaryBuffer, materialImages.normalPath, materialImages.normalData, materialImages.normalKtx2, materialImages.outputFolder, convertOptions);
+
+        json normalTexture = json::object();
+        normalTexture["index"] = index;
+
+        material["normalTexture"] = normalTexture;
+    }
+
+    if (materialImages.writeEmissive) {
+        size_t index = addTexture(textures, images, binaryBuffer, materialImages.emissivePath, materialImages.emissiveData, materialImages.emissiveKtx2, materialImages.outputFolder, convertOptions);
+
+        json emissiveTexture = json::object();
+        emissiveTexture["index"] = index;
+
+        material["emissiveTexture"] = emissiveTexture;
+
+        json emissiveFactor = json::array();
+        emissiveFactor.push_back(1.0f);
+        emissiveFactor.push_back(1.0f);
+        emissiveFactor.push_back(1.0f);
+        material["emissiveFactor"] = emissiveFactor;
+    }
+
+    material["name"] = name;
+
+    material["pbrMetallicRoughness"] = pbrMetallicRoughness;
+    materials.push_back(material);
+}
+
+// Saves a glTF with the given materials as '<basename>.gltf' next to their images or as binary glTF '<basename>.glb'.
+bool saveGltf(std::string& error, std::string& savename, std::vector<OutputFile>& outputFiles, const json& materials, const json& textures, const json& images, BinaryBuffer& binaryBuffer, const std::string& basename, TraceSpan& jsonSpan, const ConvertOptions& convertOptions)
+{
+    json glTF = json::object();
+
+    json asset = json::object();
+    asset["version"] = "2.0";
+    asset["generator"] = "pbr2gltf2 by UX3D";
+
+    glTF["asset"] = asset;
+
+    glTF["materials"] = materials;
+
+    if (textures.size() > 0) {
+        glTF["textures"] = textures;
+    }
+    if (images.size() > 0) {
+        glTF["images"] = images;
+    }
+
+    //
+
+    if (convertOptions.saveBinary) {
+        savename = (convertOptions.outputDescriptor >= 0) ? "-" : basename + ".glb";
+
+        return saveBinary(error, glTF, binaryBuffer, savename, outputFiles, convertOptions);
+    }
+
+    savename = basename + ".gltf";
+
+    std::string content = glTF.dump(3);
+    jsonSpan.addBytesWritten(content.size());
+
+    EncodedData ownedData;
+    ownedData.parts.emplace_back(content.begin(), content.end());
+
+    std::vector<DataSegment> segments;
+    appendSegments(segments, ownedData);
+
+    return saveContent(error, segments, ownedData, savename, outputFiles, convertOptions);
+}
+
+// Builds the glTF of the material and saves it next to its images or as binary glTF.
+bool saveMaterial(std::string& error, std::string& savename, std::vector<OutputFile>& outputFiles, const MaterialImages& materialImages, const std::string& name, const ConvertOptions& convertOptions)
+{
+    TraceSpan jsonSpan("json", materialImages.stem);
+
+    json images = json::array();
+    BinaryBuffer binaryBuffer;
+    json textures = json::array();
+    json materials = json::array();
+
+    addMaterial(materials, textures, images, binaryBuffer, materialImages, name, convertOptions);
+
+    return saveGltf(error, savename, outputFiles, materials, textures, images, binaryBuffer, getOutputPath(materialImages, materialImages.stem), jsonSpan, convertOptions);
+}
+
+// Moves the encoded images of a material, which are referenced by their path, into the outputs kept in memory.
+void appendImageOutputs(std::vector<OutputFile>& outputFiles, MaterialImages& materialImages)
+{
+    auto appendOutput = [&outputFiles](const std::string& path, EncodedData& encodedData) {
+        OutputFile outputFile;
+        outputFile.path = path;
+        if (encodedData.parts.size() == 1) {
+            outputFile.data = std::move(encodedData.parts[0]);
+        } else {
+            outputFile.data.reserve(getEncodedSize(encodedData));
+            for (const std::vector<uint8_t>& part : encodedData.parts) {
+                outputFile.data.insert(outputFile.data.end(), part.begin(), part.end());
+            }
+        }
+        encodedData.parts.clear();
+
+        outputFiles.push_back(std::move(outputFile));
+    };
+
+    auto appendOutputs = [&appendOutput](bool write, const std::string& path, EncodedData& encodedData, Ktx2Output& ktx2Output) {
+        if (!write) {
+            return;
+        }
+
+        appendOutput(path, encodedData);
+        if (!ktx2Output.path.empty()) {
+            appendOutput(ktx2Output.path, ktx2Output.data);
+        }
+    };
+
+    appendOutputs(materialImages.writeBaseColor || materialImages.writeOpacity, materialImages.baseColorPath, materialImages.baseColorData, materialImages.baseColorKtx2);
+    appendOutputs(materialImages.writeMetallic || materialImages.writeRoughness || materialImages.writeOcclusion, materialImages.metallicRoughnessPath, materialImages.metallicRoughnessData, materialImages.metallicRoughnessKtx2);
+    appendOutputs(materialImages.writeNormal, materialImages.normalPath, materialImages.normalData, materialImages.normalKtx2);
+    appendOutputs(materialImages.writeEmissive, materialImages.emissivePath, materialImages.emissiveData, materialImages.emissiveKtx2);
+}
+
+// Packs, encodes and saves the planned images of a material and its levels of detail.
+bool convertPlannedImages(ConvertResult& convertResult, MaterialImages& materialImages, const ConvertOptions& runOptions, ThreadPool& threadPool)
+{
+    // The files of the material are queued to the writer stage, if there is one, and waited for before the cache and the result
+    // are updated. The group is destroyed first, as queued binary glTFs of the levels of detail point into their images
+
+    std::vector<MaterialImages> lodImages;
+    WriteGroup writeGroup;
+
+    ConvertOptions convertOptions = runOptions;
+    bool queueWrites = convertOptions.outputWriter && convertOptions.outputDescriptor < 0 && !convertOptions.keepOutputs;
+    convertOptions.writeGroup = queueWrites ? &writeGroup : nullptr;
+
+    convertResult.name = materialImages.stem;
+
+    // The cache is not used, when writing to standard output or keeping the outputs in memory
+
+    bool useCache = convertOptions.useCache && convertOptions.outputDescriptor < 0 && !convertOptions.keepOutputs;
+    std::string manifestPath = getOutputPath(materialImages, materialImages.stem + ".cache.json");
+
+    CacheManifest cacheManifest;
+    std::vector<uint64_t> cacheKeys;
+    std::vector<ImageRole> reusedImageRoles;
+
+    if (useCache) {
+        CacheManifest previousManifest;
+        loadCacheManifest(previousManifest, manifestPath);
+
+        if (applyCache(cacheKeys, reusedImageRoles, cacheManifest, materialImages, previousManifest, convertOptions)) {
+            // Modification times may have changed, so the manifest is updated nevertheless
+            saveCacheManifest(cacheManifest, manifestPath);
+
+            convertResult.savename = cacheManifest.savename;
+
+            printf("Success: Unchanged '%s'\n", convertResult.savename.c_str());
+
+            return true;
+        }
+
+        if (cacheKeys.empty()) {
+            useCache = false;
+        }
+    }
+
+    if (convertOptions.bandHeight > 0) {
+        if (!streamImages(convertResult, materialImages, convertOptions, threadPool)) {
+            return false;
+        }
+    } else {
+        if (!packImages(convertResult, materialImages, lodImages, convertOptions, threadPool)) {
+            return false;
+        }
+    }
+
+    for (ImageRole imageRole : reusedImageRoles) {
+        setWriteFlag(materialImages, imageRole);
+    }
+
+    const std::string& stem = materialImages.stem;
+
+    // The images of a binary glTF are embedded, so only the images of a glTF are separate outputs
+
+    bool appendImages = convertOptions.keepOutputs && !convertOptions.saveBinary;
+
+    std::string savename;
+    if (!saveMaterial(convertResult.error, savename, convertResult.outputFiles, materialImages, stem, convertOptions)) {
+        convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+        printf("Error: %s\n", convertResult.error.c_str());
+
+        return false;
+    }
+
+    if (appendImages) {
+        appendImageOutputs(convertResult.outputFiles, materialImages);
+    }
+
+    for (MaterialImages& levelImages : lodImages) {
+        std::string levelSavename;
+        if (!saveMaterial(convertResult.error, levelSavename, convertResult.outputFiles, levelImages, stem, convertOptions)) {
+            convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+            printf("Error: %s\n", convertResult.error.c_str());
+
+            return false;
+        }
+
+        if (appendImages) {
+            appendImageOutputs(convertResult.outputFiles, levelImages);
+        }
+
+        printf("Info: Saved level of detail '%s'\n", levelSavename.c_str());
+    }
+
+    std::string writeError;
+    if (!writeGroup.wait(writeError)) {
+        convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+        convertResult.error = writeError;
+        printf("Error: %s\n", convertResult.error.c_str());
+
+        return false;
+    }
+
+    convertResult.savename = savename;
+
+    if (useCache) {
+        if (!convertOptions.saveBinary) {
+            updateCache(cacheManifest, cacheKeys, materialImages);
+        }
+
+        cacheManifest.savename = savename;
+        if (!saveCacheManifest(cacheManifest, manifestPath)) {
+            printf("Warning: Could not save '%s'\n", manifestPath.c_str());
+        }
+    }
+
+    printf("Success: Converted to '%s'\n", savename.c_str());
+
+    return true;
+}
+
+// Estimates the peak working set of converting the planned images from their headers: The decoded sources, the packed images and
+// their encoded data, which are all held at once in the worst case. In streaming mode, only the bands are held.
+uint64_t estimateWorkingSet(const MaterialImages& materialImages, const ConvertOptions& convertOptions)
+{
+    const std::vector<PlannedImage>& plannedImages = materialImages.plannedImages;
+    if (plannedImages.empty()) {
+        return 0;
+    }
+
+    uint64_t width = plannedImages[0].imageInfo.width;
+    uint64_t height = plannedImages[0].imageInfo.height;
+    if (convertOptions.bandHeight > 0) {
+        height = std::min(height, 2 * static_cast<uint64_t>(convertOptions.bandHeight));
+    }
+    uint64_t pixelCount = width * height;
+
+    bool packBaseColor = false;
+    bool packMetallicRoughness = false;
+    bool packNormal = false;
+    bool packEmissive = false;
+
+    uint64_t byteCount = 0;
+
+    // Kept images are copied without decoding, so only their byte data counts, if it is read. A packed image is decoded once
+    for (size_t i = 0; i < plannedImages.size(); i++) {
+        const PlannedImage& plannedImage = plannedImages[i];
+
+        bool counted = false;
+        for (size_t j = 0; j < i; j++) {
+            counted = counted || isSameSource(plannedImages[j], plannedImage);
+        }
+
+        bool kept = false;
+        switch (plannedImage.imageRole) {
+            case IMAGE_ROLE_BASE_COLOR:
+                kept = materialImages.keepBaseColor;
+                packBaseColor = packBaseColor || !kept;
+                break;
+            case IMAGE_ROLE_OPACITY:
+                packBaseColor = true;
+                break;
+            case IMAGE_ROLE_NORMAL:
+                kept = convertOptions.keepNormalImageData;
+                packNormal = !kept;
+                break;
+            case IMAGE_ROLE_EMISSIVE:
+                kept = convertOptions.keepEmissiveImageData;
+                packEmissive = !kept;
+                break;
+            default:
+                kept = materialImages.keepMetallicRoughness;
+                packMetallicRoughness = !kept;
+                break;
+        }
+
+        if (counted) {
+            continue;
+        }
+
+        if (!kept) {
+            byteCount += pixelCount * plannedImage.imageInfo.channels;
+        } else if (plannedImage.data) {
+            byteCount += plannedImage.size;
+        } else if (!canPassThrough(plannedImage, convertOptions)) {
+            std::error_code errorCode;
+            uintmax_t fileSize = fs::file_size(plannedImage.filename, errorCode);
+            byteCount += errorCode ? 0 : static_cast<uint64_t>(fileSize);
+        }
+    }
+
+    // Encoded data is at most about the size of its pixels. Levels of detail add a third and a KTX2 copy one byte per pixel
+    uint64_t packedCount = (packBaseColor ? 4 : 0) + (packMetallicRoughness ? 3 : 0) + (packNormal ? 3 : 0) + (packEmissive ? 3 : 0);
+    uint64_t outputCount = 2 * pixelCount * packedCount;
+    if (convertOptions.saveKtx2) {
+        outputCount += pixelCount * ((packBaseColor ? 1 : 0) + (packMetallicRoughness ? 1 : 0) + (packNormal ? 1 : 0) + (packEmissive ? 1 : 0));
+    }
+    if (convertOptions.lodCount > 0 || convertOptions.saveKtx2) {
+        outputCount += outputCount / 3;
+    }
+
+    return byteCount + outputCount;
+}
+
+// Name of the folder itself, also for a path ending with a separator or a relative path like ".".
+std::string getFolderName(const std::string& path)
+{
+    std::error_code errorCode;
+    fs::path folderPath = fs::absolute(path, errorCode).lexically_normal();
+    if (!folderPath.has_filename()) {
+        folderPath = folderPath.parent_path();
+    }
+
+    std::string name = folderPath.filename().generic_string();
+
+    return name.empty() ? "pbr" : name;
+}
+
+// Converts every group as a task. With a memory budget, the groups are planned on the calling thread and each one is admitted
+// by the estimate of its working set, which is released, when its task is finished.
+void runGroups(std::vector<ConvertResult>& convertResults, std::vector<MaterialGroup>& materialGroups, std::vector<MaterialImages>& groupImages, const ConvertOptions& convertOptions, ThreadPool& threadPool, const std::function<bool(ConvertResult&, MaterialImages&)>& convertGroup)
+{
+    MemoryBudget* memoryBudget = convertOptions.memoryBudget;
+
+    TaskGroup taskGroup(threadPool);
+
+    for (size_t i = 0; i < materialGroups.size(); i++) {
+        uint64_t estimate = 0;
+        if (memoryBudget) {
+            planGroup(groupImages[i], materialGroups[i], convertOptions);
+
+            estimate = estimateWorkingSet(groupImages[i], convertOptions);
+            convertResults[i].estimatedMemory = estimate;
+
+            memoryBudget->reserve(estimate);
+        }
+
+        taskGroup.run([&convertResults, &materialGroups, &groupImages, &convertOptions, &convertGroup, memoryBudget, estimate, i]() {
+            ConvertResult& convertResult = convertResults[i];
+            MaterialImages& materialImages = groupImages[i];
+
+            TraceSpan materialSpan("material", materialGroups[i].stem);
+
+            try {
+                if (!memoryBudget) {
+                    planGroup(materialImages, materialGroups[i], convertOptions);
+                }
+
+                if (!convertGroup(convertResult, materialImages) && convertResult.errorCode == CONVERT_ERROR_NONE) {
+                    convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+                }
+            } catch (const std::exception& exception) {
+                convertResult.errorCode = CONVERT_ERROR_EXCEPTION;
+                convertResult.error = exception.what();
+
+                printf("Error: %s\n", convertResult.error.c_str());
+            }
+
+            if (memoryBudget) {
+                memoryBudget->release(estimate);
+            }
+        });
+    }
+
+    taskGroup.wait();
+}
+
+// Packs, encodes and saves the images of all groups of a folder concurrently and saves one glTF, which is named after the folder,
+// with one material per group. Levels of detail and the cache are not used.
+bool convertSharedMaterials(std::vector<ConvertResult>& convertResults, std::vector<MaterialGroup>& materialGroups, const std::string& path, const ConvertOptions& runOptions, ThreadPool& threadPool)
+{
+    // A queued binary glTF points into the images of all groups, so the write group is destroyed first
+
+    std::vector<MaterialImages> groupImages(materialGroups.size());
+    WriteGroup writeGroup;
+
+    ConvertOptions convertOptions = runOptions;
+    convertOptions.lodCount = 0;
+    convertOptions.useCache = false;
+
+    bool queueWrites = convertOptions.outputWriter && convertOptions.outputDescriptor < 0 && !convertOptions.keepOutputs;
+    convertOptions.writeGroup = queueWrites ? &writeGroup : nullptr;
+
+    runGroups(convertResults, materialGroups, groupImages, convertOptions, threadPool, [&convertOptions, &threadPool](ConvertResult& convertResult, MaterialImages& materialImages) {
+        convertResult.name = materialImages.stem;
+
+        std::vector<MaterialImages> lodImages;
+        if (convertOptions.bandHeight > 0) {
+            return streamImages(convertResult, materialImages, convertOptions, threadPool);
+        }
+
+        return packImages(convertResult, materialImages, lodImages, convertOptions, threadPool);
+    });
+
+    // Materials, which failed, are left out of the glTF. The kept outputs are returned with the first material
+
+    TraceSpan jsonSpan("json", path);
+
+    json images = json::array();
+    BinaryBuffer binaryBuffer;
+    json textures = json::array();
+    json materials = json::array();
+
+    size_t firstIndex = materialGroups.size();
+    for (size_t i = 0; i < materialGroups.size(); i++) {
+        if (convertResults[i].errorCode != CONVERT_ERROR_NONE) {
+            continue;
+        }
+
+        addMaterial(materials, textures, images, binaryBuffer, groupImages[i], groupImages[i].stem, convertOptions);
+
+        firstIndex = std::min(firstIndex, i);
+    }
+
+    if (firstIndex == materialGroups.size()) {
+        return false;
+    }
+
+    std::vector<OutputFile>& outputFiles = convertResults[firstIndex].outputFiles;
+
+    std::string error;
+    std::string savename;
+    bool saved = saveGltf(error, savename, outputFiles, materials, textures, images, binaryBuffer, getOutputPath(groupImages[firstIndex], getFolderName(path)), jsonSpan, convertOptions);
+    saved = saved && writeGroup.wait(error);
+
+    if (!saved) {
+        printf("Error: %s\n", error.c_str());
+    }
+
+    bool appendImages = convertOptions.keepOutputs && !convertOptions.saveBinary;
+
+    bool result = true;
+    for (size_t i = 0; i < materialGroups.size(); i++) {
+        ConvertResult& convertResult = convertResults[i];
+        if (convertResult.errorCode != CONVERT_ERROR_NONE) {
+            result = false;
+
+            continue;
+        }
+
+        if (!saved) {
+            convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+            convertResult.error = error;
+            result = false;
+
+            continue;
+        }
+
+        convertResult.savename = savename;
+
+        if (appendImages) {
+            appendImageOutputs(outputFiles, groupImages[i]);
+        }
+    }
+
+    if (saved) {
+        printf("Success: Converted %zu materials to '%s'\n", materials.size(), savename.c_str());
+    }
+
+    return result;
+}
+
+// Extension of PNG or JPEG byte data by its signature or an empty string.
+std::string getImageExtension(const uint8_t* data, size_t size)
+{
+    static const uint8_t pngSignature[8] = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A };
+    static const uint8_t jpegSignature[3] = { 0xFF, 0xD8, 0xFF };
+
+    if (size >= sizeof(pngSignature) && memcmp(data, pngSignature, sizeof(pngSignature)) == 0) {
+        return ".png";
+    }
+    if (size >= sizeof(jpegSignature) && memcmp(data, jpegSignature, sizeof(jpegSignature)) == 0) {
+        return ".jpg";
+    }
+
+    return "";
+}
+
+// Converts the classified members of a ZIP archive without extracting it. The members are inflated into memory and converted
+// like images given in memory, so the images are packed at once and the cache is not used.
+bool convertArchive(ConvertResult& convertResult, const std::string& path, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    ZipArchive zipArchive;
+    std::vector<ArchiveImage> archiveImages;
+
+    {
+        TraceSpan scanSpan("scan", path);
+
+        if (zipArchive.open(convertResult.error, path)) {
+            scanArchive(archiveImages, zipArchive, false);
+        } else {
+            convertResult.errorCode = CONVERT_ERROR_INPUT;
+        }
+    }
+
+    if (convertResult.errorCode == CONVERT_ERROR_NONE && !inflateArchive(convertResult.error, archiveImages, zipArchive, UINT64_MAX, threadPool)) {
+        convertResult.errorCode = CONVERT_ERROR_INPUT;
+    }
+
+    if (convertResult.errorCode != CONVERT_ERROR_NONE) {
+        printf("Error: %s\n", convertResult.error.c_str());
+
+        return false;
+    }
+
+    ConvertOptions archiveOptions = convertOptions;
+    archiveOptions.bandHeight = 0;
+    archiveOptions.useCache = false;
+
+    MaterialImages materialImages;
+
+    planArchive(materialImages, archiveImages, false);
+    planOutputs(materialImages, archiveOptions);
+
+    return convertPlannedImages(convertResult, materialImages, archiveOptions, threadPool);
+}
+
+}
+
+bool convertMaterial(ConvertResult& convertResult, const std::string& path, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    convertResult.folder = path;
+
+    TraceSpan materialSpan("material", path);
+
+    std::error_code errorCode;
+    if (isArchivePath(path) && fs::is_regular_file(path, errorCode)) {
+        return convertArchive(convertResult, path, convertOptions, threadPool);
+    }
+
+    if (!fs::is_directory(path, errorCode)) {
+        convertResult.errorCode = CONVERT_ERROR_INPUT;
+        convertResult.error = "Could not open folder '" + path + "'";
+        printf("Error: %s\n", convertResult.error.c_str());
+
+        return false;
+    }
+
+    //
+
+    MaterialImages materialImages;
+
+    planImages(materialImages, path, convertOptions);
+
+    return convertPlannedImages(convertResult, materialImages, convertOptions, threadPool);
+}
+
+bool estimateMaterialMemory(uint64_t& estimate, const std::string& path, const ConvertOptions& convertOptions)
+{
+    estimate = 0;
+
+    // The folder is planned quietly, as it is planned again, when it is converted
+    MaterialImages materialImages;
+
+    std::error_code errorCode;
+    if (isArchivePath(path) && fs::is_regular_file(path, errorCode)) {
+        ZipArchive zipArchive;
+        std::string error;
+        if (!zipArchive.open(error, path)) {
+            return false;
+        }
+
+        // Only the beginning of each member is inflated to read its header. The inflated members are held during the whole conversion
+        std::vector<ArchiveImage> archiveImages;
+        scanArchive(archiveImages, zipArchive, true);
+
+        uint64_t inflatedSize = 0;
+        for (ArchiveImage& archiveImage : archiveImages) {
+            inflatedSize += archiveImage.member->size;
+
+            if (zipArchive.readMember(archiveImage.data, error, *archiveImage.member, ARCHIVE_HEADER_SIZE)) {
+                for (PlannedImage& plannedImage : archiveImage.plannedImages) {
+                    plannedImage.data = archiveImage.data.data();
+                    plannedImage.size = archiveImage.data.size();
+                }
+            }
+        }
+
+        ConvertOptions archiveOptions = convertOptions;
+        archiveOptions.bandHeight = 0;
+
+        planArchive(materialImages, archiveImages, true);
+        planOutputs(materialImages, archiveOptions);
+
+        estimate = estimateWorkingSet(materialImages, archiveOptions) + inflatedSize;
+
+        return true;
+    }
+
+    for (fs::directory_iterator it(path, errorCode); !errorCode && it != fs::directory_iterator(); it.increment(errorCode)) {
+        std::vector<PlannedImage> plannedImages;
+        std::string stem;
+        if (!scanImage(plannedImages, stem, it->path().generic_string())) {
+            continue;
+        }
+
+        for (PlannedImage& plannedImage : plannedImages) {
+            planImage(materialImages, plannedImage, true);
+        }
+    }
+
+    if (errorCode) {
+        return false;
+    }
+
+    planOutputs(materialImages, convertOptions);
+
+    estimate = estimateWorkingSet(materialImages, convertOptions);
+
+    return true;
+}
+
+bool convertMaterials(std::vector<ConvertResult>& convertResults, const std::string& path, bool shareGltf, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    convertResults.clear();
+
+    std::vector<MaterialGroup> materialGroups;
+    std::string error;
+
+    std::error_code errorCode;
+    if (!fs::is_directory(path, errorCode)) {
+        error = "Could not open folder '" + path + "'";
+    } else if (scanMaterialGroups(materialGroups, error, path) && materialGroups.empty()) {
+        error = "Could not find any material in folder '" + path + "'";
+    }
+
+    if (!error.empty()) {
+        ConvertResult convertResult;
+        convertResult.folder = path;
+        convertResult.errorCode = CONVERT_ERROR_INPUT;
+        convertResult.error = error;
+        printf("Error: %s\n", convertResult.error.c_str());
+
+        convertResults.push_back(std::move(convertResult));
+
+        return false;
+    }
+
+    printf("Info: Found %zu materials in '%s'\n", materialGroups.size(), path.c_str());
+
+    convertResults.resize(materialGroups.size());
+    for (ConvertResult& convertResult : convertResults) {
+        convertResult.folder = path;
+    }
+
+    if (shareGltf) {
+        return convertSharedMaterials(convertResults, materialGroups, path, convertOptions, threadPool);
+    }
+
+    // The images of a material are released, as soon as it is converted
+    std::vector<MaterialImages> groupImages(materialGroups.size());
+
+    runGroups(convertResults, materialGroups, groupImages, convertOptions, threadPool, [&convertOptions, &threadPool](ConvertResult& convertResult, MaterialImages& materialImages) {
+        bool result = convertPlannedImages(convertResult, materialImages, convertOptions, threadPool);
+
+        materialImages = MaterialImages();
+
+        return result;
+    });
+
+    for (const ConvertResult& convertResult : convertResults) {
+        if (convertResult.errorCode != CONVERT_ERROR_NONE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool convertImages(ConvertResult& convertResult, const std::string& name, const std::vector<SourceImage>& sourceImages, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    convertResult.folder = name;
+
+    TraceSpan materialSpan("material", name);
+
+    // Images in memory are decoded at once and nothing is saved or shared
+
+    ConvertOptions memoryOptions = convertOptions;
+    memoryOptions.bandHeight = 0;
+    memoryOptions.outputDescriptor = -1;
+    memoryOptions.useCache = false;
+    memoryOptions.outputRegistry = nullptr;
+    memoryOptions.keepOutputs = true;
+
+    try {
+        MaterialImages materialImages;
+        if (!name.empty()) {
+            materialImages.stem = name;
+        }
+
+        for (const SourceImage& sourceImage : sourceImages) {
+            printf("Info: Processing '%s'\n", sourceImage.name.c_str());
+
+            std::string extension = getImageExtension(sourceImage.data, sourceImage.size);
+            if (extension.empty()) {
+                printf("Warning: Skipping image '%s' because of unknown format\n", sourceImage.name.c_str());
+
+                continue;
+            }
+
+            ImageClass imageClass;
+            if (sourceImage.imageRole != IMAGE_ROLE_UNKNOWN) {
+                ChannelRole channelRole;
+                channelRole.imageRole = sourceImage.imageRole;
+                channelRole.sourceChannel = sourceImage.sourceChannel;
+                imageClass.channelRoles.push_back(channelRole);
+            } else if (!classifyImage(imageClass, sourceImage.name)) {
+                printf("Info: Skipping image '%s' because of unknown role\n", sourceImage.name.c_str());
+
+                continue;
+            }
+
+            PlannedImage plannedImage;
+            plannedImage.filename = sourceImage.name;
+            plannedImage.extension = extension;
+            plannedImage.data = sourceImage.data;
+            plannedImage.size = sourceImage.size;
+
+            std::vector<PlannedImage> plannedImages;
+            addChannelRoles(plannedImages, plannedImage, imageClass);
+            for (PlannedImage& channelImage : plannedImages) {
+                planImage(materialImages, channelImage);
+            }
+        }
+
+        planOutputs(materialImages, memoryOptions);
+
+        return convertPlannedImages(convertResult, materialImages, memoryOptions, threadPool);
+    } catch (const std::exception& exception) {
+        convertResult.errorCode = CONVERT_ERROR_EXCEPTION;
+        convertResult.error = exception.what();
+        convertResult.outputFiles.clear();
+
+        printf("Error: %s\n", convertResult.error.c_str());
+
+        return false;
+    }
+}
+
+const char* getConvertErrorName(ConvertError convertError)
+{
+    switch (convertError) {
+        case CONVERT_ERROR_NONE:
+            return "none";
+        case CONVERT_ERROR_INPUT:
+            return "input";
+        case CONVERT_ERROR_ALLOCATE:
+            return "allocate";
+        case CONVERT_ERROR_OUTPUT:
+            return "output";
+        case CONVERT_ERROR_EXCEPTION:
+            return "exception";
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,123 @@
+#ifndef CONVERTER_H_
+#define CONVERTER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Bc7.h"
+#include "Png.h"
+
+class MemoryBudget;
+class OutputRegistry;
+class OutputWriter;
+class WriteGroup;
+
+enum PassthroughMode {
+    PASSTHROUGH_MODE_COPY,
+    PASSTHROUGH_MODE_HARDLINK
+};
+
+struct ConvertOptions {
+    float defaultMetallicFactor = 1.0f;
+    float defaultRoughnessFactor = 1.0f;
+    // Keeps the original base color image data, if no opacity is merged into it.
+    bool keepBaseColorImageData = true;
+    bool keepNormalImageData = true;
+    bool keepEmissiveImageData = true;
+    // Kept original images, which are neither embedded nor shared, are copied by the kernel or hardlinked to their source files.
+    PassthroughMode passthroughMode = PASSTHROUGH_MODE_COPY;
+    // Rows per band in streaming mode, zero decodes and packs the whole images at once.
+    uint32_t bandHeight = 0;
+    PngOptions pngOptions;
+    // Additional levels of detail, each one half the size of the previous one. Only created, when the images are packed at once.
+    uint32_t lodCount = 0;
+    // Saves a KTX2 copy with BC7 blocks and mip levels next to each packed image. Only created, when the images are packed at once.
+    bool saveKtx2 = false;
+    Bc7Quality bc7Quality = BC7_QUALITY_NORMAL;
+    // Replaces constant base color, metallic and roughness images by factors and drops white occlusion images.
+    bool foldConstants = true;
+    // Saves one binary glTF with the images embedded instead of a glTF and separate images.
+    bool saveBinary = false;
+    // Binary glTF is written to this file descriptor instead of a file, if not negative.
+    int32_t outputDescriptor = -1;
+    // Skips unchanged materials and reuses unchanged outputs recorded in the cache manifest next to the outputs.
+    bool useCache = false;
+    // Shares identical outputs between the materials of a run, if set.
+    OutputRegistry* outputRegistry = nullptr;
+    // Keeps the glTF or binary glTF and its images as outputs in the result instead of saving them. The cache is not used then.
+    bool keepOutputs = false;
+    // Folder, which the outputs are saved into, or an empty string for the current folder. The folder has to exist.
+    std::string outputFolder = "";
+    // Writes the output files on the thread of the writer stage, if set, so the workers continue encoding.
+    OutputWriter* outputWriter = nullptr;
+    // Files of the material being converted, which are queued to the writer stage. Set by the conversion.
+    WriteGroup* writeGroup = nullptr;
+    // Admits the materials of a split folder by the estimate of their working set, if set.
+    MemoryBudget* memoryBudget = nullptr;
+};
+
+// Image given in memory instead of found in a folder. An unknown role is found by the name.
+// The byte data has to be PNG or JPEG and stay valid during the conversion.
+struct SourceImage {
+    std::string name = "";
+    ImageRole imageRole = IMAGE_ROLE_UNKNOWN;
+    // Channel, which is read for opacity, metallic, roughness and occlusion, if the role is given.
+    uint32_t sourceChannel = 0;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// File, which is kept in memory instead of saved. The path is relative to the glTF.
+struct OutputFile {
+    std::string path = "";
+    std::vector<uint8_t> data;
+};
+
+enum ConvertError {
+    CONVERT_ERROR_NONE,
+    // The folder or a source image could not be read.
+    CONVERT_ERROR_INPUT,
+    CONVERT_ERROR_ALLOCATE,
+    // An output could not be encoded or saved. In streaming mode, this includes reading the sources of the output.
+    CONVERT_ERROR_OUTPUT,
+    // The conversion was aborted by an exception e.g. out of memory.
+    CONVERT_ERROR_EXCEPTION
+};
+
+struct ConvertResult {
+    std::string folder = "";
+    // Stem of the material, which names its outputs.
+    std::string name = "";
+    // Estimated peak working set, which was reserved from the memory budget, or zero.
+    uint64_t estimatedMemory = 0;
+    std::string savename = "";
+    ConvertError errorCode = CONVERT_ERROR_NONE;
+    std::string error = "";
+    // Kept outputs: The glTF or binary glTF first and then its images, followed by the levels of detail in the same order.
+    std::vector<OutputFile> outputFiles;
+};
+
+class ThreadPool;
+
+// Converts the PBR images found in one folder to a glTF 2.0 material. The images are decoded and encoded on the thread pool.
+// A path ending with ".zip" is read as an archive, which classified members are inflated into memory and packed at once without the cache.
+bool convertMaterial(ConvertResult& convertResult, const std::string& path, const ConvertOptions& convertOptions, ThreadPool& threadPool);
+
+// Converts every material found in one flat folder, which is scanned once. The images are grouped by their material stem and
+// the groups are converted concurrently, each one to its own glTF or, if shared, all to one glTF named after the folder.
+// A shared glTF has no levels of detail and does not use the cache. Its kept outputs are returned with the first material.
+// There is one result per material or one failed result, if the folder could not be scanned.
+// With a memory budget, the materials are planned and admitted on the calling thread, which must not be a worker of the thread pool.
+bool convertMaterials(std::vector<ConvertResult>& convertResults, const std::string& path, bool shareGltf, const ConvertOptions& convertOptions, ThreadPool& threadPool);
+
+// Estimates the peak working set of converting a material folder or archive from the headers of its images.
+bool estimateMaterialMemory(uint64_t& estimate, const std::string& path, const ConvertOptions& convertOptions);
+
+// Converts the PBR images given in memory to a glTF 2.0 material, which outputs are named after the given name.
+// The outputs are always kept in the result and the images are packed at once. Errors, including exceptions, are returned in the result.
+bool convertImages(ConvertResult& convertResult, const std::string& name, const std::vector<SourceImage>& sourceImages, const ConvertOptions& convertOptions, ThreadPool& threadPool);
+
+const char* getConvertErrorName(ConvertError convertError);
+
+#endif /* CONVERTER_H_ */
@@ -0,0 +1,92 @@
+#include "Dedup.h"
+
+#include <cstdio>
+
+#include "Helper.h"
+
+OutputRegistry::OutputRegistry(DedupMode dedupMode) :
+    dedupMode(dedupMode)
+{
+}
+
+DedupMode OutputRegistry::getDedupMode() const
+{
+    return dedupMode;
+}
+
+AcquireResult OutputRegistry::acquire(std::string& sharedPath, uint64_t key, const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = sharedOutputs.find(key);
+    if (it == sharedOutputs.end()) {
+        SharedOutput sharedOutput;
+        sharedOutput.path = path;
+        sharedOutputs[key] = sharedOutput;
+
+        return ACQUIRE_RESULT_FIRST;
+    }
+
+    if (!it->second.saved) {
+        return ACQUIRE_RESULT_BUSY;
+    }
+
+    sharedPath = it->second.path;
+
+    return ACQUIRE_RESULT_SHARED;
+}
+
+void OutputRegistry::complete(uint64_t key, bool success)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (success) {
+        sharedOutputs[key].saved = true;
+    } else {
+        sharedOutputs.erase(key);
+    }
+}
+
+//
+
+void unlinkOutput(const std::string& savePath)
+{
+    std::error_code errorCode;
+    if (fs::hard_link_count(savePath, errorCode) > 1 && !errorCode) {
+        fs::remove(savePath, errorCode);
+    }
+}
+
+bool shareOutput(std::string& error, std::string& savePath, const std::string& sharedPath, DedupMode dedupMode)
+{
+    if (savePath == sharedPath) {
+        return true;
+    }
+
+    printf("Info: Sharing '%s' for '%s'\n", sharedPath.c_str(), savePath.c_str());
+
+    if (dedupMode == DEDUP_MODE_REFERENCE) {
+        savePath = sharedPath;
+
+        return true;
+    }
+
+    std::error_code errorCode;
+    fs::remove(savePath, errorCode);
+
+    errorCode.clear();
+    fs::create_hard_link(sharedPath, savePath, errorCode);
+    if (!errorCode) {
+        return true;
+    }
+
+    errorCode.clear();
+    fs::copy_file(sharedPath, savePath, fs::copy_options::overwrite_existing, errorCode);
+    if (errorCode) {
+        error = "Could not link image '" + savePath + "'";
+
+        return false;
+    }
+
+    return true;
+}
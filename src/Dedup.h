@@ -0,0 +1,63 @@
+#ifndef DEDUP_H_
+#define DEDUP_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+enum DedupMode {
+    DEDUP_MODE_OFF,
+    DEDUP_MODE_REFERENCE,
+    DEDUP_MODE_HARDLINK
+};
+
+enum AcquireResult {
+    // The caller is the first with this key. It has to save the output and report it with complete.
+    ACQUIRE_RESULT_FIRST,
+    // The identical output was saved and sharedPath receives its path.
+    ACQUIRE_RESULT_SHARED,
+    // The identical output is still being saved. The caller saves its own copy without reporting it.
+    ACQUIRE_RESULT_BUSY
+};
+
+// Thread safe registry of the unique outputs of a run, so identical textures of different materials are encoded and stored once.
+// Outputs are identified by a hash of their decoded pixels or of their bytes.
+class OutputRegistry {
+public:
+
+    explicit OutputRegistry(DedupMode dedupMode);
+
+    OutputRegistry(const OutputRegistry&) = delete;
+    OutputRegistry& operator=(const OutputRegistry&) = delete;
+
+    DedupMode getDedupMode() const;
+
+    // Never waits for an output being saved: The saving task can be suspended lower on the stack of the caller, while it helps
+    // executing tasks of the pool, so waiting for it could deadlock.
+    AcquireResult acquire(std::string& sharedPath, uint64_t key, const std::string& path);
+
+    // A failed output is released, so the next caller with the same key saves its own output.
+    void complete(uint64_t key, bool success);
+
+private:
+
+    struct SharedOutput {
+        std::string path = "";
+        bool saved = false;
+    };
+
+    DedupMode dedupMode = DEDUP_MODE_OFF;
+
+    std::mutex mutex;
+    std::map<uint64_t, SharedOutput> sharedOutputs;
+};
+
+// Removes the file at savePath, if it is a hardlink of a previous run, so saving the output does not change the files sharing it.
+void unlinkOutput(const std::string& savePath);
+
+// Lets the output at savePath share the identical output at sharedPath: Either savePath is replaced by sharedPath, so the glTF refers to it,
+// or savePath becomes a hardlink to it. Falls back to a copy, if the file system does not support hardlinks.
+bool shareOutput(std::string& error, std::string& savePath, const std::string& sharedPath, DedupMode dedupMode);
+
+#endif /* DEDUP_H_ */
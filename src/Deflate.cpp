@@ -0,0 +1,1232 @@
+#include "Deflate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+namespace {
+
+const uint32_t WINDOW_SIZE = 32768;
+const uint32_t MIN_MATCH = 3;
+const uint32_t MAX_MATCH = 258;
+
+const uint32_t HASH_BITS = 15;
+
+// Input is compressed in steps of this size and a block is written, when enough tokens are collected.
+const size_t COMPRESS_STEP = 64 * 1024;
+const size_t MAX_BLOCK_TOKENS = 32 * 1024;
+
+const uint32_t MATCH_FLAG = 0x80000000;
+
+const uint32_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint32_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint32_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint32_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+const uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Like zlib, fast levels only insert the positions inside short matches into the hash chains
+// and lazy levels only look for a better match after short matches.
+struct LevelParameters {
+    uint32_t maxChain;
+    uint32_t niceLength;
+    uint32_t lazyLength;
+    bool lazy;
+};
+
+const LevelParameters LEVEL_PARAMETERS[10] = {
+    { 0, 0, 0, false },
+    { 4, 8, 4, false },
+    { 8, 16, 5, false },
+    { 32, 32, 6, false },
+    { 16, 16, 4, true },
+    { 32, 32, 16, true },
+    { 128, 128, 16, true },
+    { 256, 128, 32, true },
+    { 1024, 258, 128, true },
+    { 4096, 258, 258, true }
+};
+
+// Number of equal bytes at the start of both buffers up to maxLength.
+uint32_t countMatchingBytes(const uint8_t* a, const uint8_t* b, uint32_t maxLength)
+{
+    uint32_t length = 0;
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    // The first differing byte is the lowest set byte of the difference
+    while (length + 8 <= maxLength) {
+        uint64_t valueA;
+        uint64_t valueB;
+        memcpy(&valueA, a + length, 8);
+        memcpy(&valueB, b + length, 8);
+
+        uint64_t difference = valueA ^ valueB;
+        if (difference != 0) {
+            return length + static_cast<uint32_t>(__builtin_ctzll(difference) / 8);
+        }
+
+        length += 8;
+    }
+#endif
+
+    while (length < maxLength && a[length] == b[length]) {
+        length++;
+    }
+
+    return length;
+}
+
+struct Tables {
+    uint32_t crc[256];
+    uint8_t lengthCode[MAX_MATCH + 1];
+    uint8_t distanceCode[512];
+
+    Tables()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (uint32_t k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            crc[i] = c;
+        }
+
+        for (uint32_t code = 0; code < 29; code++) {
+            for (uint32_t length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1u << LENGTH_EXTRA[code]) && length <= MAX_MATCH; length++) {
+                lengthCode[length] = static_cast<uint8_t>(code);
+            }
+        }
+        // 258 has its own code, although 227 + 31 would also reach it
+        lengthCode[MAX_MATCH] = 28;
+
+        // Distances up to 256 are looked up directly, larger ones in steps of 128
+        for (uint32_t code = 0; code < 30; code++) {
+            for (uint32_t distance = DISTANCE_BASE[code]; distance < DISTANCE_BASE[code] + (1u << DISTANCE_EXTRA[code]); distance++) {
+                uint32_t d = distance - 1;
+                if (d < 256) {
+                    distanceCode[d] = static_cast<uint8_t>(code);
+                } else if ((d & 127) == 0) {
+                    distanceCode[256 + (d >> 7)] = static_cast<uint8_t>(code);
+                }
+            }
+        }
+    }
+};
+
+const Tables& getTables()
+{
+    static const Tables tables;
+
+    return tables;
+}
+
+uint32_t getDistanceCode(uint32_t distance)
+{
+    uint32_t d = distance - 1;
+
+    return (d < 256) ? getTables().distanceCode[d] : getTables().distanceCode[256 + (d >> 7)];
+}
+
+uint32_t reverseBits(uint32_t code, uint32_t length)
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        result = (result << 1) | (code & 1);
+        code >>= 1;
+    }
+
+    return result;
+}
+
+// Builds Huffman code lengths, which do not exceed maxLength. Frequencies are halved until the tree is flat enough.
+void buildCodeLengths(uint8_t* lengths, const uint32_t* frequencies, uint32_t count, uint32_t maxLength)
+{
+    std::vector<uint64_t> weights(frequencies, frequencies + count);
+
+    while (true) {
+        std::fill(lengths, lengths + count, 0);
+
+        std::vector<int32_t> parents;
+        std::priority_queue<std::pair<uint64_t, int32_t>, std::vector<std::pair<uint64_t, int32_t>>, std::greater<std::pair<uint64_t, int32_t>>> queue;
+
+        std::vector<int32_t> leaves;
+        for (uint32_t i = 0; i < count; i++) {
+            if (weights[i] > 0) {
+                queue.emplace(weights[i], static_cast<int32_t>(parents.size()));
+                parents.push_back(-1);
+                leaves.push_back(static_cast<int32_t>(i));
+            }
+        }
+
+        if (leaves.size() == 1) {
+            lengths[leaves[0]] = 1;
+
+            return;
+        }
+
+        while (queue.size() > 1) {
+            auto a = queue.top();
+            queue.pop();
+            auto b = queue.top();
+            queue.pop();
+
+            int32_t node = static_cast<int32_t>(parents.size());
+            parents.push_back(-1);
+            parents[a.second] = node;
+            parents[b.second] = node;
+
+            queue.emplace(a.first + b.first, node);
+        }
+
+        uint32_t deepest = 0;
+        for (size_t i = 0; i < leaves.size(); i++) {
+            uint32_t depth = 0;
+            for (int32_t node = static_cast<int32_t>(i); parents[node] >= 0; node = parents[node]) {
+                depth++;
+            }
+
+            lengths[leaves[i]] = static_cast<uint8_t>(depth);
+            deepest = std::max(deepest, depth);
+        }
+
+        if (deepest <= maxLength) {
+            return;
+        }
+
+        for (uint64_t& weight : weights) {
+            if (weight > 0) {
+                weight = (weight + 1) / 2;
+            }
+        }
+    }
+}
+
+// Canonical codes, bit reversed for the LSB first bit order of deflate.
+void buildCodes(uint16_t* codes, const uint8_t* lengths, uint32_t count)
+{
+    uint32_t lengthCounts[16] = {};
+    for (uint32_t i = 0; i < count; i++) {
+        lengthCounts[lengths[i]]++;
+    }
+    lengthCounts[0] = 0;
+
+    uint32_t nextCode[16] = {};
+    uint32_t code = 0;
+    for (uint32_t length = 1; length < 16; length++) {
+        code = (code + lengthCounts[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (lengths[i] > 0) {
+            codes[i] = static_cast<uint16_t>(reverseBits(nextCode[lengths[i]]++, lengths[i]));
+        } else {
+            codes[i] = 0;
+        }
+    }
+}
+
+void ensureTwoCodes(uint32_t* frequencies, uint32_t count)
+{
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        used += (frequencies[i] > 0) ? 1 : 0;
+    }
+
+    for (uint32_t i = 0; i < count && used < 2; i++) {
+        if (frequencies[i] == 0) {
+            frequencies[i] = 1;
+            used++;
+        }
+    }
+}
+
+}
+
+uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    const Tables& tables = getTables();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = tables.crc[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+uint32_t updateAdler32(uint32_t adler, const uint8_t* data, size_t size)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+
+    // 5552 is the largest block, for which the sums do not overflow before the modulo
+    while (size > 0) {
+        size_t blockSize = std::min(size, static_cast<size_t>(5552));
+        for (size_t i = 0; i < blockSize; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+
+        data += blockSize;
+        size -= blockSize;
+    }
+
+    return (b << 16) | a;
+}
+
+uint32_t combineAdler32(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    const uint32_t base = 65521;
+
+    // The second sum of the first block is weighted with the size of the second block
+    uint32_t remainder = static_cast<uint32_t>(size2 % base);
+    uint32_t sum1 = adler1 & 0xFFFF;
+    uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(remainder) * sum1) % base);
+
+    sum1 += (adler2 & 0xFFFF) + base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+
+    sum1 %= base;
+    sum2 %= base;
+
+    return (sum2 << 16) | sum1;
+}
+
+void writeZlibHeader(std::vector<uint8_t>& output, int32_t level)
+{
+    // 32 KiB window and the compression level hint, with the check bits making the header a multiple of 31
+    uint32_t levelHint = (level <= 1) ? 0 : ((level <= 5) ? 1 : ((level == 6) ? 2 : 3));
+    uint32_t header = (0x78 << 8) | (levelHint << 6);
+    header += 31 - (header % 31);
+
+    output.push_back(static_cast<uint8_t>(header >> 8));
+    output.push_back(static_cast<uint8_t>(header));
+}
+
+//
+
+Deflater::Deflater(int32_t level, bool zlibFormat) :
+    level(std::min(std::max(level, 0), 9)),
+    zlibFormat(zlibFormat)
+{
+    if (this->level > 0) {
+        hashHead.assign(static_cast<size_t>(1) << HASH_BITS, -1);
+        hashPrevious.assign(WINDOW_SIZE, -1);
+    }
+}
+
+void Deflater::setDictionary(const uint8_t* data, size_t size)
+{
+    if (zlibFormat || headerWritten || !buffer.empty()) {
+        return;
+    }
+
+    size_t dictionarySize = std::min(size, static_cast<size_t>(WINDOW_SIZE));
+    buffer.assign(data + size - dictionarySize, data + size);
+
+    if (level > 0) {
+        for (size_t i = 0; i + MIN_MATCH <= buffer.size(); i++) {
+            insertHash(i);
+        }
+    }
+
+    position = buffer.size();
+}
+
+void Deflater::write(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+    this->output = &output;
+
+    writeHeader();
+
+    if (zlibFormat) {
+        adler = updateAdler32(adler, data, size);
+    }
+
+    buffer.insert(buffer.end(), data, data + size);
+
+    if (level == 0) {
+        writeStoredBlocks(false);
+    } else {
+        compress(false);
+    }
+
+    this->output = nullptr;
+}
+
+void Deflater::flush(std::vector<uint8_t>& output)
+{
+    this->output = &output;
+
+    writeHeader();
+
+    if (level == 0) {
+        writeStoredBlocks(false);
+
+        // The remaining data is written as a stored block of its own
+        size_t length = buffer.size() - position;
+        if (length > 0) {
+            putBits(0, 3);
+            alignToByte();
+            putBits(static_cast<uint32_t>(length), 16);
+            putBits(static_cast<uint32_t>(~length) & 0xFFFF, 16);
+            output.insert(output.end(), buffer.begin() + position, buffer.end());
+            position = buffer.size();
+        }
+    } else {
+        compress(true);
+        if (!tokens.empty()) {
+            writeBlock(false);
+        }
+    }
+
+    // Empty stored block
+    putBits(0, 3);
+    alignToByte();
+    putBits(0x0000, 16);
+    putBits(0xFFFF, 16);
+
+    this->output = nullptr;
+}
+
+void Deflater::finish(std::vector<uint8_t>& output)
+{
+    this->output = &output;
+
+    writeHeader();
+
+    if (level == 0) {
+        writeStoredBlocks(true);
+    } else {
+        compress(true);
+        writeBlock(true);
+    }
+
+    alignToByte();
+
+    if (zlibFormat) {
+        output.push_back(static_cast<uint8_t>(adler >> 24));
+        output.push_back(static_cast<uint8_t>(adler >> 16));
+        output.push_back(static_cast<uint8_t>(adler >> 8));
+        output.push_back(static_cast<uint8_t>(adler));
+    }
+
+    this->output = nullptr;
+}
+
+void Deflater::writeHeader()
+{
+    if (headerWritten) {
+        return;
+    }
+    headerWritten = true;
+
+    if (zlibFormat) {
+        writeZlibHeader(*output, level);
+    }
+}
+
+void Deflater::putBits(uint32_t value, uint32_t count)
+{
+    bitBuffer |= static_cast<uint64_t>(value) << bitCount;
+    bitCount += count;
+
+    if (bitCount >= 32) {
+        uint8_t bytes[4] = { static_cast<uint8_t>(bitBuffer), static_cast<uint8_t>(bitBuffer >> 8), static_cast<uint8_t>(bitBuffer >> 16), static_cast<uint8_t>(bitBuffer >> 24) };
+        output->insert(output->end(), bytes, bytes + 4);
+
+        bitBuffer >>= 32;
+        bitCount -= 32;
+    }
+}
+
+void Deflater::alignToByte()
+{
+    bitCount = (bitCount + 7) & ~7u;
+
+    while (bitCount > 0) {
+        output->push_back(static_cast<uint8_t>(bitBuffer));
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+void Deflater::writeStoredBlocks(bool final)
+{
+    while (true) {
+        size_t length = buffer.size() - position;
+        if (length < 65535 && !final) {
+            break;
+        }
+
+        length = std::min(length, static_cast<size_t>(65535));
+        bool last = final && (position + length == buffer.size());
+
+        putBits(last ? 1 : 0, 3);
+        alignToByte();
+        putBits(static_cast<uint32_t>(length), 16);
+        putBits(static_cast<uint32_t>(~length) & 0xFFFF, 16);
+        output->insert(output->end(), buffer.begin() + position, buffer.begin() + position + length);
+        position += length;
+
+        if (last) {
+            break;
+        }
+    }
+
+    buffer.erase(buffer.begin(), buffer.begin() + position);
+    bufferStart += position;
+    position = 0;
+}
+
+void Deflater::insertHash(size_t offset)
+{
+    const uint8_t* data = buffer.data() + offset;
+
+    uint32_t value = static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16);
+    uint32_t hash = (value * 2654435761u) >> (32 - HASH_BITS);
+
+    int64_t streamPosition = static_cast<int64_t>(bufferStart + offset);
+
+    hashPrevious[streamPosition & (WINDOW_SIZE - 1)] = hashHead[hash];
+    hashHead[hash] = streamPosition;
+}
+
+void Deflater::findMatch(uint32_t& length, uint32_t& distance, size_t offset, size_t end) const
+{
+    length = 0;
+    distance = 0;
+
+    size_t available = end - offset;
+    if (available < MIN_MATCH) {
+        return;
+    }
+
+    const LevelParameters& levelParameters = LEVEL_PARAMETERS[level];
+
+    uint32_t maxLength = static_cast<uint32_t>(std::min(available, static_cast<size_t>(MAX_MATCH)));
+
+    const uint8_t* data = buffer.data() + offset;
+
+    uint32_t value = static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16);
+    uint32_t hash = (value * 2654435761u) >> (32 - HASH_BITS);
+
+    int64_t streamPosition = static_cast<int64_t>(bufferStart + offset);
+    int64_t limit = std::max(static_cast<int64_t>(bufferStart), streamPosition - static_cast<int64_t>(WINDOW_SIZE));
+
+    uint32_t bestLength = MIN_MATCH - 1;
+
+    int64_t candidate = hashHead[hash];
+    for (uint32_t chain = 0; chain < levelParameters.maxChain && candidate >= limit && candidate < streamPosition; chain++) {
+        const uint8_t* match = buffer.data() + (candidate - static_cast<int64_t>(bufferStart));
+
+        if (match[bestLength] == data[bestLength] && match[0] == data[0] && match[1] == data[1]) {
+            uint32_t matchLength = 2 + countMatchingBytes(match + 2, data + 2, maxLength - 2);
+
+            if (matchLength > bestLength) {
+                bestLength = matchLength;
+                length = matchLength;
+                distance = static_cast<uint32_t>(streamPosition - candidate);
+
+                if (matchLength >= levelParameters.niceLength || matchLength == maxLength) {
+                    break;
+                }
+            }
+        }
+
+        int64_t next = hashPrevious[candidate & (WINDOW_SIZE - 1)];
+        if (next >= candidate) {
+            break;
+        }
+        candidate = next;
+    }
+}
+
+void Deflater::compress(bool all)
+{
+    const LevelParameters& levelParameters = LEVEL_PARAMETERS[level];
+
+    while (true) {
+        size_t end = buffer.size();
+
+        // Without all, enough look ahead for the longest match is kept
+        size_t limit = all ? end : ((end > MAX_MATCH) ? end - MAX_MATCH : 0);
+        limit = std::min(limit, position + COMPRESS_STEP);
+        if (position >= limit) {
+            break;
+        }
+
+        while (position < limit) {
+            uint32_t length = 0;
+            uint32_t distance = 0;
+
+            if (hasPendingMatch) {
+                length = pendingLength;
+                distance = pendingDistance;
+                hasPendingMatch = false;
+            } else {
+                findMatch(length, distance, position, end);
+            }
+
+            if (end - position >= MIN_MATCH) {
+                insertHash(position);
+            }
+
+            // Lazy matching: a literal is emitted, if the next position has a longer match
+            if (levelParameters.lazy && length >= MIN_MATCH && length < levelParameters.lazyLength && position + 1 < limit) {
+                uint32_t nextLength = 0;
+                uint32_t nextDistance = 0;
+                findMatch(nextLength, nextDistance, position + 1, end);
+
+                if (nextLength > length) {
+                    tokens.push_back(buffer[position]);
+                    position++;
+
+                    hasPendingMatch = true;
+                    pendingLength = nextLength;
+                    pendingDistance = nextDistance;
+
+                    if (tokens.size() >= MAX_BLOCK_TOKENS) {
+                        writeBlock(false);
+                    }
+
+                    continue;
+                }
+            }
+
+            if (length >= MIN_MATCH) {
+                tokens.push_back(MATCH_FLAG | (length << 16) | (distance - 1));
+
+                if (levelParameters.lazy || length <= levelParameters.lazyLength) {
+                    for (uint32_t i = 1; i < length; i++) {
+                        if (end - (position + i) >= MIN_MATCH) {
+                            insertHash(position + i);
+                        }
+                    }
+                }
+                position += length;
+            } else {
+                tokens.push_back(buffer[position]);
+                position++;
+            }
+
+            if (tokens.size() >= MAX_BLOCK_TOKENS) {
+                writeBlock(false);
+            }
+        }
+
+        slideWindow();
+    }
+
+    // A pending match may reach beyond the data, which was available, when it was searched
+    if (all) {
+        hasPendingMatch = false;
+    }
+}
+
+void Deflater::slideWindow()
+{
+    // Only the last 32 KiB are needed for matches
+    if (position <= WINDOW_SIZE + COMPRESS_STEP) {
+        return;
+    }
+
+    size_t shift = position - WINDOW_SIZE;
+
+    buffer.erase(buffer.begin(), buffer.begin() + shift);
+    bufferStart += shift;
+    position -= shift;
+}
+
+void Deflater::writeBlock(bool final)
+{
+    uint32_t literalFrequencies[286] = {};
+    uint32_t distanceFrequencies[30] = {};
+
+    const Tables& tables = getTables();
+
+    for (uint32_t token : tokens) {
+        if (token & MATCH_FLAG) {
+            uint32_t length = (token >> 16) & 0x1FF;
+            uint32_t distance = (token & 0xFFFF) + 1;
+
+            literalFrequencies[257 + tables.lengthCode[length]]++;
+            distanceFrequencies[getDistanceCode(distance)]++;
+        } else {
+            literalFrequencies[token]++;
+        }
+    }
+    literalFrequencies[256] = 1;
+
+    ensureTwoCodes(literalFrequencies, 286);
+    ensureTwoCodes(distanceFrequencies, 30);
+
+    uint8_t literalLengths[286] = {};
+    uint8_t distanceLengths[30] = {};
+    buildCodeLengths(literalLengths, literalFrequencies, 286, 15);
+    buildCodeLengths(distanceLengths, distanceFrequencies, 30, 15);
+
+    uint32_t literalCount = 286;
+    while (literalCount > 257 && literalLengths[literalCount - 1] == 0) {
+        literalCount--;
+    }
+    uint32_t distanceCount = 30;
+    while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) {
+        distanceCount--;
+    }
+
+    // Run length encoding of the code lengths with the symbols 16, 17 and 18
+
+    std::vector<uint8_t> lengths(literalLengths, literalLengths + literalCount);
+    lengths.insert(lengths.end(), distanceLengths, distanceLengths + distanceCount);
+
+    std::vector<uint32_t> lengthSymbols;
+    uint32_t lengthFrequencies[19] = {};
+
+    for (size_t i = 0; i < lengths.size();) {
+        uint8_t current = lengths[i];
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == current) {
+            run++;
+        }
+
+        size_t remaining = run;
+        if (current == 0) {
+            while (remaining >= 11) {
+                uint32_t count = static_cast<uint32_t>(std::min(remaining, static_cast<size_t>(138)));
+                lengthSymbols.push_back(18 | ((count - 11) << 8));
+                lengthFrequencies[18]++;
+                remaining -= count;
+            }
+            if (remaining >= 3) {
+                lengthSymbols.push_back(17 | ((static_cast<uint32_t>(remaining) - 3) << 8));
+                lengthFrequencies[17]++;
+                remaining = 0;
+            }
+        } else {
+            lengthSymbols.push_back(current);
+            lengthFrequencies[current]++;
+            remaining--;
+
+            while (remaining >= 3) {
+                uint32_t count = static_cast<uint32_t>(std::min(remaining, static_cast<size_t>(6)));
+                lengthSymbols.push_back(16 | ((count - 3) << 8));
+                lengthFrequencies[16]++;
+                remaining -= count;
+            }
+        }
+        while (remaining > 0) {
+            lengthSymbols.push_back(current);
+            lengthFrequencies[current]++;
+            remaining--;
+        }
+
+        i += run;
+    }
+
+    // zlib rejects a code length code with a single symbol
+    ensureTwoCodes(lengthFrequencies, 19);
+
+    uint8_t codeLengthLengths[19] = {};
+    buildCodeLengths(codeLengthLengths, lengthFrequencies, 19, 7);
+
+    uint32_t codeLengthCount = 19;
+    while (codeLengthCount > 4 && codeLengthLengths[CODE_LENGTH_ORDER[codeLengthCount - 1]] == 0) {
+        codeLengthCount--;
+    }
+
+    // Compare the dynamic against the fixed codes
+
+    uint64_t dynamicBits = 5 + 5 + 4 + 3 * codeLengthCount;
+    for (uint32_t i = 0; i < 19; i++) {
+        uint32_t extra = (i == 16) ? 2 : ((i == 17) ? 3 : ((i == 18) ? 7 : 0));
+        dynamicBits += static_cast<uint64_t>(lengthFrequencies[i]) * (codeLengthLengths[i] + extra);
+    }
+
+    uint64_t fixedBits = 0;
+    for (uint32_t i = 0; i < 286; i++) {
+        uint32_t extra = (i > 256) ? LENGTH_EXTRA[i - 257] : 0;
+        uint32_t fixedLength = (i < 144) ? 8 : ((i < 256) ? 9 : ((i < 280) ? 7 : 8));
+
+        dynamicBits += static_cast<uint64_t>(literalFrequencies[i]) * (literalLengths[i] + extra);
+        fixedBits += static_cast<uint64_t>(literalFrequencies[i]) * (fixedLength + extra);
+    }
+    for (uint32_t i = 0; i < 30; i++) {
+        dynamicBits += static_cast<uint64_t>(distanceFrequencies[i]) * (distanceLengths[i] + DISTANCE_EXTRA[i]);
+        fixedBits += static_cast<uint64_t>(distanceFrequencies[i]) * (5 + DISTANCE_EXTRA[i]);
+    }
+
+    uint16_t literalCodes[288] = {};
+    uint16_t distanceCodes[30] = {};
+
+    if (fixedBits <= dynamicBits) {
+        uint8_t fixedLiteralLengths[288];
+        for (uint32_t i = 0; i < 288; i++) {
+            fixedLiteralLengths[i] = (i < 144) ? 8 : ((i < 256) ? 9 : ((i < 280) ? 7 : 8));
+        }
+        memcpy(literalLengths, fixedLiteralLengths, sizeof(literalLengths));
+        std::fill(distanceLengths, distanceLengths + 30, 5);
+
+        buildCodes(literalCodes, fixedLiteralLengths, 288);
+        buildCodes(distanceCodes, distanceLengths, 30);
+
+        putBits(final ? 1 : 0, 1);
+        putBits(1, 2);
+    } else {
+        buildCodes(literalCodes, literalLengths, 286);
+        buildCodes(distanceCodes, distanceLengths, 30);
+
+        uint16_t codeLengthCodes[19] = {};
+        buildCodes(codeLengthCodes, codeLengthLengths, 19);
+
+        putBits(final ? 1 : 0, 1);
+        putBits(2, 2);
+        putBits(literalCount - 257, 5);
+        putBits(distanceCount - 1, 5);
+        putBits(codeLengthCount - 4, 4);
+        for (uint32_t i = 0; i < codeLengthCount; i++) {
+            putBits(codeLengthLengths[CODE_LENGTH_ORDER[i]], 3);
+        }
+
+        for (uint32_t lengthSymbol : lengthSymbols) {
+            uint32_t symbol = lengthSymbol & 0xFF;
+            putBits(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+
+            if (symbol == 16) {
+                putBits(lengthSymbol >> 8, 2);
+            } else if (symbol == 17) {
+                putBits(lengthSymbol >> 8, 3);
+            } else if (symbol == 18) {
+                putBits(lengthSymbol >> 8, 7);
+            }
+        }
+    }
+
+    for (uint32_t token : tokens) {
+        if (token & MATCH_FLAG) {
+            uint32_t length = (token >> 16) & 0x1FF;
+            uint32_t distance = (token & 0xFFFF) + 1;
+
+            uint32_t lengthCode = tables.lengthCode[length];
+            putBits(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+            putBits(length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+            uint32_t distanceCode = getDistanceCode(distance);
+            putBits(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+            putBits(distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+        } else {
+            putBits(literalCodes[token], literalLengths[token]);
+        }
+    }
+
+    putBits(literalCodes[256], literalLengths[256]);
+
+    tokens.clear();
+}
+
+//
+
+Inflater::Inflater(ReadFunction readFunction, bool zlibFormat) :
+    readFunction(std::move(readFunction)),
+    zlibFormat(zlibFormat),
+    input(64 * 1024),
+    window(WINDOW_SIZE)
+{
+}
+
+bool Inflater::refill()
+{
+    while (bitCount <= 56) {
+        if (inputPosition == inputEnd) {
+            if (!inputEnded) {
+                inputPosition = 0;
+                inputEnd = readFunction(input.data(), input.size());
+                inputEnded = (inputEnd == 0);
+            }
+
+            if (inputEnded) {
+                // Zero bits are appended, so the last code can be decoded. Reading more than a few of them is an error.
+                if (paddingBits > 64) {
+                    return bitCount > 0;
+                }
+                paddingBits += 8;
+                bitCount += 8;
+
+                continue;
+            }
+        }
+
+        bitBuffer |= static_cast<uint64_t>(input[inputPosition++]) << bitCount;
+        bitCount += 8;
+    }
+
+    return true;
+}
+
+bool Inflater::getBits(uint32_t& value, uint32_t count)
+{
+    if (bitCount < count && !refill()) {
+        return false;
+    }
+    if (bitCount < count) {
+        return false;
+    }
+
+    value = static_cast<uint32_t>(bitBuffer & ((static_cast<uint64_t>(1) << count) - 1));
+    bitBuffer >>= count;
+    bitCount -= count;
+
+    return true;
+}
+
+bool Inflater::buildHuffman(Huffman& huffman, const uint8_t* sizes, uint32_t count)
+{
+    uint32_t sizeCounts[17] = {};
+    uint32_t nextCode[16] = {};
+
+    memset(huffman.fast, 0, sizeof(huffman.fast));
+
+    for (uint32_t i = 0; i < count; i++) {
+        sizeCounts[sizes[i]]++;
+    }
+    sizeCounts[0] = 0;
+
+    uint32_t code = 0;
+    uint32_t k = 0;
+    for (uint32_t i = 1; i < 16; i++) {
+        nextCode[i] = code;
+        huffman.firstCode[i] = static_cast<uint16_t>(code);
+        huffman.firstSymbol[i] = static_cast<uint16_t>(k);
+
+        code += sizeCounts[i];
+        if (sizeCounts[i] && code - 1 >= (1u << i)) {
+            return false;
+        }
+
+        huffman.maxCode[i] = code << (16 - i);
+        code <<= 1;
+        k += sizeCounts[i];
+    }
+    huffman.maxCode[16] = 0x10000;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t s = sizes[i];
+        if (s == 0) {
+            continue;
+        }
+
+        uint32_t c = nextCode[s] - huffman.firstCode[s] + huffman.firstSymbol[s];
+        huffman.size[c] = static_cast<uint8_t>(s);
+        huffman.value[c] = static_cast<uint16_t>(i);
+
+        if (s <= 9) {
+            uint32_t j = reverseBits(nextCode[s], s);
+            while (j < (1u << 9)) {
+                huffman.fast[j] = static_cast<uint16_t>((s << 9) | i);
+                j += (1u << s);
+            }
+        }
+
+        nextCode[s]++;
+    }
+
+    return true;
+}
+
+bool Inflater::decodeSymbol(uint32_t& symbol, const Huffman& huffman)
+{
+    if (bitCount < 16 && !refill()) {
+        return false;
+    }
+
+    uint32_t fast = huffman.fast[bitBuffer & ((1u << 9) - 1)];
+    if (fast) {
+        uint32_t s = fast >> 9;
+        if (s > bitCount) {
+            return false;
+        }
+
+        bitBuffer >>= s;
+        bitCount -= s;
+        symbol = fast & 511;
+
+        return true;
+    }
+
+    // Codes longer than the fast table are compared bit reversed against the maximum code of each length
+    uint32_t k = reverseBits(static_cast<uint32_t>(bitBuffer & 0xFFFF), 16);
+    uint32_t s = 10;
+    while (k >= huffman.maxCode[s]) {
+        s++;
+    }
+    if (s >= 16 || s > bitCount) {
+        return false;
+    }
+
+    uint32_t b = (k >> (16 - s)) - huffman.firstCode[s] + huffman.firstSymbol[s];
+    if (b >= 288 || huffman.size[b] != s) {
+        return false;
+    }
+
+    bitBuffer >>= s;
+    bitCount -= s;
+    symbol = huffman.value[b];
+
+    return true;
+}
+
+bool Inflater::readDynamicTables()
+{
+    uint32_t literalCount = 0;
+    uint32_t distanceCount = 0;
+    uint32_t codeLengthCount = 0;
+    if (!getBits(literalCount, 5) || !getBits(distanceCount, 5) || !getBits(codeLengthCount, 4)) {
+        return false;
+    }
+    literalCount += 257;
+    distanceCount += 1;
+    codeLengthCount += 4;
+
+    uint8_t codeLengthSizes[19] = {};
+    for (uint32_t i = 0; i < codeLengthCount; i++) {
+        uint32_t size = 0;
+        if (!getBits(size, 3)) {
+            return false;
+        }
+        codeLengthSizes[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(size);
+    }
+
+    Huffman codeLengthHuffman;
+    if (!buildHuffman(codeLengthHuffman, codeLengthSizes, 19)) {
+        return false;
+    }
+
+    uint8_t sizes[286 + 32] = {};
+    uint32_t total = literalCount + distanceCount;
+    uint32_t n = 0;
+    while (n < total) {
+        uint32_t symbol = 0;
+        if (!decodeSymbol(symbol, codeLengthHuffman)) {
+            return false;
+        }
+
+        if (symbol < 16) {
+            sizes[n++] = static_cast<uint8_t>(symbol);
+
+            continue;
+        }
+
+        uint32_t repeat = 0;
+        uint8_t fill = 0;
+        if (symbol == 16) {
+            if (n == 0 || !getBits(repeat, 2)) {
+                return false;
+            }
+            repeat += 3;
+            fill = sizes[n - 1];
+        } else if (symbol == 17) {
+            if (!getBits(repeat, 3)) {
+                return false;
+            }
+            repeat += 3;
+        } else {
+            if (!getBits(repeat, 7)) {
+                return false;
+            }
+            repeat += 11;
+        }
+
+        if (n + repeat > total) {
+            return false;
+        }
+
+        memset(sizes + n, fill, repeat);
+        n += repeat;
+    }
+
+    if (sizes[256] == 0) {
+        return false;
+    }
+
+    return buildHuffman(literalHuffman, sizes, literalCount) && buildHuffman(distanceHuffman, sizes + literalCount, distanceCount);
+}
+
+bool Inflater::readBlockHeader()
+{
+    uint32_t final = 0;
+    uint32_t type = 0;
+    if (!getBits(final, 1) || !getBits(type, 2)) {
+        return false;
+    }
+    finalBlock = (final != 0);
+
+    if (type == 0) {
+        // Stored blocks start at the next byte boundary
+        uint32_t skip = bitCount % 8;
+        uint32_t ignored = 0;
+        if (!getBits(ignored, skip)) {
+            return false;
+        }
+
+        uint32_t length = 0;
+        uint32_t inverseLength = 0;
+        if (!getBits(length, 16) || !getBits(inverseLength, 16) || (length ^ 0xFFFF) != inverseLength) {
+            return false;
+        }
+
+        storedRemaining = length;
+        state = STATE_STORED;
+
+        return true;
+    }
+
+    if (type == 1) {
+        uint8_t sizes[288 + 32];
+        for (uint32_t i = 0; i < 288; i++) {
+            sizes[i] = (i < 144) ? 8 : ((i < 256) ? 9 : ((i < 280) ? 7 : 8));
+        }
+        for (uint32_t i = 288; i < 288 + 32; i++) {
+            sizes[i] = 5;
+        }
+
+        if (!buildHuffman(literalHuffman, sizes, 288) || !buildHuffman(distanceHuffman, sizes + 288, 32)) {
+            return false;
+        }
+
+        state = STATE_HUFFMAN;
+
+        return true;
+    }
+
+    if (type == 2) {
+        if (!readDynamicTables()) {
+            return false;
+        }
+
+        state = STATE_HUFFMAN;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool Inflater::read(uint8_t* data, size_t size)
+{
+    size_t produced = 0;
+
+    while (produced < size) {
+        if (copyLength > 0) {
+            uint32_t count = static_cast<uint32_t>(std::min(static_cast<size_t>(copyLength), size - produced));
+            for (uint32_t i = 0; i < count; i++) {
+                uint8_t value = window[(windowPosition - copyDistance) & (WINDOW_SIZE - 1)];
+                putByte(value);
+                data[produced++] = value;
+            }
+            copyLength -= count;
+
+            continue;
+        }
+
+        switch (state) {
+            case STATE_HEADER: {
+                if (zlibFormat) {
+                    uint32_t cmf = 0;
+                    uint32_t flg = 0;
+                    if (!getBits(cmf, 8) || !getBits(flg, 8) || (cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) {
+                        state = STATE_ERROR;
+
+                        return false;
+                    }
+                }
+
+                state = STATE_BLOCK;
+
+                break;
+            }
+            case STATE_BLOCK: {
+                if (!readBlockHeader()) {
+                    state = STATE_ERROR;
+
+                    return false;
+                }
+
+                break;
+            }
+            case STATE_STORED: {
+                while (storedRemaining > 0 && produced < size) {
+                    uint32_t value = 0;
+                    if (!getBits(value, 8)) {
+                        state = STATE_ERROR;
+
+                        return false;
+                    }
+
+                    putByte(static_cast<uint8_t>(value));
+                    data[produced++] = static_cast<uint8_t>(value);
+                    storedRemaining--;
+                }
+
+                if (storedRemaining == 0) {
+                    state = finalBlock ? STATE_DONE : STATE_BLOCK;
+                }
+
+                break;
+            }
+            case STATE_HUFFMAN: {
+                uint32_t symbol = 0;
+                if (!decodeSymbol(symbol, literalHuffman)) {
+                    state = STATE_ERROR;
+
+                    return false;
+                }
+
+                if (symbol < 256) {
+                    putByte(static_cast<uint8_t>(symbol));
+                    data[produced++] = static_cast<uint8_t>(symbol);
+                } else if (symbol == 256) {
+                    state = finalBlock ? STATE_DONE : STATE_BLOCK;
+                } else {
+                    symbol -= 257;
+                    if (symbol >= 29) {
+                        state = STATE_ERROR;
+
+                        return false;
+                    }
+
+                    uint32_t extra = 0;
+                    if (!getBits(extra, LENGTH_EXTRA[symbol])) {
+                        state = STATE_ERROR;
+
+                        return false;
+                    }
+                    copyLength = LENGTH_BASE[symbol] + extra;
+
+                    uint32_t distanceSymbol = 0;
+                    if (!decodeSymbol(distanceSymbol, distanceHuffman) || distanceSymbol >= 30 || !getBits(extra, DISTANCE_EXTRA[distanceSymbol])) {
+                        state = STATE_ERROR;
+
+                        return false;
+                    }
+                    copyDistance = DISTANCE_BASE[distanceSymbol] + extra;
+
+                    if (copyDistance > windowPosition) {
+                        state = STATE_ERROR;
+
+                        return false;
+                    }
+                }
+
+                break;
+            }
+            case STATE_DONE:
+            case STATE_ERROR:
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,157 @@
+#ifndef DEFLATE_H_
+#define DEFLATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Checksums start with 0 for CRC-32 and 1 for Adler-32.
+uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t size);
+
+uint32_t updateAdler32(uint32_t adler, const uint8_t* data, size_t size);
+
+// Returns the Adler-32 of two concatenated blocks from their checksums and the size of the second block.
+uint32_t combineAdler32(uint32_t adler1, uint32_t adler2, size_t size2);
+
+// Appends the two byte zlib header for a 32 KiB window and the given compression level.
+void writeZlibHeader(std::vector<uint8_t>& output, int32_t level);
+
+// Streaming zlib (RFC 1950) and raw deflate (RFC 1951) compressor using LZ77 hash chains and dynamic Huffman blocks.
+// Level 0 only stores the data, levels 1 to 9 trade speed against size.
+class Deflater {
+public:
+
+    explicit Deflater(int32_t level = 6, bool zlibFormat = true);
+
+    // Presets the last 32 KiB of data as history for matches. Only allowed for raw deflate, before the first write.
+    void setDictionary(const uint8_t* data, size_t size);
+
+    // Compresses data and appends the produced bytes to output.
+    void write(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+
+    // Compresses all pending data and aligns the stream to a byte boundary with an empty stored block.
+    void flush(std::vector<uint8_t>& output);
+
+    // Compresses all pending data, writes the final block and, for zlib, the Adler-32 trailer.
+    void finish(std::vector<uint8_t>& output);
+
+private:
+
+    void writeHeader();
+
+    void putBits(uint32_t value, uint32_t count);
+    void alignToByte();
+
+    void compress(bool all);
+    void findMatch(uint32_t& length, uint32_t& distance, size_t position, size_t end) const;
+    void insertHash(size_t position);
+    void slideWindow();
+
+    void writeBlock(bool final);
+    void writeStoredBlocks(bool final);
+
+    int32_t level = 6;
+    bool zlibFormat = true;
+    bool headerWritten = false;
+    uint32_t adler = 1;
+
+    std::vector<uint8_t>* output = nullptr;
+    uint64_t bitBuffer = 0;
+    uint32_t bitCount = 0;
+
+    // History of the last 32 KiB plus the data, which is not yet compressed. bufferStart is the stream offset of the first byte.
+    std::vector<uint8_t> buffer;
+    size_t bufferStart = 0;
+    size_t position = 0;
+
+    std::vector<int64_t> hashHead;
+    std::vector<int64_t> hashPrevious;
+
+    std::vector<uint32_t> tokens;
+
+    bool hasPendingMatch = false;
+    uint32_t pendingLength = 0;
+    uint32_t pendingDistance = 0;
+};
+
+// Streaming zlib and raw deflate decompressor, which pulls the compressed data from readFunction.
+class Inflater {
+public:
+
+    // Returns the number of bytes copied into data or zero at the end of the input.
+    using ReadFunction = std::function<size_t(uint8_t* data, size_t size)>;
+
+    Inflater(ReadFunction readFunction, bool zlibFormat = true);
+
+    // Decompresses exactly size bytes. Fails on corrupt data or if the stream ends early.
+    bool read(uint8_t* data, size_t size);
+
+    bool isFinished() const
+    {
+        return state == STATE_DONE;
+    }
+
+private:
+
+    struct Huffman {
+        uint16_t fast[1 << 9];
+        uint16_t firstCode[16];
+        uint32_t maxCode[17];
+        uint16_t firstSymbol[16];
+        uint8_t size[288];
+        uint16_t value[288];
+    };
+
+    enum State {
+        STATE_HEADER,
+        STATE_BLOCK,
+        STATE_STORED,
+        STATE_HUFFMAN,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    bool refill();
+    bool getBits(uint32_t& value, uint32_t count);
+    bool decodeSymbol(uint32_t& symbol, const Huffman& huffman);
+
+    static bool buildHuffman(Huffman& huffman, const uint8_t* sizes, uint32_t count);
+
+    bool readBlockHeader();
+    bool readDynamicTables();
+
+    void putByte(uint8_t value)
+    {
+        window[windowPosition & (WINDOW_SIZE - 1)] = value;
+        windowPosition++;
+    }
+
+    static const uint32_t WINDOW_SIZE = 32768;
+
+    ReadFunction readFunction;
+    bool zlibFormat = true;
+
+    std::vector<uint8_t> input;
+    size_t inputPosition = 0;
+    size_t inputEnd = 0;
+    bool inputEnded = false;
+    uint32_t paddingBits = 0;
+
+    uint64_t bitBuffer = 0;
+    uint32_t bitCount = 0;
+
+    State state = STATE_HEADER;
+    bool finalBlock = false;
+    uint32_t storedRemaining = 0;
+    uint32_t copyLength = 0;
+    uint32_t copyDistance = 0;
+
+    std::vector<uint8_t> window;
+    uint64_t windowPosition = 0;
+
+    Huffman literalHuffman;
+    Huffman distanceHuffman;
+};
+
+#endif /* DEFLATE_H_ */
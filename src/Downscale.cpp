@@ -0,0 +1,164 @@
+#include "Downscale.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Simd.h"
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#if defined(SIMD_X86)
+
+// Each window are four source pixels of both rows: The shuffle moves the even pixels to the lower and the odd pixels to the upper half,
+// so the four samples of the two destination pixels are summed with 16 bit lanes.
+
+SIMD_TARGET("ssse3")
+uint32_t downscaleSsse3(uint8_t* destination, const uint8_t* source0, const uint8_t* source1, uint32_t sourceWidth, uint32_t channels)
+{
+    // Two pixels of at most four channels fit into the eight bytes of each half, other pixels are left to the scalar loop
+    if (channels == 0 || channels > 4) {
+        return 0;
+    }
+
+    uint8_t mask[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        mask[i] = 0x80;
+    }
+    for (uint32_t k = 0; k < 2; k++) {
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            mask[k * channels + channel] = static_cast<uint8_t>(2 * k * channels + channel);
+            mask[8 + k * channels + channel] = static_cast<uint8_t>((2 * k + 1) * channels + channel);
+        }
+    }
+
+    const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+
+    uint32_t destinationWidth = sourceWidth / 2;
+
+    uint32_t x = 0;
+    for (; 2 * x * channels + 16 <= sourceWidth * channels && x * channels + 8 <= destinationWidth * channels; x += 2) {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source0 + 2 * x * channels)), shuffle);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source1 + 2 * x * channels)), shuffle);
+
+        __m128i sum = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero));
+        sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero)));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+
+        // The bytes after the two pixels are written again by the next window or the scalar loop
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + x * channels), _mm_packus_epi16(sum, sum));
+    }
+
+    return x;
+}
+
+#endif
+
+uint8_t encodeNormal(float value)
+{
+    return static_cast<uint8_t>(std::min(std::max((value * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f), 255.0f));
+}
+
+}
+
+void downscaleRow(uint8_t* destination, const uint8_t* source0, const uint8_t* source1, uint32_t sourceWidth, uint32_t channels)
+{
+    uint32_t destinationWidth = std::max(sourceWidth / 2, 1u);
+
+    uint32_t begin = 0;
+
+#if defined(SIMD_X86)
+    if (getSimdLevel() >= SIMD_LEVEL_SSSE3 && channels >= 1 && channels <= 4) {
+        begin = downscaleSsse3(destination, source0, source1, sourceWidth, channels);
+    }
+#endif
+
+    for (uint32_t x = begin; x < destinationWidth; x++) {
+        const uint32_t x0 = 2 * x * channels;
+        const uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1) * channels;
+
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            uint32_t sum = source0[x0 + channel] + source0[x1 + channel] + source1[x0 + channel] + source1[x1 + channel];
+
+            destination[x * channels + channel] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+    }
+}
+
+void downscaleNormalRow(uint8_t* destination, const uint8_t* source0, const uint8_t* source1, uint32_t sourceWidth, uint32_t channels)
+{
+    // Channels after the vector are filtered like any other image
+    downscaleRow(destination, source0, source1, sourceWidth, channels);
+
+    if (channels < 3) {
+        return;
+    }
+
+    uint32_t destinationWidth = std::max(sourceWidth / 2, 1u);
+
+    for (uint32_t x = 0; x < destinationWidth; x++) {
+        const uint32_t x0 = 2 * x * channels;
+        const uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1) * channels;
+
+        float vector[3];
+        for (uint32_t channel = 0; channel < 3; channel++) {
+            uint32_t sum = source0[x0 + channel] + source0[x1 + channel] + source1[x0 + channel] + source1[x1 + channel];
+
+            vector[channel] = static_cast<float>(sum) / (4.0f * 127.5f) - 1.0f;
+        }
+
+        float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+
+        // Opposing vectors cancel out up to the quantization, so the surface is assumed to be flat
+        if (length < 1.0f / 64.0f) {
+            vector[0] = 0.0f;
+            vector[1] = 0.0f;
+            vector[2] = 1.0f;
+            length = 1.0f;
+        }
+
+        for (uint32_t channel = 0; channel < 3; channel++) {
+            destination[x * channels + channel] = encodeNormal(vector[channel] / length);
+        }
+    }
+}
+
+bool downscaleImage(ImageDataResource& destination, const ImageDataResource& source, bool normal, BufferPool* bufferPool)
+{
+    if (source.width == 0 || source.height == 0 || source.channels < 1 || source.channels > 4) {
+        return false;
+    }
+
+    size_t sourceRowBytes = static_cast<size_t>(source.width) * source.channels;
+    if (source.pixels.size() < sourceRowBytes * source.height) {
+        return false;
+    }
+
+    destination.width = std::max(source.width / 2, 1u);
+    destination.height = std::max(source.height / 2, 1u);
+    destination.channels = source.channels;
+
+    size_t destinationRowBytes = static_cast<size_t>(destination.width) * destination.channels;
+    if (!destination.pixels.allocate(destinationRowBytes * destination.height, bufferPool)) {
+        return false;
+    }
+
+    for (uint32_t y = 0; y < destination.height; y++) {
+        const uint8_t* source0 = source.pixels.data() + static_cast<size_t>(2 * y) * sourceRowBytes;
+        const uint8_t* source1 = source.pixels.data() + static_cast<size_t>(std::min(2 * y + 1, source.height - 1)) * sourceRowBytes;
+        uint8_t* row = destination.pixels.data() + static_cast<size_t>(y) * destinationRowBytes;
+
+        if (normal) {
+            downscaleNormalRow(row, source0, source1, source.width, source.channels);
+        } else {
+            downscaleRow(row, source0, source1, source.width, source.channels);
+        }
+    }
+
+    return true;
+}
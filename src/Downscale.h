@@ -0,0 +1,20 @@
+#ifndef DOWNSCALE_H_
+#define DOWNSCALE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Helper.h"
+#include "PixelBuffer.h"
+
+// Halves two source rows of sourceWidth pixels into one row with a 2x2 box filter. An odd last column is dropped,
+// a single column is averaged with itself.
+void downscaleRow(uint8_t* destination, const uint8_t* source0, const uint8_t* source1, uint32_t sourceWidth, uint32_t channels);
+
+// Same as downscaleRow for normal vectors: The four vectors are averaged and renormalized.
+void downscaleNormalRow(uint8_t* destination, const uint8_t* source0, const uint8_t* source1, uint32_t sourceWidth, uint32_t channels);
+
+// Halves the image with a 2x2 box filter, a side of one pixel stays one pixel. Normal images are renormalized.
+bool downscaleImage(ImageDataResource& destination, const ImageDataResource& source, bool normal, BufferPool* bufferPool = nullptr);
+
+#endif /* DOWNSCALE_H_ */
@@ -0,0 +1,203 @@
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t PRIME_3 = 0x165667B19E3779F9ull;
+const uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t PRIME_5 = 0x27D4EB2F165667C5ull;
+
+const size_t FILE_BLOCK_SIZE = 1 << 20;
+
+inline uint64_t rotateLeft(uint64_t value, uint32_t count)
+{
+    return (value << count) | (value >> (64 - count));
+}
+
+// The hash is defined on little endian values
+inline uint64_t readLittleEndian64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    }
+
+    return value;
+}
+
+inline uint32_t readLittleEndian32(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline uint64_t accumulateLane(uint64_t lane, uint64_t input)
+{
+    lane += input * PRIME_2;
+    lane = rotateLeft(lane, 31);
+
+    return lane * PRIME_1;
+}
+
+inline uint64_t mergeRound(uint64_t hash, uint64_t lane)
+{
+    hash ^= accumulateLane(0, lane);
+
+    return hash * PRIME_1 + PRIME_4;
+}
+
+inline void processStripe(uint64_t* lanes, const uint8_t* data)
+{
+    lanes[0] = accumulateLane(lanes[0], readLittleEndian64(data));
+    lanes[1] = accumulateLane(lanes[1], readLittleEndian64(data + 8));
+    lanes[2] = accumulateLane(lanes[2], readLittleEndian64(data + 16));
+    lanes[3] = accumulateLane(lanes[3], readLittleEndian64(data + 24));
+}
+
+}
+
+Hasher::Hasher(uint64_t seed) :
+    seed(seed)
+{
+    lanes[0] = seed + PRIME_1 + PRIME_2;
+    lanes[1] = seed + PRIME_2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME_1;
+}
+
+void Hasher::update(const void* data, size_t size)
+{
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+
+    totalSize += size;
+
+    if (stripeSize > 0) {
+        size_t count = std::min(size, sizeof(stripe) - stripeSize);
+        memcpy(stripe + stripeSize, input, count);
+        stripeSize += count;
+        input += count;
+        size -= count;
+
+        if (stripeSize < sizeof(stripe)) {
+            return;
+        }
+
+        processStripe(lanes, stripe);
+        stripeSize = 0;
+    }
+
+    while (size >= sizeof(stripe)) {
+        processStripe(lanes, input);
+        input += sizeof(stripe);
+        size -= sizeof(stripe);
+    }
+
+    if (size > 0) {
+        memcpy(stripe, input, size);
+        stripeSize = size;
+    }
+}
+
+void Hasher::update(uint64_t value)
+{
+    uint8_t data[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        data[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+
+    update(data, 8);
+}
+
+void Hasher::update(const std::string& value)
+{
+    // The length separates consecutive strings
+    update(static_cast<uint64_t>(value.size()));
+    update(value.data(), value.size());
+}
+
+uint64_t Hasher::finish() const
+{
+    uint64_t hash = 0;
+
+    if (totalSize >= sizeof(stripe)) {
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+
+        for (uint32_t i = 0; i < 4; i++) {
+            hash = mergeRound(hash, lanes[i]);
+        }
+    } else {
+        hash = seed + PRIME_5;
+    }
+
+    hash += totalSize;
+
+    size_t offset = 0;
+
+    while (offset + 8 <= stripeSize) {
+        hash ^= accumulateLane(0, readLittleEndian64(stripe + offset));
+        hash = rotateLeft(hash, 27) * PRIME_1 + PRIME_4;
+        offset += 8;
+    }
+
+    if (offset + 4 <= stripeSize) {
+        hash ^= static_cast<uint64_t>(readLittleEndian32(stripe + offset)) * PRIME_1;
+        hash = rotateLeft(hash, 23) * PRIME_2 + PRIME_3;
+        offset += 4;
+    }
+
+    while (offset < stripeSize) {
+        hash ^= static_cast<uint64_t>(stripe[offset]) * PRIME_5;
+        hash = rotateLeft(hash, 11) * PRIME_1;
+        offset++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+//
+
+uint64_t hashData(const void* data, size_t size, uint64_t seed)
+{
+    Hasher hasher(seed);
+    hasher.update(data, size);
+
+    return hasher.finish();
+}
+
+bool hashFile(uint64_t& hash, const std::string& filename)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    Hasher hasher;
+    std::vector<uint8_t> block(FILE_BLOCK_SIZE);
+
+    size_t size = 0;
+    while ((size = fread(block.data(), 1, block.size(), file)) > 0) {
+        hasher.update(block.data(), size);
+    }
+
+    bool result = (ferror(file) == 0);
+    fclose(file);
+
+    if (!result) {
+        return false;
+    }
+
+    hash = hasher.finish();
+
+    return true;
+}
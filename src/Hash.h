@@ -0,0 +1,38 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Incremental 64 bit XXH64 hash. Data can be passed in pieces of any size, the result is the same as for one piece.
+class Hasher {
+public:
+
+    explicit Hasher(uint64_t seed = 0);
+
+    void update(const void* data, size_t size);
+
+    void update(uint64_t value);
+
+    void update(const std::string& value);
+
+    uint64_t finish() const;
+
+private:
+
+    uint64_t seed = 0;
+    uint64_t lanes[4] = {};
+
+    uint8_t stripe[32] = {};
+    size_t stripeSize = 0;
+
+    uint64_t totalSize = 0;
+};
+
+uint64_t hashData(const void* data, size_t size, uint64_t seed = 0);
+
+// Hashes the content of a file without loading it at once.
+bool hashFile(uint64_t& hash, const std::string& filename);
+
+#endif /* HASH_H_ */
@@ -0,0 +1,422 @@
+#include "Helper.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+float clampf(float x, float minVal, float maxVal)
+{
+    float t = (x > minVal) ? x : minVal;
+
+    return (t < maxVal) ? t : maxVal;
+}
+
+std::string toLowercase(const std::string& input)
+{
+    std::string result = input;
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+}
+
+bool parseByteCount(uint64_t& byteCount, const std::string& input)
+{
+    size_t index = 0;
+    uint64_t value = 0;
+    while (index < input.size() && input[index] >= '0' && input[index] <= '9') {
+        if (value > (UINT64_MAX - 9) / 10) {
+            return false;
+        }
+
+        value = value * 10 + static_cast<uint64_t>(input[index] - '0');
+        index++;
+    }
+
+    if (index == 0) {
+        return false;
+    }
+
+    uint32_t shift = 0;
+    std::string suffix = toLowercase(input.substr(index));
+    if (suffix == "k" || suffix == "kb" || suffix == "kib") {
+        shift = 10;
+    } else if (suffix == "m" || suffix == "mb" || suffix == "mib") {
+        shift = 20;
+    } else if (suffix == "g" || suffix == "gb" || suffix == "gib") {
+        shift = 30;
+    } else if (suffix == "t" || suffix == "tb" || suffix == "tib") {
+        shift = 40;
+    } else if (!suffix.empty() && suffix != "b") {
+        return false;
+    }
+
+    if (value > (UINT64_MAX >> shift)) {
+        return false;
+    }
+
+    byteCount = value << shift;
+
+    return true;
+}
+
+void decomposePath(DecomposedPath& decomposedPath, const std::string& path)
+{
+    fs::path filesystemPath(path);
+
+    decomposedPath.parentPath = filesystemPath.parent_path().generic_string();
+    decomposedPath.stem = filesystemPath.stem().generic_string();
+    decomposedPath.extension = filesystemPath.extension().generic_string();
+}
+
+bool loadImageInfo(ImageDataResource& imageInfo, const std::string& filename)
+{
+    int x = 0;
+    int y = 0;
+    int comp = 0;
+
+    if (!stbi_info(filename.c_str(), &x, &y, &comp)) {
+        return false;
+    }
+
+    imageInfo.width = static_cast<uint32_t>(x);
+    imageInfo.height = static_cast<uint32_t>(y);
+    imageInfo.channels = static_cast<uint32_t>(comp);
+    imageInfo.pixels.release();
+
+    return true;
+}
+
+bool loadImage(ImageDataResource& imageDataResource, const std::string& filename, uint32_t desiredChannels)
+{
+    int x = 0;
+    int y = 0;
+    int comp = 0;
+    int req_comp = static_cast<int>(desiredChannels);
+
+    uint8_t* tempData = static_cast<uint8_t*>(stbi_load(filename.c_str(), &x, &y, &comp, req_comp));
+    if (!tempData) {
+        return false;
+    }
+
+    if (req_comp != 0) {
+        comp = req_comp;
+    }
+
+    imageDataResource.width = static_cast<uint32_t>(x);
+    imageDataResource.height = static_cast<uint32_t>(y);
+    imageDataResource.channels = static_cast<uint32_t>(comp);
+    imageDataResource.pixels.adopt(tempData, static_cast<size_t>(imageDataResource.width) * static_cast<size_t>(imageDataResource.height) * static_cast<size_t>(imageDataResource.channels), stbi_image_free);
+
+    return true;
+}
+
+bool loadImageInfo(ImageDataResource& imageInfo, const uint8_t* data, size_t size)
+{
+    int x = 0;
+    int y = 0;
+    int comp = 0;
+
+    if (size > static_cast<size_t>(INT_MAX) || !stbi_info_from_memory(data, static_cast<int>(size), &x, &y, &comp)) {
+        return false;
+    }
+
+    imageInfo.width = static_cast<uint32_t>(x);
+    imageInfo.height = static_cast<uint32_t>(y);
+    imageInfo.channels = static_cast<uint32_t>(comp);
+    imageInfo.pixels.release();
+
+    return true;
+}
+
+bool loadImage(ImageDataResource& imageDataResource, const uint8_t* data, size_t size, uint32_t desiredChannels)
+{
+    int x = 0;
+    int y = 0;
+    int comp = 0;
+    int req_comp = static_cast<int>(desiredChannels);
+
+    if (size > static_cast<size_t>(INT_MAX)) {
+        return false;
+    }
+
+    uint8_t* tempData = static_cast<uint8_t*>(stbi_load_from_memory(data, static_cast<int>(size), &x, &y, &comp, req_comp));
+    if (!tempData) {
+        return false;
+    }
+
+    if (req_comp != 0) {
+        comp = req_comp;
+    }
+
+    imageDataResource.width = static_cast<uint32_t>(x);
+    imageDataResource.height = static_cast<uint32_t>(y);
+    imageDataResource.channels = static_cast<uint32_t>(comp);
+    imageDataResource.pixels.adopt(tempData, static_cast<size_t>(imageDataResource.width) * static_cast<size_t>(imageDataResource.height) * static_cast<size_t>(imageDataResource.channels), stbi_image_free);
+
+    return true;
+}
+
+bool loadFile(std::string& output, const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    output.resize(fileSize);
+
+    file.read(output.data(), fileSize);
+    file.close();
+
+    return true;
+}
+
+bool loadFile(std::vector<uint8_t>& output, const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    output.resize(fileSize);
+
+    file.read(reinterpret_cast<char*>(output.data()), fileSize);
+    file.close();
+
+    return true;
+}
+
+bool saveFile(const std::string& output, const std::string& filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file.write(output.data(), output.size());
+    file.close();
+
+    return true;
+}
+
+size_t getEncodedSize(const EncodedData& encodedData)
+{
+    size_t size = 0;
+    for (const std::vector<uint8_t>& part : encodedData.parts) {
+        size += part.size();
+    }
+
+    return size;
+}
+
+void appendSegments(std::vector<DataSegment>& segments, const EncodedData& encodedData)
+{
+    for (const std::vector<uint8_t>& part : encodedData.parts) {
+        if (!part.empty()) {
+            segments.push_back({ part.data(), part.size() });
+        }
+    }
+}
+
+bool writeSegments(const std::vector<DataSegment>& segments, int32_t fileDescriptor)
+{
+#ifdef _WIN32
+    for (const DataSegment& segment : segments) {
+        size_t written = 0;
+        while (written < segment.size) {
+            unsigned int count = static_cast<unsigned int>(std::min(segment.size - written, static_cast<size_t>(1) << 30));
+            int result = _write(fileDescriptor, segment.data + written, count);
+            if (result <= 0) {
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+    }
+
+    return true;
+#else
+    // Partial writes continue inside the first segment, which was not completely written
+    size_t index = 0;
+    size_t offset = 0;
+
+    while (index < segments.size()) {
+        std::vector<struct iovec> vectors;
+        for (size_t i = index; i < segments.size() && vectors.size() < static_cast<size_t>(IOV_MAX); i++) {
+            size_t skip = (i == index) ? offset : 0;
+
+            struct iovec vector;
+            vector.iov_base = const_cast<uint8_t*>(segments[i].data + skip);
+            vector.iov_len = segments[i].size - skip;
+            vectors.push_back(vector);
+        }
+
+        ssize_t result = writev(fileDescriptor, vectors.data(), static_cast<int>(vectors.size()));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        size_t written = static_cast<size_t>(result);
+        while (index < segments.size() && written >= segments[index].size - offset) {
+            written -= segments[index].size - offset;
+            index++;
+            offset = 0;
+        }
+        offset += written;
+    }
+
+    return true;
+#endif
+}
+
+bool saveSegments(const std::vector<DataSegment>& segments, const std::string& filename)
+{
+#ifdef _WIN32
+    int fileDescriptor = _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fileDescriptor = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    bool result = writeSegments(segments, fileDescriptor);
+
+#ifdef _WIN32
+    result = (_close(fileDescriptor) == 0) && result;
+#else
+    result = (close(fileDescriptor) == 0) && result;
+#endif
+
+    return result;
+}
+
+#ifdef __linux__
+namespace {
+
+// Copies the remaining bytes of the source in the kernel. Sharing the blocks is tried first, then copy_file_range and sendfile.
+bool copyFileDescriptor(int sourceDescriptor, int fileDescriptor, off_t size)
+{
+#ifdef FICLONE
+    if (ioctl(fileDescriptor, FICLONE, sourceDescriptor) == 0) {
+        return true;
+    }
+#endif
+
+    off_t remaining = size;
+    while (remaining > 0) {
+        ssize_t copied = copy_file_range(sourceDescriptor, nullptr, fileDescriptor, nullptr, static_cast<size_t>(remaining), 0);
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            break;
+        }
+        remaining -= copied;
+    }
+
+    // Older kernels and some file systems do not copy between different file systems, so the offsets continue with sendfile
+    while (remaining > 0) {
+        ssize_t copied = sendfile(fileDescriptor, sourceDescriptor, nullptr, static_cast<size_t>(remaining));
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            return false;
+        }
+        remaining -= copied;
+    }
+
+    return true;
+}
+
+}
+#endif
+
+bool copyFile(const std::string& sourceFilename, const std::string& filename)
+{
+#ifdef __linux__
+    int sourceDescriptor = open(sourceFilename.c_str(), O_RDONLY);
+    if (sourceDescriptor < 0) {
+        return false;
+    }
+
+    struct stat sourceStat;
+    if (fstat(sourceDescriptor, &sourceStat) != 0) {
+        close(sourceDescriptor);
+
+        return false;
+    }
+
+    int fileDescriptor = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) {
+        close(sourceDescriptor);
+
+        return false;
+    }
+
+    bool result = copyFileDescriptor(sourceDescriptor, fileDescriptor, sourceStat.st_size);
+
+    result = (close(fileDescriptor) == 0) && result;
+    close(sourceDescriptor);
+
+    return result;
+#else
+    // The standard library copies with the system, e.g. CopyFile on Windows and fcopyfile on macOS
+    std::error_code errorCode;
+    fs::copy_file(sourceFilename, filename, fs::copy_options::overwrite_existing, errorCode);
+
+    return !errorCode;
+#endif
+}
+
+int32_t redirectStandardOutput()
+{
+    fflush(stdout);
+
+#ifdef _WIN32
+    int fileDescriptor = _dup(_fileno(stdout));
+    if (fileDescriptor < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0) {
+        return -1;
+    }
+    _setmode(fileDescriptor, _O_BINARY);
+#else
+    int fileDescriptor = dup(fileno(stdout));
+    if (fileDescriptor < 0 || dup2(fileno(stderr), fileno(stdout)) < 0) {
+        return -1;
+    }
+#endif
+
+    return fileDescriptor;
+}
@@ -0,0 +1,118 @@
+#ifndef HELPER_H_
+#define HELPER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "PixelBuffer.h"
+
+#ifdef __APPLE__
+#include <Availability.h> // for deployment target to support pre-catalina targets without std::fs
+#endif
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || (defined(__cplusplus) && __cplusplus >= 201703L)) && defined(__has_include)
+#if __has_include(<filesystem>) && (!defined(__MAC_OS_X_VERSION_MIN_REQUIRED) || __MAC_OS_X_VERSION_MIN_REQUIRED >= 101500)
+#define GHC_USE_STD_FS
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+#endif
+#ifndef GHC_USE_STD_FS
+#include <ghc/filesystem.hpp>
+namespace fs = ghc::filesystem;
+#endif
+
+using json = nlohmann::json;
+
+struct DecomposedPath {
+    std::string parentPath = "";
+    std::string stem = "";
+    std::string extension = "";
+};
+
+struct ImageDataResource {
+    PixelBuffer pixels;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+};
+
+enum ImageRole {
+    IMAGE_ROLE_UNKNOWN,
+    IMAGE_ROLE_BASE_COLOR,
+    IMAGE_ROLE_OPACITY,
+    IMAGE_ROLE_METALLIC,
+    IMAGE_ROLE_ROUGHNESS,
+    IMAGE_ROLE_OCCLUSION,
+    IMAGE_ROLE_NORMAL,
+    IMAGE_ROLE_EMISSIVE
+};
+
+// Byte range, which is written together with other ranges without joining them first.
+struct DataSegment {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Encoded file as a list of owned parts e.g. the framing and the compressed blocks of a PNG.
+struct EncodedData {
+    std::vector<std::vector<uint8_t>> parts;
+};
+
+// Image, which was classified by its name and probed by its header, but not yet decoded.
+struct PlannedImage {
+    std::string filename = "";
+    std::string extension = "";
+    ImageRole imageRole = IMAGE_ROLE_UNKNOWN;
+    // Channel, which is read for opacity, metallic, roughness and occlusion.
+    uint32_t sourceChannel = 0;
+    ImageDataResource imageInfo;
+    // Byte data in memory, which is read instead of the file, if set. The file name is only the name of the image then.
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+float clampf(float x, float minVal, float maxVal);
+
+std::string toLowercase(const std::string& input);
+
+// Parses a byte count like 512M or 8G. The suffixes K, M, G and T are binary multiples.
+bool parseByteCount(uint64_t& byteCount, const std::string& input);
+
+void decomposePath(DecomposedPath& decomposedPath, const std::string& path);
+
+// Reads only the image header, so the pixels stay empty.
+bool loadImageInfo(ImageDataResource& imageInfo, const std::string& filename);
+
+// A desired channel count of zero keeps the channels of the image. The decoded memory is adopted without a copy.
+bool loadImage(ImageDataResource& imageDataResource, const std::string& filename, uint32_t desiredChannels = 0);
+
+bool loadImageInfo(ImageDataResource& imageInfo, const uint8_t* data, size_t size);
+
+bool loadImage(ImageDataResource& imageDataResource, const uint8_t* data, size_t size, uint32_t desiredChannels = 0);
+
+bool loadFile(std::string& output, const std::string& filename);
+
+bool loadFile(std::vector<uint8_t>& output, const std::string& filename);
+
+bool saveFile(const std::string& output, const std::string& filename);
+
+size_t getEncodedSize(const EncodedData& encodedData);
+
+void appendSegments(std::vector<DataSegment>& segments, const EncodedData& encodedData);
+
+// Writes all segments with gathering writes, so no joined copy is needed.
+bool writeSegments(const std::vector<DataSegment>& segments, int32_t fileDescriptor);
+
+bool saveSegments(const std::vector<DataSegment>& segments, const std::string& filename);
+
+// Copies a file without reading it into memory: Copy-on-write file systems share the blocks, otherwise the kernel copies the data.
+bool copyFile(const std::string& sourceFilename, const std::string& filename);
+
+// Redirects the standard output to the standard error, so the log does not mix with binary data.
+// Returns a descriptor of the original standard output in binary mode or -1.
+int32_t redirectStandardOutput();
+
+#endif /* HELPER_H_ */
@@ -0,0 +1,248 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+
+#include "Downscale.h"
+#include "PixelBuffer.h"
+#include "ThreadPool.h"
+
+namespace {
+
+const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+const uint32_t VK_FORMAT_BC7_SRGB_BLOCK = 146;
+
+const uint32_t KHR_DF_MODEL_BC7 = 134;
+const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+// Fixed sizes of the header with the index, the basic data format descriptor with one sample and the key value data
+const size_t HEADER_SIZE = 80;
+const size_t LEVEL_INDEX_SIZE = 24;
+const size_t DFD_SIZE = 44;
+const size_t KVD_SIZE = 24;
+
+// Level data is aligned to the block size
+const size_t LEVEL_ALIGNMENT = 16;
+
+// Minimum number of blocks encoded by one task
+const uint32_t TASK_BLOCK_COUNT = 1024;
+
+void appendUint32(std::vector<uint8_t>& output, uint32_t value)
+{
+    for (uint32_t i = 0; i < 4; i++) {
+        output.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+void appendUint64(std::vector<uint8_t>& output, uint64_t value)
+{
+    for (uint32_t i = 0; i < 8; i++) {
+        output.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+// Gathers the 4x4 pixels of a block as RGBA. Pixels outside the image repeat the last row and column.
+void gatherBlock(uint8_t pixels[64], const ImageDataResource& image, uint32_t blockX, uint32_t blockY)
+{
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sourceY = std::min(blockY * 4 + y, image.height - 1);
+
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sourceX = std::min(blockX * 4 + x, image.width - 1);
+
+            const uint8_t* source = image.pixels.data() + (static_cast<size_t>(sourceY) * image.width + sourceX) * image.channels;
+            uint8_t* pixel = pixels + (y * 4 + x) * 4;
+
+            switch (image.channels) {
+                case 1:
+                    pixel[0] = source[0];
+                    pixel[1] = source[0];
+                    pixel[2] = source[0];
+                    pixel[3] = 255;
+                    break;
+                case 2:
+                    pixel[0] = source[0];
+                    pixel[1] = source[0];
+                    pixel[2] = source[0];
+                    pixel[3] = source[1];
+                    break;
+                case 3:
+                    pixel[0] = source[0];
+                    pixel[1] = source[1];
+                    pixel[2] = source[2];
+                    pixel[3] = 255;
+                    break;
+                default:
+                    pixel[0] = source[0];
+                    pixel[1] = source[1];
+                    pixel[2] = source[2];
+                    pixel[3] = source[3];
+                    break;
+            }
+        }
+    }
+}
+
+bool encodeLevel(std::vector<uint8_t>& output, const ImageDataResource& image, Bc7Quality bc7Quality, ThreadPool& threadPool)
+{
+    uint32_t blocksX = (image.width + 3) / 4;
+    uint32_t blocksY = (image.height + 3) / 4;
+
+    output.resize(static_cast<size_t>(blocksX) * blocksY * 16);
+
+    // Tasks consist of whole block rows, so small levels are encoded by one task
+
+    uint32_t taskRows = std::max(TASK_BLOCK_COUNT / blocksX, 1u);
+    uint32_t taskCount = (blocksY + taskRows - 1) / taskRows;
+
+    TaskGroup taskGroup(threadPool);
+
+    for (uint32_t task = 0; task < taskCount; task++) {
+        taskGroup.run([&, task]() {
+            uint8_t pixels[64];
+
+            uint32_t endRow = std::min(blocksY, (task + 1) * taskRows);
+            for (uint32_t blockY = task * taskRows; blockY < endRow; blockY++) {
+                for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+                    gatherBlock(pixels, image, blockX, blockY);
+
+                    encodeBc7Block(output.data() + (static_cast<size_t>(blockY) * blocksX + blockX) * 16, pixels, bc7Quality);
+                }
+            }
+        });
+    }
+
+    taskGroup.wait();
+
+    return true;
+}
+
+}
+
+bool encodeKtx2(EncodedData& encodedData, const ImageDataResource& image, const Ktx2Options& ktx2Options, ThreadPool& threadPool)
+{
+    encodedData.parts.clear();
+
+    if (image.width == 0 || image.height == 0 || image.channels < 1 || image.channels > 4) {
+        return false;
+    }
+
+    if (image.pixels.size() < static_cast<size_t>(image.width) * image.height * image.channels) {
+        return false;
+    }
+
+    uint32_t levelCount = 1;
+    while ((std::max(image.width, image.height) >> levelCount) > 0) {
+        levelCount++;
+    }
+
+    // The levels are stored from the smallest to the largest one, so the parts are filled in reverse
+
+    encodedData.parts.resize(1 + levelCount);
+
+    BufferPool& bufferPool = getImageBufferPool();
+
+    ImageDataResource previousImage;
+    const ImageDataResource* levelImage = &image;
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        if (level > 0) {
+            ImageDataResource downscaledImage;
+            if (!downscaleImage(downscaledImage, *levelImage, ktx2Options.normal, &bufferPool)) {
+                return false;
+            }
+
+            previousImage = std::move(downscaledImage);
+            levelImage = &previousImage;
+        }
+
+        if (!encodeLevel(encodedData.parts[levelCount - level], *levelImage, ktx2Options.bc7Quality, threadPool)) {
+            return false;
+        }
+    }
+
+    //
+
+    std::vector<uint8_t>& header = encodedData.parts[0];
+
+    size_t levelIndexOffset = HEADER_SIZE;
+    size_t dfdOffset = levelIndexOffset + LEVEL_INDEX_SIZE * levelCount;
+    size_t kvdOffset = dfdOffset + DFD_SIZE;
+    size_t levelDataOffset = kvdOffset + KVD_SIZE;
+    levelDataOffset += (LEVEL_ALIGNMENT - levelDataOffset % LEVEL_ALIGNMENT) % LEVEL_ALIGNMENT;
+
+    header.insert(header.end(), KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+    appendUint32(header, ktx2Options.srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK);
+    appendUint32(header, 1);
+    appendUint32(header, image.width);
+    appendUint32(header, image.height);
+    appendUint32(header, 0);
+    appendUint32(header, 0);
+    appendUint32(header, 1);
+    appendUint32(header, levelCount);
+    appendUint32(header, 0);
+
+    appendUint32(header, static_cast<uint32_t>(dfdOffset));
+    appendUint32(header, static_cast<uint32_t>(DFD_SIZE));
+    appendUint32(header, static_cast<uint32_t>(kvdOffset));
+    appendUint32(header, static_cast<uint32_t>(KVD_SIZE));
+    appendUint64(header, 0);
+    appendUint64(header, 0);
+
+    // Level index starts with the largest level
+
+    std::vector<uint64_t> levelOffsets(levelCount);
+    uint64_t offset = levelDataOffset;
+    for (uint32_t level = levelCount; level > 0; level--) {
+        levelOffsets[level - 1] = offset;
+        offset += encodedData.parts[levelCount - level + 1].size();
+    }
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        uint64_t levelSize = encodedData.parts[levelCount - level].size();
+
+        appendUint64(header, levelOffsets[level]);
+        appendUint64(header, levelSize);
+        appendUint64(header, levelSize);
+    }
+
+    // Basic data format descriptor of 4x4 blocks with 16 bytes and one 128 bit sample
+
+    appendUint32(header, static_cast<uint32_t>(DFD_SIZE));
+    appendUint32(header, 0);
+    appendUint32(header, 2 | (static_cast<uint32_t>(DFD_SIZE - 4) << 16));
+    appendUint32(header, KHR_DF_MODEL_BC7 | (KHR_DF_PRIMARIES_BT709 << 8) | ((ktx2Options.srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+    appendUint32(header, 3 | (3 << 8));
+    appendUint32(header, 16);
+    appendUint32(header, 0);
+    appendUint32(header, 127 << 16);
+    appendUint32(header, 0);
+    appendUint32(header, 0);
+    appendUint32(header, 0xFFFFFFFF);
+
+    // One key value pair with the writer
+
+    static const char writer[] = "KTXwriter\0pbr2gltf2";
+    appendUint32(header, sizeof(writer));
+    header.insert(header.end(), writer, writer + sizeof(writer));
+
+    header.resize(levelDataOffset, 0);
+
+    return true;
+}
+
+bool saveKtx2(const std::string& filename, const ImageDataResource& image, const Ktx2Options& ktx2Options, ThreadPool& threadPool)
+{
+    EncodedData encodedData;
+    if (!encodeKtx2(encodedData, image, ktx2Options, threadPool)) {
+        return false;
+    }
+
+    std::vector<DataSegment> segments;
+    appendSegments(segments, encodedData);
+
+    return saveSegments(segments, filename);
+}
@@ -0,0 +1,26 @@
+#ifndef KTX2_H_
+#define KTX2_H_
+
+#include <cstdint>
+#include <string>
+
+#include "Bc7.h"
+#include "Helper.h"
+
+class ThreadPool;
+
+struct Ktx2Options {
+    Bc7Quality bc7Quality = BC7_QUALITY_NORMAL;
+    // Color data is tagged as sRGB, other data as linear.
+    bool srgb = true;
+    // Normal vectors are renormalized, when the mip levels are downscaled.
+    bool normal = false;
+};
+
+// Encodes an image with 1 to 4 channels as KTX2 with BC7 blocks and the full mip chain down to 1x1. The blocks of each level are
+// encoded in parallel on the thread pool. The header and every level stay separate parts of the encoded data.
+bool encodeKtx2(EncodedData& encodedData, const ImageDataResource& image, const Ktx2Options& ktx2Options, ThreadPool& threadPool);
+
+bool saveKtx2(const std::string& filename, const ImageDataResource& image, const Ktx2Options& ktx2Options, ThreadPool& threadPool);
+
+#endif /* KTX2_H_ */
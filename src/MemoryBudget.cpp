@@ -0,0 +1,52 @@
+#include "MemoryBudget.h"
+
+#include <algorithm>
+
+#include "PixelBuffer.h"
+
+MemoryBudget::MemoryBudget(uint64_t byteCount, BufferPool* bufferPool) :
+    byteCount(byteCount),
+    bufferPool(bufferPool)
+{
+}
+
+uint64_t MemoryBudget::getByteCount() const
+{
+    return byteCount;
+}
+
+void MemoryBudget::reserve(uint64_t estimate)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Memory is tight, so the running jobs get the cached buffers back from the system instead of the cache
+    if (bufferPool && runningCount > 0 && reservedCount + estimate > byteCount) {
+        lock.unlock();
+        bufferPool->trim();
+        lock.lock();
+    }
+
+    releaseCondition.wait(lock, [this, estimate] { return runningCount == 0 || reservedCount + estimate <= byteCount; });
+
+    reservedCount += estimate;
+    runningCount++;
+
+    peakReserved = std::max(peakReserved, reservedCount);
+}
+
+void MemoryBudget::release(uint64_t estimate)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reservedCount -= estimate;
+        runningCount--;
+    }
+    releaseCondition.notify_all();
+}
+
+uint64_t MemoryBudget::getPeakReserved() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return peakReserved;
+}
@@ -0,0 +1,45 @@
+#ifndef MEMORYBUDGET_H_
+#define MEMORYBUDGET_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+class BufferPool;
+
+// Admits jobs by the estimate of their peak working set, so the estimates of the running jobs stay within the budget.
+// One thread reserves for the jobs in their order, so a large job is waited for instead of being overtaken by smaller ones.
+// In server mode, the reader of each connection reserves for the jobs of that connection.
+// The jobs release their reservation on other threads, but never wait for the budget themselves.
+class MemoryBudget {
+public:
+
+    // The cached buffers of the pool, if given, are freed, before a job waits for the budget.
+    explicit MemoryBudget(uint64_t byteCount, BufferPool* bufferPool = nullptr);
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    uint64_t getByteCount() const;
+
+    // Blocks until the estimate fits next to the running jobs. A job larger than the budget waits until no other job runs.
+    void reserve(uint64_t estimate);
+
+    void release(uint64_t estimate);
+
+    // Largest sum of the estimates of jobs, which ran at once.
+    uint64_t getPeakReserved() const;
+
+private:
+
+    uint64_t byteCount = 0;
+    BufferPool* bufferPool = nullptr;
+
+    mutable std::mutex mutex;
+    std::condition_variable releaseCondition;
+    uint64_t reservedCount = 0;
+    size_t runningCount = 0;
+    uint64_t peakReserved = 0;
+};
+
+#endif /* MEMORYBUDGET_H_ */
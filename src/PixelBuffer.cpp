@@ -0,0 +1,201 @@
+#include "PixelBuffer.h"
+
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+// Enough to keep the outputs of a few 8K materials around between conversions.
+const size_t DEFAULT_MAXIMUM_CACHED_BYTES = 1024 * 1024 * 1024;
+
+}
+
+BufferPool::BufferPool(size_t maximumCachedBytes) :
+    maximumCachedBytes(maximumCachedBytes)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    trim();
+}
+
+uint8_t* BufferPool::acquire(size_t size, size_t& capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Best fit, but do not waste more than half of a cached buffer
+        auto it = freeBuffers.lower_bound(size);
+        if (it != freeBuffers.end() && it->first / 2 <= size) {
+            uint8_t* buffer = it->second;
+            capacity = it->first;
+
+            cachedBytes -= it->first;
+            freeBuffers.erase(it);
+
+            return buffer;
+        }
+    }
+
+    capacity = size;
+
+    return static_cast<uint8_t*>(malloc(size));
+}
+
+void BufferPool::release(uint8_t* buffer, size_t capacity)
+{
+    if (!buffer) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    evict(capacity);
+
+    if (cachedBytes + capacity > maximumCachedBytes) {
+        free(buffer);
+
+        return;
+    }
+
+    freeBuffers.emplace(capacity, buffer);
+    cachedBytes += capacity;
+}
+
+void BufferPool::trim()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& freeBuffer : freeBuffers) {
+        free(freeBuffer.second);
+    }
+    freeBuffers.clear();
+    cachedBytes = 0;
+}
+
+size_t BufferPool::getMaximumCachedBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return maximumCachedBytes;
+}
+
+void BufferPool::setMaximumCachedBytes(size_t maximumCachedBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->maximumCachedBytes = maximumCachedBytes;
+
+    evict(0);
+}
+
+// Makes room for a buffer of the capacity. The smallest buffers are evicted first, as the large ones are the expensive ones to fault in again.
+void BufferPool::evict(size_t capacity)
+{
+    while (!freeBuffers.empty() && cachedBytes + capacity > maximumCachedBytes) {
+        auto it = freeBuffers.begin();
+        if (capacity > 0 && it->first > capacity) {
+            break;
+        }
+
+        cachedBytes -= it->first;
+        free(it->second);
+        freeBuffers.erase(it);
+    }
+}
+
+BufferPool& getImageBufferPool()
+{
+    static BufferPool bufferPool(DEFAULT_MAXIMUM_CACHED_BYTES);
+
+    return bufferPool;
+}
+
+//
+
+PixelBuffer::~PixelBuffer()
+{
+    release();
+}
+
+PixelBuffer::PixelBuffer(PixelBuffer&& other) noexcept :
+    buffer(std::exchange(other.buffer, nullptr)),
+    bufferSize(std::exchange(other.bufferSize, 0)),
+    bufferCapacity(std::exchange(other.bufferCapacity, 0)),
+    freeFunction(std::exchange(other.freeFunction, nullptr)),
+    bufferPool(std::exchange(other.bufferPool, nullptr))
+{
+}
+
+PixelBuffer& PixelBuffer::operator=(PixelBuffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+
+        buffer = std::exchange(other.buffer, nullptr);
+        bufferSize = std::exchange(other.bufferSize, 0);
+        bufferCapacity = std::exchange(other.bufferCapacity, 0);
+        freeFunction = std::exchange(other.freeFunction, nullptr);
+        bufferPool = std::exchange(other.bufferPool, nullptr);
+    }
+
+    return *this;
+}
+
+void PixelBuffer::adopt(uint8_t* data, size_t size, FreeFunction freeFunction)
+{
+    release();
+
+    this->buffer = data;
+    this->bufferSize = size;
+    this->bufferCapacity = size;
+    this->freeFunction = freeFunction;
+}
+
+bool PixelBuffer::allocate(size_t size, BufferPool* bufferPool)
+{
+    release();
+
+    if (size == 0) {
+        return true;
+    }
+
+    if (bufferPool) {
+        buffer = bufferPool->acquire(size, bufferCapacity);
+        if (!buffer) {
+            return false;
+        }
+
+        this->bufferPool = bufferPool;
+    } else {
+        buffer = static_cast<uint8_t*>(malloc(size));
+        if (!buffer) {
+            return false;
+        }
+
+        bufferCapacity = size;
+        freeFunction = free;
+    }
+
+    bufferSize = size;
+
+    return true;
+}
+
+void PixelBuffer::release()
+{
+    if (buffer) {
+        if (bufferPool) {
+            bufferPool->release(buffer, bufferCapacity);
+        } else if (freeFunction) {
+            freeFunction(buffer);
+        }
+    }
+
+    buffer = nullptr;
+    bufferSize = 0;
+    bufferCapacity = 0;
+    freeFunction = nullptr;
+    bufferPool = nullptr;
+}
@@ -0,0 +1,98 @@
+#ifndef PIXELBUFFER_H_
+#define PIXELBUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+// Thread safe cache of freed buffers, so large images of consecutive materials reuse their memory.
+class BufferPool {
+public:
+
+    explicit BufferPool(size_t maximumCachedBytes);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Returns a buffer of at least size bytes and its capacity.
+    uint8_t* acquire(size_t size, size_t& capacity);
+
+    void release(uint8_t* buffer, size_t capacity);
+
+    // Frees all cached buffers, e.g. while nothing is converted.
+    void trim();
+
+    size_t getMaximumCachedBytes();
+
+    // Evicts the smallest cached buffers, until the rest fits.
+    void setMaximumCachedBytes(size_t maximumCachedBytes);
+
+private:
+
+    void evict(size_t capacity);
+
+    std::mutex mutex;
+    std::multimap<size_t, uint8_t*> freeBuffers;
+    size_t cachedBytes = 0;
+    size_t maximumCachedBytes = 0;
+};
+
+// Process wide pool for the packed output images.
+BufferPool& getImageBufferPool();
+
+// Move only memory of an image. It is either adopted from the decoder, allocated on the heap or borrowed from a buffer pool.
+class PixelBuffer {
+public:
+
+    using FreeFunction = void (*)(void*);
+
+    PixelBuffer() = default;
+    ~PixelBuffer();
+
+    PixelBuffer(PixelBuffer&& other) noexcept;
+    PixelBuffer& operator=(PixelBuffer&& other) noexcept;
+
+    PixelBuffer(const PixelBuffer&) = delete;
+    PixelBuffer& operator=(const PixelBuffer&) = delete;
+
+    // Takes ownership of the memory e.g. returned by stbi_load, which is later freed with freeFunction.
+    void adopt(uint8_t* data, size_t size, FreeFunction freeFunction);
+
+    // Allocates from the buffer pool or, if it is null, from the heap. The content is undefined.
+    bool allocate(size_t size, BufferPool* bufferPool = nullptr);
+
+    void release();
+
+    uint8_t* data()
+    {
+        return buffer;
+    }
+
+    const uint8_t* data() const
+    {
+        return buffer;
+    }
+
+    size_t size() const
+    {
+        return bufferSize;
+    }
+
+    bool empty() const
+    {
+        return bufferSize == 0;
+    }
+
+private:
+
+    uint8_t* buffer = nullptr;
+    size_t bufferSize = 0;
+    size_t bufferCapacity = 0;
+
+    FreeFunction freeFunction = nullptr;
+    BufferPool* bufferPool = nullptr;
+};
+
+#endif /* PIXELBUFFER_H_ */
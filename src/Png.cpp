@@ -0,0 +1,785 @@
+#include "Png.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <stb_image_write.h>
+
+#include "PixelBuffer.h"
+#include "ThreadPool.h"
+
+namespace {
+
+const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+// Compressed image data is written in chunks of this size
+const size_t IMAGE_DATA_CHUNK_SIZE = 64 * 1024;
+
+// Filtered data is compressed in parallel blocks of about this size
+const size_t COMPRESS_BLOCK_SIZE = 256 * 1024;
+
+const size_t DICTIONARY_SIZE = 32 * 1024;
+
+enum PngFilter {
+    PNG_FILTER_NONE,
+    PNG_FILTER_SUB,
+    PNG_FILTER_UP,
+    PNG_FILTER_AVERAGE,
+    PNG_FILTER_PAETH
+};
+
+uint32_t readBigEndian(const uint8_t* data)
+{
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+}
+
+void writeBigEndian(uint8_t* data, uint32_t value)
+{
+    data[0] = static_cast<uint8_t>(value >> 24);
+    data[1] = static_cast<uint8_t>(value >> 16);
+    data[2] = static_cast<uint8_t>(value >> 8);
+    data[3] = static_cast<uint8_t>(value);
+}
+
+void appendChunkHeader(std::vector<uint8_t>& output, const char* type, size_t size)
+{
+    uint8_t header[8];
+    writeBigEndian(header, static_cast<uint32_t>(size));
+    memcpy(header + 4, type, 4);
+
+    output.insert(output.end(), header, header + 8);
+}
+
+void appendChunkTrailer(std::vector<uint8_t>& output, uint32_t crc)
+{
+    uint8_t trailer[4];
+    writeBigEndian(trailer, crc);
+
+    output.insert(output.end(), trailer, trailer + 4);
+}
+
+// The checksum covers the type and the data of a chunk.
+uint32_t getChunkCrc(const char* type, const uint8_t* data, size_t size)
+{
+    uint32_t crc = updateCrc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+
+    return updateCrc32(crc, data, size);
+}
+
+void appendChunk(std::vector<uint8_t>& output, const char* type, const uint8_t* data, size_t size)
+{
+    appendChunkHeader(output, type, size);
+    if (size > 0) {
+        output.insert(output.end(), data, data + size);
+    }
+    appendChunkTrailer(output, getChunkCrc(type, data, size));
+}
+
+void appendHeader(std::vector<uint8_t>& output, uint32_t width, uint32_t height, uint32_t channels)
+{
+    static const uint8_t colorTypes[5] = { 0, 0, 4, 2, 6 };
+
+    uint8_t header[13];
+    writeBigEndian(header, width);
+    writeBigEndian(header + 4, height);
+    header[8] = 8;
+    header[9] = colorTypes[channels];
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    output.insert(output.end(), PNG_SIGNATURE, PNG_SIGNATURE + 8);
+    appendChunk(output, "IHDR", header, 13);
+}
+
+void appendToVector(void* context, void* data, int size)
+{
+    std::vector<uint8_t>* output = static_cast<std::vector<uint8_t>*>(context);
+    output->insert(output->end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+}
+
+uint8_t paethPredictor(int32_t a, int32_t b, int32_t c)
+{
+    int32_t p = a + b - c;
+    int32_t pa = abs(p - a);
+    int32_t pb = abs(p - b);
+    int32_t pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc) {
+        return static_cast<uint8_t>(a);
+    }
+    if (pb <= pc) {
+        return static_cast<uint8_t>(b);
+    }
+
+    return static_cast<uint8_t>(c);
+}
+
+}
+
+void filterRow(uint8_t* output, uint8_t* scratch, const uint8_t* rowData, const uint8_t* previousRowData, size_t rowBytes, uint32_t bytesPerPixel, bool adaptiveFilter)
+{
+    if (!adaptiveFilter) {
+        output[0] = PNG_FILTER_NONE;
+        memcpy(output + 1, rowData, rowBytes);
+
+        return;
+    }
+
+    uint64_t bestSum = UINT64_MAX;
+
+    for (uint32_t filter = PNG_FILTER_NONE; filter <= PNG_FILTER_PAETH; filter++) {
+        scratch[0] = static_cast<uint8_t>(filter);
+        uint8_t* filtered = scratch + 1;
+
+        size_t head = std::min(static_cast<size_t>(bytesPerPixel), rowBytes);
+
+        // The first pixel has no left neighbor, so only the filters using the row above differ
+        switch (filter) {
+            case PNG_FILTER_NONE:
+                memcpy(filtered, rowData, rowBytes);
+                break;
+            case PNG_FILTER_SUB:
+                memcpy(filtered, rowData, head);
+                for (size_t i = head; i < rowBytes; i++) {
+                    filtered[i] = static_cast<uint8_t>(rowData[i] - rowData[i - bytesPerPixel]);
+                }
+                break;
+            case PNG_FILTER_UP:
+                for (size_t i = 0; i < rowBytes; i++) {
+                    filtered[i] = static_cast<uint8_t>(rowData[i] - previousRowData[i]);
+                }
+                break;
+            case PNG_FILTER_AVERAGE:
+                for (size_t i = 0; i < head; i++) {
+                    filtered[i] = static_cast<uint8_t>(rowData[i] - (previousRowData[i] >> 1));
+                }
+                for (size_t i = head; i < rowBytes; i++) {
+                    filtered[i] = static_cast<uint8_t>(rowData[i] - ((rowData[i - bytesPerPixel] + previousRowData[i]) >> 1));
+                }
+                break;
+            default:
+                for (size_t i = 0; i < head; i++) {
+                    filtered[i] = static_cast<uint8_t>(rowData[i] - previousRowData[i]);
+                }
+                for (size_t i = head; i < rowBytes; i++) {
+                    filtered[i] = static_cast<uint8_t>(rowData[i] - paethPredictor(rowData[i - bytesPerPixel], previousRowData[i], previousRowData[i - bytesPerPixel]));
+                }
+                break;
+        }
+
+        // Filtered bytes are interpreted as signed, so small differences in both directions are preferred
+        uint64_t sum = 0;
+        for (size_t i = 0; i < rowBytes; i++) {
+            sum += static_cast<uint64_t>(abs(static_cast<int8_t>(filtered[i])));
+        }
+
+        if (sum < bestSum) {
+            bestSum = sum;
+            memcpy(output, scratch, rowBytes + 1);
+
+            if (sum == 0) {
+                break;
+            }
+        }
+    }
+}
+
+//
+
+PngReader::~PngReader()
+{
+    close();
+}
+
+bool PngReader::readChunkHeader(uint32_t& length, std::string& type)
+{
+    uint8_t header[8];
+    if (fread(header, 1, 8, file) != 8) {
+        return false;
+    }
+
+    length = readBigEndian(header);
+    type.assign(reinterpret_cast<const char*>(header + 4), 4);
+
+    return length <= 0x7FFFFFFF;
+}
+
+bool PngReader::open(const std::string& filename)
+{
+    close();
+
+    file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint8_t signature[8];
+    if (fread(signature, 1, 8, file) != 8 || memcmp(signature, PNG_SIGNATURE, 8) != 0) {
+        close();
+
+        return false;
+    }
+
+    bool hasHeader = false;
+    uint32_t interlace = 0;
+
+    // Chunks are parsed until the first image data chunk
+
+    while (true) {
+        uint32_t length = 0;
+        std::string type;
+        if (!readChunkHeader(length, type)) {
+            close();
+
+            return false;
+        }
+
+        if (type == "IHDR") {
+            uint8_t data[13];
+            if (length != 13 || fread(data, 1, 13, file) != 13) {
+                close();
+
+                return false;
+            }
+
+            width = readBigEndian(data);
+            height = readBigEndian(data + 4);
+            bitDepth = data[8];
+            colorType = data[9];
+            interlace = data[12];
+
+            hasHeader = true;
+        } else if (type == "PLTE") {
+            if (length % 3 != 0 || length > 256 * 3) {
+                close();
+
+                return false;
+            }
+
+            std::vector<uint8_t> data(length);
+            if (fread(data.data(), 1, length, file) != length) {
+                close();
+
+                return false;
+            }
+
+            palette.assign(static_cast<size_t>(length / 3) * 4, 255);
+            for (uint32_t i = 0; i < length / 3; i++) {
+                palette[i * 4 + 0] = data[i * 3 + 0];
+                palette[i * 4 + 1] = data[i * 3 + 1];
+                palette[i * 4 + 2] = data[i * 3 + 2];
+            }
+        } else if (type == "tRNS") {
+            // Color keys of gray and RGB images are left to the full decoder
+            if (colorType != 3 || palette.empty() || length > palette.size() / 4) {
+                close();
+
+                return false;
+            }
+
+            std::vector<uint8_t> data(length);
+            if (fread(data.data(), 1, length, file) != length) {
+                close();
+
+                return false;
+            }
+
+            for (uint32_t i = 0; i < length; i++) {
+                palette[i * 4 + 3] = data[i];
+            }
+            hasTransparency = true;
+        } else if (type == "IDAT") {
+            imageDataRemaining = length;
+
+            break;
+        } else if (type == "IEND") {
+            close();
+
+            return false;
+        } else {
+            if (fseek(file, static_cast<long>(length), SEEK_CUR) != 0) {
+                close();
+
+                return false;
+            }
+        }
+
+        // Checksum
+        if (fseek(file, 4, SEEK_CUR) != 0) {
+            close();
+
+            return false;
+        }
+    }
+
+    //
+
+    bool validBitDepth = false;
+    switch (colorType) {
+        case 0:
+            samples = 1;
+            validBitDepth = (bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16);
+            break;
+        case 2:
+            samples = 3;
+            validBitDepth = (bitDepth == 8 || bitDepth == 16);
+            break;
+        case 3:
+            samples = 1;
+            validBitDepth = (bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8) && !palette.empty();
+            break;
+        case 4:
+            samples = 2;
+            validBitDepth = (bitDepth == 8 || bitDepth == 16);
+            break;
+        case 6:
+            samples = 4;
+            validBitDepth = (bitDepth == 8 || bitDepth == 16);
+            break;
+        default:
+            break;
+    }
+
+    if (!hasHeader || !validBitDepth || interlace != 0 || width == 0 || height == 0) {
+        close();
+
+        return false;
+    }
+
+    channels = (colorType == 3) ? (hasTransparency ? 4 : 3) : samples;
+
+    rowBytes = (static_cast<size_t>(width) * samples * bitDepth + 7) / 8;
+    filterBytes = (samples * bitDepth >= 8) ? (samples * bitDepth / 8) : 1;
+
+    row.assign(rowBytes, 0);
+    previousRow.assign(rowBytes, 0);
+    currentRow = 0;
+
+    inflater.reset(new Inflater([this](uint8_t* data, size_t size) { return readImageData(data, size); }));
+
+    return true;
+}
+
+size_t PngReader::readImageData(uint8_t* data, size_t size)
+{
+    // Image data may be split across several consecutive chunks
+    while (imageDataRemaining == 0) {
+        if (imageDataEnded) {
+            return 0;
+        }
+
+        uint32_t length = 0;
+        std::string type;
+        if (fseek(file, 4, SEEK_CUR) != 0 || !readChunkHeader(length, type) || type != "IDAT") {
+            imageDataEnded = true;
+
+            return 0;
+        }
+
+        imageDataRemaining = length;
+    }
+
+    size_t count = fread(data, 1, std::min(size, static_cast<size_t>(imageDataRemaining)), file);
+    if (count == 0) {
+        imageDataEnded = true;
+    }
+    imageDataRemaining -= static_cast<uint32_t>(count);
+
+    return count;
+}
+
+void PngReader::unfilterRow(uint8_t filter)
+{
+    switch (filter) {
+        case PNG_FILTER_SUB:
+            for (size_t i = filterBytes; i < rowBytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + row[i - filterBytes]);
+            }
+            break;
+        case PNG_FILTER_UP:
+            for (size_t i = 0; i < rowBytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + previousRow[i]);
+            }
+            break;
+        case PNG_FILTER_AVERAGE:
+            for (size_t i = 0; i < rowBytes; i++) {
+                uint32_t a = (i >= filterBytes) ? row[i - filterBytes] : 0;
+                row[i] = static_cast<uint8_t>(row[i] + ((a + previousRow[i]) >> 1));
+            }
+            break;
+        case PNG_FILTER_PAETH:
+            for (size_t i = 0; i < rowBytes; i++) {
+                int32_t a = (i >= filterBytes) ? row[i - filterBytes] : 0;
+                int32_t c = (i >= filterBytes) ? previousRow[i - filterBytes] : 0;
+                row[i] = static_cast<uint8_t>(row[i] + paethPredictor(a, previousRow[i], c));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void PngReader::convertRow(uint8_t* data) const
+{
+    if (bitDepth == 8) {
+        if (colorType == 3) {
+            for (uint32_t x = 0; x < width; x++) {
+                memcpy(data + static_cast<size_t>(x) * channels, &palette[std::min(static_cast<size_t>(row[x]) * 4, palette.size() - 4)], channels);
+            }
+        } else {
+            memcpy(data, row.data(), rowBytes);
+        }
+
+        return;
+    }
+
+    if (bitDepth == 16) {
+        size_t count = static_cast<size_t>(width) * samples;
+        for (size_t i = 0; i < count; i++) {
+            data[i] = row[i * 2];
+        }
+
+        return;
+    }
+
+    // Samples below 8 bit are unpacked from the most significant bit on and gray values are scaled to the full range
+    uint32_t mask = (1u << bitDepth) - 1;
+    uint32_t scale = (bitDepth == 1) ? 0xFF : ((bitDepth == 2) ? 0x55 : 0x11);
+
+    for (uint32_t x = 0; x < width; x++) {
+        size_t bit = static_cast<size_t>(x) * bitDepth;
+        uint32_t value = (row[bit / 8] >> (8 - bitDepth - (bit % 8))) & mask;
+
+        if (colorType == 3) {
+            memcpy(data + static_cast<size_t>(x) * channels, &palette[std::min(static_cast<size_t>(value) * 4, palette.size() - 4)], channels);
+        } else {
+            data[x] = static_cast<uint8_t>(value * scale);
+        }
+    }
+}
+
+bool PngReader::readRows(uint8_t* data, uint32_t rowCount)
+{
+    if (!inflater || currentRow + rowCount > height) {
+        return false;
+    }
+
+    for (uint32_t y = 0; y < rowCount; y++) {
+        uint8_t filter = 0;
+        if (!inflater->read(&filter, 1) || filter > PNG_FILTER_PAETH || !inflater->read(row.data(), rowBytes)) {
+            return false;
+        }
+
+        unfilterRow(filter);
+        convertRow(data + static_cast<size_t>(y) * width * channels);
+
+        row.swap(previousRow);
+        currentRow++;
+    }
+
+    return true;
+}
+
+void PngReader::close()
+{
+    inflater.reset();
+
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+
+    palette.clear();
+    hasTransparency = false;
+    imageDataRemaining = 0;
+    imageDataEnded = false;
+}
+
+//
+
+PngWriter::~PngWriter()
+{
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool PngWriter::writeData(const std::vector<uint8_t>& data)
+{
+    if (memory) {
+        memory->insert(memory->end(), data.begin(), data.end());
+
+        return true;
+    }
+
+    return fwrite(data.data(), 1, data.size(), file) == data.size();
+}
+
+bool PngWriter::writeImageData(bool all)
+{
+    std::vector<uint8_t> chunk;
+
+    size_t offset = 0;
+    while (compressed.size() - offset >= IMAGE_DATA_CHUNK_SIZE || (all && offset < compressed.size())) {
+        size_t size = std::min(compressed.size() - offset, IMAGE_DATA_CHUNK_SIZE);
+
+        chunk.clear();
+        appendChunk(chunk, "IDAT", compressed.data() + offset, size);
+        if (!writeData(chunk)) {
+            return false;
+        }
+
+        offset += size;
+    }
+
+    compressed.erase(compressed.begin(), compressed.begin() + offset);
+
+    return true;
+}
+
+bool PngWriter::open(const std::string& filename, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions)
+{
+    if (isOpen() || width == 0 || height == 0 || channels < 1 || channels > 4) {
+        return false;
+    }
+
+    file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    return begin(width, height, channels, pngOptions);
+}
+
+bool PngWriter::open(std::vector<uint8_t>& output, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions)
+{
+    if (isOpen() || width == 0 || height == 0 || channels < 1 || channels > 4) {
+        return false;
+    }
+
+    memory = &output;
+
+    return begin(width, height, channels, pngOptions);
+}
+
+bool PngWriter::begin(uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions)
+{
+    std::vector<uint8_t> header;
+    appendHeader(header, width, height, channels);
+
+    if (!writeData(header)) {
+        if (file) {
+            fclose(file);
+            file = nullptr;
+        }
+        memory = nullptr;
+
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+    this->channels = channels;
+    adaptiveFilter = (pngOptions.compressionLevel > 0);
+
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+
+    deflater.reset(new Deflater(pngOptions.compressionLevel));
+    compressed.clear();
+    previousRow.assign(rowBytes, 0);
+    filteredRow.assign(rowBytes + 1, 0);
+    bestRow.assign(rowBytes + 1, 0);
+    currentRow = 0;
+
+    return true;
+}
+
+bool PngWriter::writeRows(const uint8_t* data, uint32_t rowCount)
+{
+    if (!isOpen() || currentRow + rowCount > height) {
+        return false;
+    }
+
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+
+    for (uint32_t y = 0; y < rowCount; y++) {
+        const uint8_t* rowData = data + static_cast<size_t>(y) * rowBytes;
+
+        filterRow(bestRow.data(), filteredRow.data(), rowData, previousRow.data(), rowBytes, channels, adaptiveFilter);
+        deflater->write(bestRow.data(), bestRow.size(), compressed);
+
+        memcpy(previousRow.data(), rowData, rowBytes);
+        currentRow++;
+    }
+
+    return writeImageData(false);
+}
+
+bool PngWriter::close()
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    bool result = (currentRow == height);
+    if (result) {
+        deflater->finish(compressed);
+
+        std::vector<uint8_t> end;
+        appendChunk(end, "IEND", nullptr, 0);
+
+        result = writeImageData(true) && writeData(end);
+    }
+
+    if (file) {
+        result = (fclose(file) == 0) && result;
+        file = nullptr;
+    }
+    memory = nullptr;
+
+    deflater.reset();
+    compressed.clear();
+
+    return result;
+}
+
+//
+
+bool encodePng(EncodedData& encodedData, const uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions, ThreadPool& threadPool)
+{
+    encodedData.parts.clear();
+
+    if (pngOptions.pngEncoder == PNG_ENCODER_STB) {
+        encodedData.parts.resize(1);
+
+        return stbi_write_png_to_func(appendToVector, &encodedData.parts[0], static_cast<int>(width), static_cast<int>(height), static_cast<int>(channels), data, 0) != 0;
+    }
+
+    if (width == 0 || height == 0 || channels < 1 || channels > 4) {
+        return false;
+    }
+
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    size_t filteredRowBytes = rowBytes + 1;
+
+    // Blocks consist of whole rows, so each one is filtered independently
+
+    uint32_t blockRows = static_cast<uint32_t>(std::max(COMPRESS_BLOCK_SIZE / filteredRowBytes, static_cast<size_t>(1)));
+    uint32_t blockCount = (height + blockRows - 1) / blockRows;
+
+    PixelBuffer filtered;
+    if (!filtered.allocate(filteredRowBytes * height, &getImageBufferPool())) {
+        return false;
+    }
+
+    std::vector<uint8_t> zeroRow(rowBytes, 0);
+    bool adaptiveFilter = (pngOptions.compressionLevel > 0);
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        for (uint32_t block = 0; block < blockCount; block++) {
+            taskGroup.run([&, block]() {
+                std::vector<uint8_t> scratch(filteredRowBytes);
+
+                uint32_t endRow = std::min(height, (block + 1) * blockRows);
+                for (uint32_t y = block * blockRows; y < endRow; y++) {
+                    const uint8_t* previousRowData = (y > 0) ? data + (y - 1) * rowBytes : zeroRow.data();
+                    filterRow(filtered.data() + y * filteredRowBytes, scratch.data(), data + y * rowBytes, previousRowData, rowBytes, channels, adaptiveFilter);
+                }
+            });
+        }
+
+        taskGroup.wait();
+    }
+
+    // Each block is compressed as raw deflate with the preceding 32 KiB as dictionary and ends byte aligned,
+    // so the blocks are simply concatenated. Only the last block is final.
+    // Every block becomes one image data chunk, which is framed by the parts in between.
+
+    encodedData.parts.resize(2 * blockCount + 1);
+
+    std::vector<uint32_t> blockAdlers(blockCount, 1);
+    std::vector<uint32_t> blockCrcs(blockCount, 0);
+
+    {
+        TaskGroup taskGroup(threadPool);
+
+        for (uint32_t block = 0; block < blockCount; block++) {
+            taskGroup.run([&, block]() {
+                size_t begin = static_cast<size_t>(block) * blockRows * filteredRowBytes;
+                size_t end = std::min(static_cast<size_t>(height), static_cast<size_t>(block + 1) * blockRows) * filteredRowBytes;
+
+                const uint8_t* blockData = filtered.data() + begin;
+                size_t blockSize = end - begin;
+
+                Deflater deflater(pngOptions.compressionLevel, false);
+                if (begin > 0) {
+                    size_t dictionarySize = std::min(begin, DICTIONARY_SIZE);
+                    deflater.setDictionary(blockData - dictionarySize, dictionarySize);
+                }
+
+                std::vector<uint8_t>& compressed = encodedData.parts[2 * block + 1];
+                if (block == 0) {
+                    writeZlibHeader(compressed, pngOptions.compressionLevel);
+                }
+
+                deflater.write(blockData, blockSize, compressed);
+                if (block + 1 < blockCount) {
+                    deflater.flush(compressed);
+
+                    blockCrcs[block] = getChunkCrc("IDAT", compressed.data(), compressed.size());
+                } else {
+                    deflater.finish(compressed);
+                }
+
+                blockAdlers[block] = updateAdler32(1, blockData, blockSize);
+            });
+        }
+
+        taskGroup.wait();
+    }
+
+    filtered.release();
+
+    uint32_t adler = blockAdlers[0];
+    for (uint32_t block = 1; block < blockCount; block++) {
+        size_t blockSize = (std::min(static_cast<size_t>(height), static_cast<size_t>(block + 1) * blockRows) - static_cast<size_t>(block) * blockRows) * filteredRowBytes;
+        adler = combineAdler32(adler, blockAdlers[block], blockSize);
+    }
+
+    std::vector<uint8_t>& lastBlock = encodedData.parts[2 * blockCount - 1];
+    uint8_t trailer[4];
+    writeBigEndian(trailer, adler);
+    lastBlock.insert(lastBlock.end(), trailer, trailer + 4);
+    blockCrcs[blockCount - 1] = getChunkCrc("IDAT", lastBlock.data(), lastBlock.size());
+
+    //
+
+    appendHeader(encodedData.parts[0], width, height, channels);
+
+    for (uint32_t block = 0; block < blockCount; block++) {
+        appendChunkHeader(encodedData.parts[2 * block], "IDAT", encodedData.parts[2 * block + 1].size());
+        appendChunkTrailer(encodedData.parts[2 * block + 2], blockCrcs[block]);
+    }
+
+    appendChunk(encodedData.parts[2 * blockCount], "IEND", nullptr, 0);
+
+    return true;
+}
+
+bool savePng(const std::string& filename, const uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions, ThreadPool& threadPool)
+{
+    EncodedData encodedData;
+    if (!encodePng(encodedData, data, width, height, channels, pngOptions, threadPool)) {
+        return false;
+    }
+
+    std::vector<DataSegment> segments;
+    appendSegments(segments, encodedData);
+
+    return saveSegments(segments, filename);
+}
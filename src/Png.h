@@ -0,0 +1,154 @@
+#ifndef PNG_H_
+#define PNG_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Deflate.h"
+#include "Helper.h"
+
+class ThreadPool;
+
+enum PngEncoder {
+    PNG_ENCODER_DEFLATE,
+    PNG_ENCODER_STB
+};
+
+struct PngOptions {
+    PngEncoder pngEncoder = PNG_ENCODER_DEFLATE;
+    // 0 stores the data unfiltered, 1 is the fastest and 9 the smallest compression.
+    int32_t compressionLevel = 6;
+};
+
+// Incremental PNG decoder, which returns the image row by row. Only the zlib window and two rows are held in memory.
+// The channels match stbi_load without desired channels: 16 bit samples keep their high byte and palettes are expanded.
+class PngReader {
+public:
+
+    PngReader() = default;
+    ~PngReader();
+
+    PngReader(const PngReader&) = delete;
+    PngReader& operator=(const PngReader&) = delete;
+
+    // Fails for files, which are no PNG or can not be read row by row e.g. interlaced images.
+    bool open(const std::string& filename);
+
+    // Reads the next rowCount rows as tightly packed pixels.
+    bool readRows(uint8_t* data, uint32_t rowCount);
+
+    void close();
+
+    uint32_t getWidth() const
+    {
+        return width;
+    }
+
+    uint32_t getHeight() const
+    {
+        return height;
+    }
+
+    uint32_t getChannels() const
+    {
+        return channels;
+    }
+
+private:
+
+    bool readChunkHeader(uint32_t& length, std::string& type);
+    size_t readImageData(uint8_t* data, size_t size);
+
+    void unfilterRow(uint8_t filter);
+    void convertRow(uint8_t* data) const;
+
+    FILE* file = nullptr;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+
+    uint32_t bitDepth = 0;
+    uint32_t colorType = 0;
+    uint32_t samples = 0;
+
+    // Palette entries are stored as RGBA
+    std::vector<uint8_t> palette;
+    bool hasTransparency = false;
+
+    uint32_t imageDataRemaining = 0;
+    bool imageDataEnded = false;
+
+    std::unique_ptr<Inflater> inflater;
+
+    size_t rowBytes = 0;
+    size_t filterBytes = 0;
+    std::vector<uint8_t> row;
+    std::vector<uint8_t> previousRow;
+    uint32_t currentRow = 0;
+};
+
+// Incremental PNG encoder with 8 bit samples. Rows are filtered, compressed and written, as they arrive.
+class PngWriter {
+public:
+
+    PngWriter() = default;
+    ~PngWriter();
+
+    PngWriter(const PngWriter&) = delete;
+    PngWriter& operator=(const PngWriter&) = delete;
+
+    // Only the compression level of the options is used, the rows are always encoded with the built in deflater.
+    bool open(const std::string& filename, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions = PngOptions());
+
+    // Appends the encoded PNG to output instead of writing a file.
+    bool open(std::vector<uint8_t>& output, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions = PngOptions());
+
+    // Writes the next rowCount rows of tightly packed pixels.
+    bool writeRows(const uint8_t* data, uint32_t rowCount);
+
+    // Writes the remaining image data and the end chunk. Fails, if not all rows were written.
+    bool close();
+
+private:
+
+    bool isOpen() const
+    {
+        return file || memory;
+    }
+
+    bool begin(uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions);
+
+    bool writeData(const std::vector<uint8_t>& data);
+    bool writeImageData(bool all);
+
+    FILE* file = nullptr;
+    std::vector<uint8_t>* memory = nullptr;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+    bool adaptiveFilter = true;
+
+    std::unique_ptr<Deflater> deflater;
+    std::vector<uint8_t> compressed;
+
+    std::vector<uint8_t> previousRow;
+    std::vector<uint8_t> filteredRow;
+    std::vector<uint8_t> bestRow;
+    uint32_t currentRow = 0;
+};
+
+// Writes the filter type and the filtered row to output. The adaptive filter chooses the filter with the smallest sum of absolute values, otherwise the row is not filtered.
+void filterRow(uint8_t* output, uint8_t* scratch, const uint8_t* rowData, const uint8_t* previousRowData, size_t rowBytes, uint32_t bytesPerPixel, bool adaptiveFilter);
+
+// Encodes a whole image with 8 bit samples. The built in encoder filters and compresses independent row blocks in parallel on the thread pool
+// and joins them into one zlib stream. The compressed blocks stay separate parts of the encoded data.
+bool encodePng(EncodedData& encodedData, const uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions, ThreadPool& threadPool);
+
+bool savePng(const std::string& filename, const uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, const PngOptions& pngOptions, ThreadPool& threadPool);
+
+#endif /* PNG_H_ */
@@ -0,0 +1,546 @@
+#include "Server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Helper.h"
+#include "MemoryBudget.h"
+#include "PixelBuffer.h"
+#include "ThreadPool.h"
+#include "Writer.h"
+
+namespace {
+
+// Destination of the results of the jobs read from one input. The descriptor is closed with the channel, if owned.
+struct ResultChannel {
+    int32_t fileDescriptor = -1;
+    bool owned = false;
+    std::mutex mutex;
+
+    ~ResultChannel()
+    {
+#ifndef _WIN32
+        if (owned && fileDescriptor >= 0) {
+            close(fileDescriptor);
+        }
+#endif
+    }
+};
+
+// Counts the jobs, which are queued or converted. Reading waits for a free slot, so a client, which sends faster
+// than the jobs are converted, is slowed down by its full socket or pipe.
+class JobLimiter {
+public:
+
+    explicit JobLimiter(uint32_t maxJobCount) :
+        maxJobCount(maxJobCount)
+    {
+        trimThread = std::thread(&JobLimiter::trimLoop, this);
+    }
+
+    ~JobLimiter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+
+        trimThread.join();
+    }
+
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return jobCount < maxJobCount; });
+        jobCount++;
+        startedCount++;
+        trimmed = false;
+        condition.notify_all();
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobCount--;
+        condition.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return jobCount == 0; });
+    }
+
+private:
+
+    // The buffer pools stay warm between jobs. Only when no job was started for a while, the cached image buffers are
+    // returned to the system
+    void trimLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            condition.wait(lock, [this]() { return stopping || (jobCount == 0 && !trimmed); });
+            if (stopping) {
+                return;
+            }
+
+            uint64_t idleStartedCount = startedCount;
+            if (condition.wait_for(lock, IDLE_TRIM_DELAY, [this, idleStartedCount]() { return stopping || startedCount != idleStartedCount; })) {
+                continue;
+            }
+
+            trimmed = true;
+
+            lock.unlock();
+            getImageBufferPool().trim();
+            lock.lock();
+        }
+    }
+
+    const std::chrono::seconds IDLE_TRIM_DELAY{30};
+
+    uint32_t maxJobCount = 1;
+    uint32_t jobCount = 0;
+    uint64_t startedCount = 0;
+    bool trimmed = true;
+    bool stopping = false;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread trimThread;
+};
+
+struct ServeJob {
+    json id = nullptr;
+    std::string input = "";
+    std::string output = "";
+    ConvertOptions convertOptions;
+    bool syncFiles = false;
+    // Reservation of the memory budget, which is released, when the job is finished
+    uint64_t estimate = 0;
+    std::chrono::steady_clock::time_point receiveTime;
+};
+
+double getMilliseconds(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// Writes one result as one line, so the results of concurrent jobs do not interleave.
+void sendResult(ResultChannel& resultChannel, const json& result)
+{
+    std::string line = result.dump() + "\n";
+
+    std::lock_guard<std::mutex> lock(resultChannel.mutex);
+    if (!writeSegments({ { reinterpret_cast<const uint8_t*>(line.data()), line.size() } }, resultChannel.fileDescriptor)) {
+        printf("Warning: Could not send result\n");
+    }
+}
+
+json getErrorResult(const json& id, const char* errorCode, const std::string& error)
+{
+    json result = json::object();
+    result["id"] = id;
+    result["success"] = false;
+    result["errorCode"] = errorCode;
+    result["error"] = error;
+
+    return result;
+}
+
+// Applies the options of a job on top of the options of the server. Unknown options and wrong types are errors.
+bool parseJobOptions(ConvertOptions& convertOptions, std::string& error, const json& options)
+{
+    if (!options.is_object()) {
+        error = "Options are not an object";
+
+        return false;
+    }
+
+    for (auto it = options.begin(); it != options.end(); ++it) {
+        const std::string& key = it.key();
+        const json& value = it.value();
+
+        bool valid = true;
+        if (key == "metallicFactor" && value.is_number()) {
+            convertOptions.defaultMetallicFactor = clampf(value.get<float>(), 0.0f, 1.0f);
+        } else if (key == "roughnessFactor" && value.is_number()) {
+            convertOptions.defaultRoughnessFactor = clampf(value.get<float>(), 0.0f, 1.0f);
+        } else if (key == "keepBaseColor" && value.is_boolean()) {
+            convertOptions.keepBaseColorImageData = value.get<bool>();
+        } else if (key == "keepNormal" && value.is_boolean()) {
+            convertOptions.keepNormalImageData = value.get<bool>();
+        } else if (key == "keepEmissive" && value.is_boolean()) {
+            convertOptions.keepEmissiveImageData = value.get<bool>();
+        } else if (key == "stream" && value.is_number_unsigned()) {
+            convertOptions.bandHeight = value.get<uint32_t>();
+        } else if (key == "compressionLevel" && value.is_number_integer()) {
+            convertOptions.pngOptions.compressionLevel = std::min(std::max(value.get<int>(), 0), 9);
+        } else if (key == "pngEncoder" && value == "deflate") {
+            convertOptions.pngOptions.pngEncoder = PNG_ENCODER_DEFLATE;
+        } else if (key == "pngEncoder" && value == "stb") {
+            convertOptions.pngOptions.pngEncoder = PNG_ENCODER_STB;
+        } else if (key == "foldConstants" && value.is_boolean()) {
+            convertOptions.foldConstants = value.get<bool>();
+        } else if (key == "lod" && value.is_number_unsigned()) {
+            convertOptions.lodCount = value.get<uint32_t>();
+        } else if (key == "ktx2" && value == "off") {
+            convertOptions.saveKtx2 = false;
+        } else if (key == "ktx2" && value == "fast") {
+            convertOptions.saveKtx2 = true;
+            convertOptions.bc7Quality = BC7_QUALITY_FAST;
+        } else if (key == "ktx2" && value == "normal") {
+            convertOptions.saveKtx2 = true;
+            convertOptions.bc7Quality = BC7_QUALITY_NORMAL;
+        } else if (key == "ktx2" && value == "slow") {
+            convertOptions.saveKtx2 = true;
+            convertOptions.bc7Quality = BC7_QUALITY_SLOW;
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            error = "Invalid option '" + key + "'";
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool parseJob(ServeJob& serveJob, std::string& error, const std::string& line, const ConvertOptions& convertOptions)
+{
+    json job = json::parse(line, nullptr, false);
+    if (job.is_discarded() || !job.is_object()) {
+        error = "Could not parse job";
+
+        return false;
+    }
+
+    if (job.contains("id")) {
+        serveJob.id = job["id"];
+    }
+
+    if (!job.contains("input") || !job["input"].is_string()) {
+        error = "Job has no input folder";
+
+        return false;
+    }
+    serveJob.input = job["input"].get<std::string>();
+
+    serveJob.output = ".";
+    if (job.contains("output")) {
+        if (!job["output"].is_string()) {
+            error = "Output of job is not a folder";
+
+            return false;
+        }
+        serveJob.output = job["output"].get<std::string>();
+    }
+
+    // The outputs are kept in memory and saved to the output folder of the job, as the current folder is shared by all jobs
+
+    serveJob.convertOptions = convertOptions;
+    serveJob.convertOptions.keepOutputs = true;
+    serveJob.convertOptions.outputDescriptor = -1;
+    serveJob.convertOptions.useCache = false;
+    serveJob.convertOptions.outputRegistry = nullptr;
+
+    if (job.contains("format")) {
+        if (job["format"] == "gltf") {
+            serveJob.convertOptions.saveBinary = false;
+        } else if (job["format"] == "glb") {
+            serveJob.convertOptions.saveBinary = true;
+        } else {
+            error = "Unknown format of job";
+
+            return false;
+        }
+    }
+
+    if (job.contains("options") && !parseJobOptions(serveJob.convertOptions, error, job["options"])) {
+        return false;
+    }
+
+    return true;
+}
+
+// Each file is written to a temporary name and renamed, so a client never sees a partial file.
+bool saveOutputFiles(ConvertResult& convertResult, json& files, const std::string& folder, bool syncFiles)
+{
+    std::error_code errorCode;
+    fs::create_directories(folder, errorCode);
+
+    for (const OutputFile& outputFile : convertResult.outputFiles) {
+        std::string filename = (fs::path(folder) / outputFile.path).generic_string();
+
+        if (!saveSegmentsAtomically({ { outputFile.data.data(), outputFile.data.size() } }, filename, syncFiles)) {
+            convertResult.errorCode = CONVERT_ERROR_OUTPUT;
+            convertResult.error = "Could not save '" + filename + "'";
+
+            return false;
+        }
+
+        files.push_back(filename);
+    }
+
+    return true;
+}
+
+void runJob(ServeJob& serveJob, ResultChannel& resultChannel, ThreadPool& threadPool)
+{
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    ConvertResult convertResult;
+    bool success = false;
+    try {
+        success = convertMaterial(convertResult, serveJob.input, serveJob.convertOptions, threadPool);
+    } catch (const std::exception& exception) {
+        convertResult.errorCode = CONVERT_ERROR_EXCEPTION;
+        convertResult.error = exception.what();
+
+        printf("Error: %s\n", convertResult.error.c_str());
+    }
+
+    std::chrono::steady_clock::time_point convertTime = std::chrono::steady_clock::now();
+
+    json files = json::array();
+    if (success) {
+        success = saveOutputFiles(convertResult, files, serveJob.output, serveJob.syncFiles);
+    }
+    convertResult.outputFiles.clear();
+
+    std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+
+    //
+
+    json result = json::object();
+    if (success) {
+        result["id"] = serveJob.id;
+        result["success"] = true;
+        result["output"] = (fs::path(serveJob.output) / convertResult.savename).generic_string();
+        result["files"] = files;
+    } else {
+        result = getErrorResult(serveJob.id, getConvertErrorName(convertResult.errorCode), convertResult.error);
+    }
+    result["queueMilliseconds"] = getMilliseconds(serveJob.receiveTime, startTime);
+    result["convertMilliseconds"] = getMilliseconds(startTime, convertTime);
+    result["writeMilliseconds"] = getMilliseconds(convertTime, endTime);
+    result["totalMilliseconds"] = getMilliseconds(serveJob.receiveTime, endTime);
+
+    sendResult(resultChannel, result);
+}
+
+// Reads the jobs of one input line by line and converts them on the thread pool, until the input ends.
+// Invalid jobs are answered at once.
+void serveInput(const std::function<bool(std::string&)>& readLine, const std::shared_ptr<ResultChannel>& resultChannel, JobLimiter& jobLimiter, const ServeOptions& serveOptions, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    std::string line;
+    while (readLine(line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::shared_ptr<ServeJob> serveJob = std::make_shared<ServeJob>();
+        serveJob->receiveTime = std::chrono::steady_clock::now();
+        serveJob->syncFiles = serveOptions.syncFiles;
+
+        std::string error;
+        if (!parseJob(*serveJob, error, line, convertOptions)) {
+            printf("Warning: %s\n", error.c_str());
+
+            sendResult(*resultChannel, getErrorResult(serveJob->id, "job", error));
+
+            continue;
+        }
+
+        jobLimiter.acquire();
+
+        // With a memory budget, the jobs of this input are admitted in their order by the estimate of their working set.
+        // A job, which can not be scanned, fails in its conversion
+        MemoryBudget* memoryBudget = serveJob->convertOptions.memoryBudget;
+        if (memoryBudget) {
+            estimateMaterialMemory(serveJob->estimate, serveJob->input, serveJob->convertOptions);
+
+            memoryBudget->reserve(serveJob->estimate);
+        }
+
+        threadPool.submit([serveJob, resultChannel, &jobLimiter, &threadPool]() {
+            try {
+                runJob(*serveJob, *resultChannel, threadPool);
+            } catch (const std::exception& exception) {
+                printf("Error: %s\n", exception.what());
+            }
+
+            if (serveJob->convertOptions.memoryBudget) {
+                serveJob->convertOptions.memoryBudget->release(serveJob->estimate);
+            }
+
+            jobLimiter.release();
+        });
+    }
+}
+
+#ifndef _WIN32
+// Reads lines from a socket. The bytes after the last line end are kept for the next call.
+class SocketReader {
+public:
+
+    explicit SocketReader(int32_t fileDescriptor) :
+        fileDescriptor(fileDescriptor)
+    {
+    }
+
+    bool readLine(std::string& line)
+    {
+        for (;;) {
+            size_t end = pending.find('\n');
+            if (end != std::string::npos) {
+                line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+
+                return true;
+            }
+
+            char buffer[4096];
+            ssize_t result = read(fileDescriptor, buffer, sizeof(buffer));
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                // A last line without line end is a job as well
+                line = std::move(pending);
+                pending.clear();
+
+                return !line.empty();
+            }
+
+            pending.append(buffer, static_cast<size_t>(result));
+        }
+    }
+
+private:
+
+    int32_t fileDescriptor = -1;
+    std::string pending = "";
+};
+
+bool serveSocket(const ServeOptions& serveOptions, JobLimiter& jobLimiter, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    const std::string& socketPath = serveOptions.socketPath;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        printf("Error: Socket path '%s' is too long\n", socketPath.c_str());
+
+        return false;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        printf("Error: Could not create socket '%s'\n", socketPath.c_str());
+
+        return false;
+    }
+
+    // A socket file of a previous run would block the bind
+    unlink(socketPath.c_str());
+
+    if (bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        printf("Error: Could not listen on socket '%s'\n", socketPath.c_str());
+        close(listener);
+
+        return false;
+    }
+
+    // Clients, which disconnect before their results are sent, must not terminate the server
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Info: Listening on '%s'\n", socketPath.c_str());
+
+    for (;;) {
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                printf("Warning: Could not accept connection: %s\n", strerror(errno));
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+
+            continue;
+        }
+
+        // Each connection is read by its own thread. The connection is closed, when its last result is sent
+        std::thread([connection, &jobLimiter, &serveOptions, &convertOptions, &threadPool]() {
+            std::shared_ptr<ResultChannel> resultChannel = std::make_shared<ResultChannel>();
+            resultChannel->fileDescriptor = connection;
+            resultChannel->owned = true;
+
+            SocketReader socketReader(connection);
+            serveInput([&socketReader](std::string& line) { return socketReader.readLine(line); }, resultChannel, jobLimiter, serveOptions, convertOptions, threadPool);
+        }).detach();
+    }
+}
+#endif
+
+}
+
+bool serve(const ServeOptions& serveOptions, const ConvertOptions& convertOptions, ThreadPool& threadPool)
+{
+    uint32_t queueDepth = serveOptions.queueDepth;
+    if (queueDepth == 0) {
+        queueDepth = 2 * threadPool.getWorkerCount();
+    }
+
+    JobLimiter jobLimiter(queueDepth);
+
+    if (!serveOptions.socketPath.empty()) {
+#ifdef _WIN32
+        printf("Error: Unix domain sockets are not supported on this platform\n");
+
+        return false;
+#else
+        return serveSocket(serveOptions, jobLimiter, convertOptions, threadPool);
+#endif
+    }
+
+    // The results are written to the standard output, so all messages are moved to the standard error
+
+    std::shared_ptr<ResultChannel> resultChannel = std::make_shared<ResultChannel>();
+    resultChannel->fileDescriptor = redirectStandardOutput();
+    if (resultChannel->fileDescriptor < 0) {
+        printf("Error: Could not redirect standard output\n");
+
+        return false;
+    }
+
+    printf("Info: Reading jobs from standard input using %u workers and a queue depth of %u\n", threadPool.getWorkerCount(), queueDepth);
+
+    serveInput([](std::string& line) { return static_cast<bool>(std::getline(std::cin, line)); }, resultChannel, jobLimiter, serveOptions, convertOptions, threadPool);
+
+    jobLimiter.wait();
+
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "Converter.h"
+
+class ThreadPool;
+
+struct ServeOptions {
+    // Path of the Unix domain socket to listen on or an empty path to read the jobs from the standard input.
+    std::string socketPath = "";
+    // Jobs, which may be queued or converted at once, before no more jobs are read. Zero allows twice the workers.
+    uint32_t queueDepth = 0;
+    // Flush every output to the disk before it is renamed to its final name.
+    bool syncFiles = false;
+};
+
+// Converts jobs, which are read as one JSON object per line, until the standard input ends or forever on a socket.
+// A job gives the input folder, the output folder, the format and options, which override the given ones. The thread pool and
+// the buffer pools stay warm between the jobs. The result of each job is written back as one JSON line, when it is finished.
+bool serve(const ServeOptions& serveOptions, const ConvertOptions& convertOptions, ThreadPool& threadPool);
+
+#endif /* SERVER_H_ */
@@ -0,0 +1,51 @@
+#include "Simd.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+SimdLevel detectSimdLevel()
+{
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_LEVEL_AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return SIMD_LEVEL_SSSE3;
+    }
+#elif defined(SIMD_X86) && defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    if (maxLeaf >= 7 && osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6)) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            return SIMD_LEVEL_AVX2;
+        }
+    }
+    if (ssse3) {
+        return SIMD_LEVEL_SSSE3;
+    }
+#endif
+
+    return SIMD_LEVEL_SCALAR;
+}
+
+}
+
+SimdLevel getSimdLevel()
+{
+    static const SimdLevel simdLevel = detectSimdLevel();
+
+    return simdLevel;
+}
@@ -0,0 +1,24 @@
+#ifndef SIMD_H_
+#define SIMD_H_
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#endif
+
+// Enables an instruction set for a single function, so the kernels can be selected at runtime.
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET(name) __attribute__((target(name)))
+#else
+#define SIMD_TARGET(name)
+#endif
+
+enum SimdLevel {
+    SIMD_LEVEL_SCALAR,
+    SIMD_LEVEL_SSSE3,
+    SIMD_LEVEL_AVX2
+};
+
+// Highest instruction set supported by the CPU and the operating system.
+SimdLevel getSimdLevel();
+
+#endif /* SIMD_H_ */
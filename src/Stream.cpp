@@ -0,0 +1,263 @@
+#include "Stream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+bool RowReader::open(const std::string& filename)
+{
+    incremental = pngReader.open(filename);
+    if (incremental) {
+        return true;
+    }
+
+    // Fall back to decode the whole image e.g. for JPEG or interlaced PNG
+    currentRow = 0;
+
+    return loadImage(image, filename);
+}
+
+bool RowReader::readRows(uint8_t* data, uint32_t rowCount)
+{
+    if (incremental) {
+        return pngReader.readRows(data, rowCount);
+    }
+
+    if (currentRow + rowCount > image.height) {
+        return false;
+    }
+
+    size_t rowBytes = static_cast<size_t>(image.width) * image.channels;
+    memcpy(data, image.pixels.data() + currentRow * rowBytes, rowCount * rowBytes);
+    currentRow += rowCount;
+
+    return true;
+}
+
+uint32_t RowReader::getWidth() const
+{
+    return incremental ? pngReader.getWidth() : image.width;
+}
+
+uint32_t RowReader::getHeight() const
+{
+    return incremental ? pngReader.getHeight() : image.height;
+}
+
+uint32_t RowReader::getChannels() const
+{
+    return incremental ? pngReader.getChannels() : image.channels;
+}
+
+//
+
+bool streamImage(std::vector<uint8_t>& foundSources, std::string& error, const std::string& filename, uint32_t width, uint32_t height, uint32_t channels, const std::vector<BandSource>& bandSources, uint32_t bandHeight, const PngOptions& pngOptions, std::vector<uint8_t>* output)
+{
+    foundSources.assign(bandSources.size(), 0);
+
+    bandHeight = std::max(std::min(bandHeight, height), 1u);
+
+    std::vector<std::unique_ptr<RowReader>> rowReaders(bandSources.size());
+    std::vector<PixelBuffer> sourceBands(bandSources.size());
+
+    bool written[4] = {};
+
+    for (size_t i = 0; i < bandSources.size(); i++) {
+        const BandSource& bandSource = bandSources[i];
+
+        std::unique_ptr<RowReader> rowReader(new RowReader());
+        if (!rowReader->open(bandSource.filename)) {
+            printf("Warning: Skipping image '%s' because could not load size\n", bandSource.filename.c_str());
+
+            continue;
+        }
+
+        if (rowReader->getWidth() != width || rowReader->getHeight() != height) {
+            printf("Warning: Skipping image '%s' because of size\n", bandSource.filename.c_str());
+
+            continue;
+        }
+
+        bool validMoves = true;
+        for (const ChannelMove& channelMove : bandSource.channelMoves) {
+            validMoves = validMoves && (channelMove.sourceChannel < rowReader->getChannels()) && (channelMove.destinationChannel < channels);
+        }
+        if (!validMoves) {
+            printf("Warning: Skipping image '%s' because of channels\n", bandSource.filename.c_str());
+
+            continue;
+        }
+
+        if (!sourceBands[i].allocate(static_cast<size_t>(width) * bandHeight * rowReader->getChannels())) {
+            error = "Could not allocate band of image '" + bandSource.filename + "'";
+
+            return false;
+        }
+
+        for (const ChannelMove& channelMove : bandSource.channelMoves) {
+            written[channelMove.destinationChannel] = true;
+        }
+
+        rowReaders[i] = std::move(rowReader);
+        foundSources[i] = 1;
+    }
+
+    if (std::find(foundSources.begin(), foundSources.end(), 1) == foundSources.end()) {
+        return true;
+    }
+
+    std::vector<uint32_t> defaultChannels;
+    for (uint32_t channel = 0; channel < channels; channel++) {
+        if (!written[channel]) {
+            defaultChannels.push_back(channel);
+        }
+    }
+
+    PixelBuffer band;
+    if (!band.allocate(static_cast<size_t>(width) * bandHeight * channels)) {
+        error = "Could not allocate band of image '" + filename + "'";
+
+        return false;
+    }
+
+    PngWriter pngWriter;
+    bool opened = output ? pngWriter.open(*output, width, height, channels, pngOptions) : pngWriter.open(filename, width, height, channels, pngOptions);
+    if (!opened) {
+        error = "Could not save image '" + filename + "'";
+
+        return false;
+    }
+
+    // Channels without a source never change, so they are filled once
+
+    fillPixels(band.data(), channels, static_cast<size_t>(width) * bandHeight, defaultChannels, 255);
+
+    for (uint32_t y = 0; y < height; y += bandHeight) {
+        uint32_t rowCount = std::min(bandHeight, height - y);
+        size_t pixelCount = static_cast<size_t>(width) * rowCount;
+
+        for (size_t i = 0; i < bandSources.size(); i++) {
+            if (!rowReaders[i]) {
+                continue;
+            }
+
+            if (!rowReaders[i]->readRows(sourceBands[i].data(), rowCount)) {
+                error = "Could not load image rows '" + bandSources[i].filename + "'";
+
+                return false;
+            }
+
+            swizzlePixels(band.data(), channels, sourceBands[i].data(), rowReaders[i]->getChannels(), pixelCount, bandSources[i].channelMoves);
+        }
+
+        if (!pngWriter.writeRows(band.data(), rowCount)) {
+            error = "Could not save image '" + filename + "'";
+
+            return false;
+        }
+    }
+
+    if (!pngWriter.close()) {
+        error = "Could not save image '" + filename + "'";
+
+        return false;
+    }
+
+    return true;
+}
+
+bool scanUniformImage(bool& uniform, std::vector<uint8_t>& firstPixel, const std::string& filename, const std::vector<uint32_t>& channels, uint32_t bandHeight)
+{
+    RowReader rowReader;
+    if (!rowReader.open(filename)) {
+        return false;
+    }
+
+    uint32_t width = rowReader.getWidth();
+    uint32_t height = rowReader.getHeight();
+    uint32_t sourceChannels = rowReader.getChannels();
+
+    for (uint32_t channel : channels) {
+        if (channel >= sourceChannels) {
+            return false;
+        }
+    }
+
+    bandHeight = std::max(std::min(bandHeight, height), 1u);
+
+    PixelBuffer band;
+    if (!band.allocate(static_cast<size_t>(width) * bandHeight * sourceChannels)) {
+        return false;
+    }
+
+    firstPixel.clear();
+
+    for (uint32_t y = 0; y < height; y += bandHeight) {
+        uint32_t rowCount = std::min(bandHeight, height - y);
+
+        if (!rowReader.readRows(band.data(), rowCount)) {
+            return false;
+        }
+
+        if (firstPixel.empty()) {
+            firstPixel.assign(band.data(), band.data() + sourceChannels);
+        }
+
+        // Each band is uniform in itself, so only its first pixel is compared with the first pixel of the image
+        bool uniformBand = isUniform(band.data(), sourceChannels, static_cast<size_t>(width) * rowCount, channels);
+        for (uint32_t channel : channels) {
+            uniformBand = uniformBand && (band.data()[channel] == firstPixel[channel]);
+        }
+
+        if (!uniformBand) {
+            uniform = false;
+
+            return true;
+        }
+    }
+
+    uniform = true;
+
+    return true;
+}
+
+bool scanAlphaCoverage(AlphaCoverage& alphaCoverage, const std::string& filename, uint32_t channel, uint32_t bandHeight)
+{
+    RowReader rowReader;
+    if (!rowReader.open(filename)) {
+        return false;
+    }
+
+    uint32_t width = rowReader.getWidth();
+    uint32_t height = rowReader.getHeight();
+    uint32_t sourceChannels = rowReader.getChannels();
+
+    if (channel >= sourceChannels) {
+        return false;
+    }
+
+    bandHeight = std::max(std::min(bandHeight, height), 1u);
+
+    PixelBuffer band;
+    if (!band.allocate(static_cast<size_t>(width) * bandHeight * sourceChannels)) {
+        return false;
+    }
+
+    alphaCoverage = ALPHA_COVERAGE_OPAQUE;
+
+    for (uint32_t y = 0; y < height; y += bandHeight) {
+        uint32_t rowCount = std::min(bandHeight, height - y);
+
+        if (!rowReader.readRows(band.data(), rowCount)) {
+            return false;
+        }
+
+        alphaCoverage = std::max(alphaCoverage, getAlphaCoverage(band.data(), sourceChannels, static_cast<size_t>(width) * rowCount, channel));
+        if (alphaCoverage == ALPHA_COVERAGE_BLEND) {
+            return true;
+        }
+    }
+
+    return true;
+}
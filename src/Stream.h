@@ -0,0 +1,52 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Helper.h"
+#include "Png.h"
+#include "Swizzle.h"
+
+// Reads an image row by row. PNG files are decoded incrementally, other formats and PNG files, which can not be read row by row, at once.
+class RowReader {
+public:
+
+    bool open(const std::string& filename);
+
+    bool readRows(uint8_t* data, uint32_t rowCount);
+
+    uint32_t getWidth() const;
+    uint32_t getHeight() const;
+    uint32_t getChannels() const;
+
+private:
+
+    bool incremental = false;
+
+    PngReader pngReader;
+
+    ImageDataResource image;
+    uint32_t currentRow = 0;
+};
+
+// Image, which channels are packed into a streamed image.
+struct BandSource {
+    std::string filename = "";
+    std::vector<ChannelMove> channelMoves;
+};
+
+// Packs the sources band by band into a PNG, so only bandHeight rows of each image are held in memory.
+// Channels without a source are set to 255, as are the channels of sources, which can not be opened. foundSources marks the opened sources.
+// Nothing is written, if no source could be opened. If output is given, the PNG is appended to it instead of saved as filename.
+bool streamImage(std::vector<uint8_t>& foundSources, std::string& error, const std::string& filename, uint32_t width, uint32_t height, uint32_t channels, const std::vector<BandSource>& bandSources, uint32_t bandHeight, const PngOptions& pngOptions, std::vector<uint8_t>* output = nullptr);
+
+// Reads the image band by band, until a pixel differs from the first one in one of the channels. firstPixel receives all channels of the first pixel.
+// Fails, if the image can not be read.
+bool scanUniformImage(bool& uniform, std::vector<uint8_t>& firstPixel, const std::string& filename, const std::vector<uint32_t>& channels, uint32_t bandHeight);
+
+// Reads the image band by band, until a value of the channel is neither 0 nor 255. Fails, if the image can not be read.
+bool scanAlphaCoverage(AlphaCoverage& alphaCoverage, const std::string& filename, uint32_t channel, uint32_t bandHeight);
+
+#endif /* STREAM_H_ */
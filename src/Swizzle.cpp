@@ -0,0 +1,457 @@
+#include "Swizzle.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Simd.h"
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The vector kernels process windows of four pixels, which fit into 16 bytes for up to four channels.
+// Bytes of the window, which are not written, are kept by a mask.
+struct SwizzleWindow {
+    uint8_t shuffle[16];
+    uint8_t pattern[16];
+    uint8_t keep[16];
+    size_t windowPixels = 0;
+};
+
+void buildWindow(SwizzleWindow& swizzleWindow, uint32_t destinationChannels, uint32_t sourceChannels, const int32_t sourceOf[4], uint8_t value)
+{
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t pixel = i / destinationChannels;
+        uint32_t channel = i % destinationChannels;
+
+        if (pixel < 4 && sourceOf[channel] >= 0) {
+            swizzleWindow.shuffle[i] = static_cast<uint8_t>(pixel * sourceChannels + static_cast<uint32_t>(sourceOf[channel]));
+            swizzleWindow.pattern[i] = value;
+            swizzleWindow.keep[i] = 0x00;
+        } else {
+            swizzleWindow.shuffle[i] = 0x80;
+            swizzleWindow.pattern[i] = 0x00;
+            swizzleWindow.keep[i] = 0xFF;
+        }
+    }
+
+    // Number of pixels, which have to follow a window start, so the 16 byte loads and stores stay inside the buffers
+    swizzleWindow.windowPixels = std::max((16 + destinationChannels - 1) / destinationChannels, (16 + sourceChannels - 1) / sourceChannels);
+}
+
+#if defined(SIMD_X86)
+
+SIMD_TARGET("ssse3")
+size_t swizzleSsse3(uint8_t* destination, uint32_t destinationChannels, const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const SwizzleWindow& swizzleWindow)
+{
+    const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.shuffle));
+    const __m128i keep = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.keep));
+
+    size_t p = 0;
+    for (; p + swizzleWindow.windowPixels <= pixelCount; p += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + p * sourceChannels));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + p * destinationChannels));
+
+        d = _mm_or_si128(_mm_and_si128(d, keep), _mm_shuffle_epi8(s, shuffle));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + p * destinationChannels), d);
+    }
+
+    return p;
+}
+
+SIMD_TARGET("avx2")
+size_t swizzleAvx2(uint8_t* destination, uint32_t destinationChannels, const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const SwizzleWindow& swizzleWindow)
+{
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.shuffle)));
+    const __m256i keep = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.keep)));
+
+    // Two windows per iteration, one in each 128 bit lane. The upper window is stored last, as it may overlap the kept bytes of the lower one.
+    size_t p = 0;
+    for (; p + 4 + swizzleWindow.windowPixels <= pixelCount; p += 8) {
+        __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + p * sourceChannels));
+        __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (p + 4) * sourceChannels));
+        __m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + p * destinationChannels));
+        __m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + (p + 4) * destinationChannels));
+
+        __m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(s0), s1, 1);
+        __m256i d = _mm256_inserti128_si256(_mm256_castsi128_si256(d0), d1, 1);
+
+        d = _mm256_or_si256(_mm256_and_si256(d, keep), _mm256_shuffle_epi8(s, shuffle));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + p * destinationChannels), _mm256_castsi256_si128(d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + (p + 4) * destinationChannels), _mm256_extracti128_si256(d, 1));
+    }
+
+    return p;
+}
+
+SIMD_TARGET("sse2")
+size_t fillSse2(uint8_t* destination, uint32_t destinationChannels, size_t pixelCount, const SwizzleWindow& swizzleWindow)
+{
+    const __m128i pattern = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.pattern));
+    const __m128i keep = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.keep));
+
+    size_t p = 0;
+    for (; p + swizzleWindow.windowPixels <= pixelCount; p += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + p * destinationChannels));
+
+        d = _mm_or_si128(_mm_and_si128(d, keep), pattern);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + p * destinationChannels), d);
+    }
+
+    return p;
+}
+
+// The window is compared with the first four pixels and only the bytes of the checked channels count
+
+SIMD_TARGET("sse2")
+size_t findDifferenceSse2(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const SwizzleWindow& swizzleWindow)
+{
+    const __m128i pattern = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.pattern));
+    const __m128i keep = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.keep));
+
+    size_t p = 0;
+    for (; p + swizzleWindow.windowPixels <= pixelCount; p += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + p * sourceChannels));
+
+        __m128i equal = _mm_or_si128(_mm_cmpeq_epi8(s, pattern), keep);
+        if (_mm_movemask_epi8(equal) != 0xFFFF) {
+            return p;
+        }
+    }
+
+    return p;
+}
+
+SIMD_TARGET("avx2")
+size_t findDifferenceAvx2(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const SwizzleWindow& swizzleWindow)
+{
+    const __m256i pattern = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.pattern)));
+    const __m256i keep = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(swizzleWindow.keep)));
+
+    size_t p = 0;
+    for (; p + 4 + swizzleWindow.windowPixels <= pixelCount; p += 8) {
+        __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + p * sourceChannels));
+        __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (p + 4) * sourceChannels));
+
+        __m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(s0), s1, 1);
+
+        __m256i equal = _mm256_or_si256(_mm256_cmpeq_epi8(s, pattern), keep);
+        if (_mm256_movemask_epi8(equal) != -1) {
+            return p;
+        }
+    }
+
+    return p;
+}
+
+#endif
+
+void swizzleScalar(uint8_t* destination, uint32_t destinationChannels, const uint8_t* source, uint32_t sourceChannels, size_t begin, size_t pixelCount, const std::vector<ChannelMove>& channelMoves)
+{
+    uint8_t* d = destination + begin * destinationChannels;
+    const uint8_t* s = source + begin * sourceChannels;
+
+    for (size_t p = begin; p < pixelCount; p++) {
+        for (const ChannelMove& channelMove : channelMoves) {
+            d[channelMove.destinationChannel] = s[channelMove.sourceChannel];
+        }
+
+        d += destinationChannels;
+        s += sourceChannels;
+    }
+}
+
+void fillScalar(uint8_t* destination, uint32_t destinationChannels, size_t begin, size_t pixelCount, const std::vector<uint32_t>& channels, uint8_t value)
+{
+    uint8_t* d = destination + begin * destinationChannels;
+
+    for (size_t p = begin; p < pixelCount; p++) {
+        for (uint32_t channel : channels) {
+            d[channel] = value;
+        }
+
+        d += destinationChannels;
+    }
+}
+
+}
+
+bool swizzlePixels(uint8_t* destination, uint32_t destinationChannels, const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const std::vector<ChannelMove>& channelMoves)
+{
+    if (destinationChannels < 1 || destinationChannels > 4 || sourceChannels < 1 || sourceChannels > 4) {
+        return false;
+    }
+
+    int32_t sourceOf[4] = { -1, -1, -1, -1 };
+    for (const ChannelMove& channelMove : channelMoves) {
+        if (channelMove.sourceChannel >= sourceChannels || channelMove.destinationChannel >= destinationChannels) {
+            return false;
+        }
+
+        sourceOf[channelMove.destinationChannel] = static_cast<int32_t>(channelMove.sourceChannel);
+    }
+
+    size_t begin = 0;
+
+#if defined(SIMD_X86)
+    SimdLevel simdLevel = getSimdLevel();
+    if (simdLevel >= SIMD_LEVEL_SSSE3) {
+        SwizzleWindow swizzleWindow;
+        buildWindow(swizzleWindow, destinationChannels, sourceChannels, sourceOf, 0);
+
+        if (simdLevel >= SIMD_LEVEL_AVX2) {
+            begin = swizzleAvx2(destination, destinationChannels, source, sourceChannels, pixelCount, swizzleWindow);
+        } else {
+            begin = swizzleSsse3(destination, destinationChannels, source, sourceChannels, pixelCount, swizzleWindow);
+        }
+    }
+#endif
+
+    swizzleScalar(destination, destinationChannels, source, sourceChannels, begin, pixelCount, channelMoves);
+
+    return true;
+}
+
+void fillPixels(uint8_t* destination, uint32_t destinationChannels, size_t pixelCount, const std::vector<uint32_t>& channels, uint8_t value)
+{
+    if (destinationChannels < 1 || destinationChannels > 4) {
+        return;
+    }
+
+    int32_t sourceOf[4] = { -1, -1, -1, -1 };
+    for (uint32_t channel : channels) {
+        if (channel < destinationChannels) {
+            sourceOf[channel] = 0;
+        }
+    }
+
+    bool allChannels = true;
+    for (uint32_t channel = 0; channel < destinationChannels; channel++) {
+        allChannels = allChannels && (sourceOf[channel] >= 0);
+    }
+
+    if (allChannels) {
+        memset(destination, value, pixelCount * destinationChannels);
+
+        return;
+    }
+
+    size_t begin = 0;
+
+#if defined(SIMD_X86)
+    if (getSimdLevel() >= SIMD_LEVEL_SSSE3) {
+        SwizzleWindow swizzleWindow;
+        buildWindow(swizzleWindow, destinationChannels, 4, sourceOf, value);
+
+        begin = fillSse2(destination, destinationChannels, pixelCount, swizzleWindow);
+    }
+#endif
+
+    std::vector<uint32_t> validChannels;
+    for (uint32_t channel = 0; channel < destinationChannels; channel++) {
+        if (sourceOf[channel] >= 0) {
+            validChannels.push_back(channel);
+        }
+    }
+
+    fillScalar(destination, destinationChannels, begin, pixelCount, validChannels, value);
+}
+
+bool isUniform(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const std::vector<uint32_t>& channels)
+{
+    if (sourceChannels < 1 || sourceChannels > 4 || pixelCount == 0) {
+        return false;
+    }
+
+    for (uint32_t channel : channels) {
+        if (channel >= sourceChannels) {
+            return false;
+        }
+    }
+
+    size_t begin = 0;
+
+#if defined(SIMD_X86)
+    if (getSimdLevel() >= SIMD_LEVEL_SSSE3) {
+        // The pattern repeats the first pixel four times, the other bytes are kept
+        int32_t sourceOf[4] = { -1, -1, -1, -1 };
+        for (uint32_t channel : channels) {
+            sourceOf[channel] = static_cast<int32_t>(channel);
+        }
+
+        SwizzleWindow swizzleWindow;
+        buildWindow(swizzleWindow, sourceChannels, sourceChannels, sourceOf, 0);
+        for (uint32_t i = 0; i < 16; i++) {
+            swizzleWindow.pattern[i] = (swizzleWindow.keep[i] == 0x00) ? source[i % sourceChannels] : 0x00;
+        }
+
+        if (getSimdLevel() >= SIMD_LEVEL_AVX2) {
+            begin = findDifferenceAvx2(source, sourceChannels, pixelCount, swizzleWindow);
+        }
+        begin += findDifferenceSse2(source + begin * sourceChannels, sourceChannels, pixelCount - begin, swizzleWindow);
+    }
+#endif
+
+    const uint8_t* s = source + begin * sourceChannels;
+
+    for (size_t p = begin; p < pixelCount; p++) {
+        for (uint32_t channel : channels) {
+            if (s[channel] != source[channel]) {
+                return false;
+            }
+        }
+
+        s += sourceChannels;
+    }
+
+    return true;
+}
+
+AlphaCoverage getAlphaCoverage(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, uint32_t channel)
+{
+    if (channel >= sourceChannels) {
+        return ALPHA_COVERAGE_BLEND;
+    }
+
+    AlphaCoverage alphaCoverage = ALPHA_COVERAGE_OPAQUE;
+
+    const uint8_t* s = source + channel;
+
+    for (size_t p = 0; p < pixelCount; p++) {
+        if (*s == 0) {
+            alphaCoverage = ALPHA_COVERAGE_MASK;
+        } else if (*s != 255) {
+            return ALPHA_COVERAGE_BLEND;
+        }
+
+        s += sourceChannels;
+    }
+
+    return alphaCoverage;
+}
+
+bool isGray(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount)
+{
+    if (sourceChannels < 3) {
+        return true;
+    }
+
+    const uint8_t* s = source;
+
+    for (size_t p = 0; p < pixelCount; p++) {
+        if (s[0] != s[1] || s[0] != s[2]) {
+            return false;
+        }
+
+        s += sourceChannels;
+    }
+
+    return true;
+}
+
+bool compactPixels(uint8_t* pixels, uint32_t sourceChannels, size_t pixelCount, const std::vector<uint32_t>& channels)
+{
+    if (sourceChannels < 1 || sourceChannels > 4 || channels.empty() || channels.size() > sourceChannels) {
+        return false;
+    }
+
+    for (uint32_t channel : channels) {
+        if (channel >= sourceChannels) {
+            return false;
+        }
+    }
+
+    // A destination pixel never starts after its source pixel, so every pixel is read before it is overwritten
+    uint8_t* d = pixels;
+    const uint8_t* s = pixels;
+    uint8_t pixel[4];
+
+    for (size_t p = 0; p < pixelCount; p++) {
+        for (size_t i = 0; i < channels.size(); i++) {
+            pixel[i] = s[channels[i]];
+        }
+        memcpy(d, pixel, channels.size());
+
+        d += channels.size();
+        s += sourceChannels;
+    }
+
+    return true;
+}
+
+bool swizzleChannels(ImageDataResource& destination, const ImageDataResource& source, const std::vector<ChannelMove>& channelMoves)
+{
+    if (destination.width != source.width || destination.height != source.height) {
+        return false;
+    }
+
+    size_t pixelCount = static_cast<size_t>(destination.width) * static_cast<size_t>(destination.height);
+    if (destination.pixels.size() < pixelCount * destination.channels || source.pixels.size() < pixelCount * source.channels) {
+        return false;
+    }
+
+    return swizzlePixels(destination.pixels.data(), destination.channels, source.pixels.data(), source.channels, pixelCount, channelMoves);
+}
+
+bool fillChannels(ImageDataResource& destination, const std::vector<uint32_t>& channels, uint8_t value)
+{
+    size_t pixelCount = static_cast<size_t>(destination.width) * static_cast<size_t>(destination.height);
+    if (destination.pixels.size() < pixelCount * destination.channels) {
+        return false;
+    }
+
+    fillPixels(destination.pixels.data(), destination.channels, pixelCount, channels, value);
+
+    return true;
+}
+
+bool isUniformImage(const ImageDataResource& source, const std::vector<uint32_t>& channels)
+{
+    size_t pixelCount = static_cast<size_t>(source.width) * static_cast<size_t>(source.height);
+    if (source.pixels.size() < pixelCount * source.channels) {
+        return false;
+    }
+
+    return isUniform(source.pixels.data(), source.channels, pixelCount, channels);
+}
+
+AlphaCoverage getAlphaCoverageImage(const ImageDataResource& source, uint32_t channel)
+{
+    size_t pixelCount = static_cast<size_t>(source.width) * static_cast<size_t>(source.height);
+    if (source.pixels.size() < pixelCount * source.channels) {
+        return ALPHA_COVERAGE_BLEND;
+    }
+
+    return getAlphaCoverage(source.pixels.data(), source.channels, pixelCount, channel);
+}
+
+bool isGrayImage(const ImageDataResource& source)
+{
+    size_t pixelCount = static_cast<size_t>(source.width) * static_cast<size_t>(source.height);
+    if (source.pixels.size() < pixelCount * source.channels) {
+        return false;
+    }
+
+    return isGray(source.pixels.data(), source.channels, pixelCount);
+}
+
+bool compactChannels(ImageDataResource& image, const std::vector<uint32_t>& channels)
+{
+    size_t pixelCount = static_cast<size_t>(image.width) * static_cast<size_t>(image.height);
+    if (image.pixels.size() < pixelCount * image.channels) {
+        return false;
+    }
+
+    if (!compactPixels(image.pixels.data(), image.channels, pixelCount, channels)) {
+        return false;
+    }
+
+    image.channels = static_cast<uint32_t>(channels.size());
+
+    return true;
+}
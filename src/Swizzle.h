@@ -0,0 +1,56 @@
+#ifndef SWIZZLE_H_
+#define SWIZZLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Helper.h"
+
+// Content of an alpha channel: Only 255, only 0 and 255, or any values.
+enum AlphaCoverage {
+    ALPHA_COVERAGE_OPAQUE,
+    ALPHA_COVERAGE_MASK,
+    ALPHA_COVERAGE_BLEND
+};
+
+// Copies one channel of a source pixel to one channel of a destination pixel.
+struct ChannelMove {
+    uint32_t sourceChannel = 0;
+    uint32_t destinationChannel = 0;
+};
+
+// Applies the channel moves to pixelCount tightly packed pixels. Channels without a move keep their value.
+bool swizzlePixels(uint8_t* destination, uint32_t destinationChannels, const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const std::vector<ChannelMove>& channelMoves);
+
+// Sets the given channels of pixelCount tightly packed pixels to value.
+void fillPixels(uint8_t* destination, uint32_t destinationChannels, size_t pixelCount, const std::vector<uint32_t>& channels, uint8_t value);
+
+// Returns true, if the given channels have the same value in all pixelCount tightly packed pixels. The scan stops at the first differing pixel.
+// The constant values are the ones of the first pixel.
+bool isUniform(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, const std::vector<uint32_t>& channels);
+
+// Returns the coverage of the channel of pixelCount tightly packed pixels. The scan stops at the first value, which is neither 0 nor 255.
+AlphaCoverage getAlphaCoverage(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount, uint32_t channel);
+
+// Returns true, if the first three channels are equal in all pixelCount tightly packed pixels.
+bool isGray(const uint8_t* source, uint32_t sourceChannels, size_t pixelCount);
+
+// Keeps the given channels in the given order, so the pixels get tightly packed with fewer channels. Works in place.
+bool compactPixels(uint8_t* pixels, uint32_t sourceChannels, size_t pixelCount, const std::vector<uint32_t>& channels);
+
+// Both images need the same size and one to four channels.
+bool swizzleChannels(ImageDataResource& destination, const ImageDataResource& source, const std::vector<ChannelMove>& channelMoves);
+
+bool fillChannels(ImageDataResource& destination, const std::vector<uint32_t>& channels, uint8_t value);
+
+bool isUniformImage(const ImageDataResource& source, const std::vector<uint32_t>& channels);
+
+AlphaCoverage getAlphaCoverageImage(const ImageDataResource& source, uint32_t channel);
+
+bool isGrayImage(const ImageDataResource& source);
+
+// The pixel buffer keeps its size, only the channels of the image change.
+bool compactChannels(ImageDataResource& image, const std::vector<uint32_t>& channels);
+
+#endif /* SWIZZLE_H_ */
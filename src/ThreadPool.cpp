@@ -0,0 +1,245 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// Identifies the pool and queue of the calling worker thread, so tasks submitted from inside a task stay local.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local uint32_t currentIndex = 0;
+
+}
+
+ThreadPool::ThreadPool(uint32_t workerCount)
+{
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workQueues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::getWorkerCount() const
+{
+    return static_cast<uint32_t>(workers.size());
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    uint32_t index = 0;
+    if (currentPool == this) {
+        index = currentIndex;
+    } else {
+        index = nextQueue.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32_t>(workQueues.size());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        pendingCount++;
+        queuedCount++;
+
+        std::lock_guard<std::mutex> queueLock(workQueues[index]->mutex);
+        workQueues[index]->tasks.push_back(std::move(task));
+
+        // Helping workers only take tasks from their own queue, so they all have to check
+        if (helpingCount > 0) {
+            workCondition.notify_all();
+
+            return;
+        }
+    }
+    workCondition.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idleCondition.wait(lock, [this]() { return pendingCount == 0; });
+}
+
+void ThreadPool::waitUntil(const std::function<bool()>& done)
+{
+    uint32_t index = 0;
+    if (currentPool == this) {
+        index = currentIndex;
+    }
+
+    while (!done()) {
+        // Workers only help with their own queue, which keeps the nesting of waiting tasks bounded
+        std::function<void()> task;
+        if ((currentPool == this) ? popTask(task, index) : stealTask(task, index)) {
+            runTask(task);
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        helpingCount++;
+        workCondition.wait(lock, [this, &done, index]() { return done() || hasTask(index); });
+        helpingCount--;
+    }
+}
+
+bool ThreadPool::hasTask(uint32_t index)
+{
+    if (currentPool != this) {
+        return queuedCount > 0;
+    }
+
+    std::lock_guard<std::mutex> lock(workQueues[index]->mutex);
+
+    return !workQueues[index]->tasks.empty();
+}
+
+bool ThreadPool::popTask(std::function<void()>& task, uint32_t index)
+{
+    WorkQueue& workQueue = *workQueues[index];
+
+    std::lock_guard<std::mutex> lock(workQueue.mutex);
+    if (workQueue.tasks.empty()) {
+        return false;
+    }
+
+    task = std::move(workQueue.tasks.back());
+    workQueue.tasks.pop_back();
+    queuedCount--;
+
+    return true;
+}
+
+bool ThreadPool::stealTask(std::function<void()>& task, uint32_t index)
+{
+    // Callers outside of the pool do not own a queue, so every queue is visited
+    size_t start = (currentPool == this) ? 1 : 0;
+
+    for (size_t i = start; i < workQueues.size(); i++) {
+        WorkQueue& workQueue = *workQueues[(index + i) % workQueues.size()];
+
+        std::lock_guard<std::mutex> lock(workQueue.mutex);
+        if (workQueue.tasks.empty()) {
+            continue;
+        }
+
+        task = std::move(workQueue.tasks.front());
+        workQueue.tasks.pop_front();
+        queuedCount--;
+
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::runTask(std::function<void()>& task)
+{
+    // A throwing task must neither terminate the worker nor keep the pool from becoming idle
+    try {
+        task();
+    } catch (const std::exception& exception) {
+        printf("Error: Task failed: %s\n", exception.what());
+    } catch (...) {
+        printf("Error: Task failed\n");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingCount--;
+    if (pendingCount == 0) {
+        idleCondition.notify_all();
+    }
+    if (helpingCount > 0) {
+        workCondition.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(uint32_t index)
+{
+    currentPool = this;
+    currentIndex = index;
+
+    while (true) {
+        std::function<void()> task;
+        if (popTask(task, index) || stealTask(task, index)) {
+            runTask(task);
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        workCondition.wait(lock, [this]() { return stopping || queuedCount > 0; });
+        if (stopping && queuedCount == 0) {
+            return;
+        }
+    }
+}
+
+//
+
+TaskGroup::TaskGroup(ThreadPool& threadPool) :
+    threadPool(threadPool)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    // Exceptions can not leave the destructor, so they are only rethrown by an explicit wait
+    waitForTasks();
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+    pendingCount++;
+
+    threadPool.submit([this, task = std::move(task)]() {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(exceptionMutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+
+        pendingCount--;
+    });
+}
+
+void TaskGroup::wait()
+{
+    waitForTasks();
+
+    std::exception_ptr taskException;
+    {
+        std::lock_guard<std::mutex> lock(exceptionMutex);
+        std::swap(taskException, exception);
+    }
+
+    if (taskException) {
+        std::rethrow_exception(taskException);
+    }
+}
+
+void TaskGroup::waitForTasks()
+{
+    threadPool.waitUntil([this]() { return pendingCount == 0; });
+}
@@ -0,0 +1,94 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a queue, which it processes in LIFO order.
+// Idle workers steal the oldest task from the other queues.
+class ThreadPool {
+public:
+
+    // A worker count of zero uses all available hardware threads.
+    explicit ThreadPool(uint32_t workerCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t getWorkerCount() const;
+
+    void submit(std::function<void()> task);
+
+    // Blocks until all submitted tasks are finished.
+    void wait();
+
+    // Executes pending tasks until done returns true, so a task can wait for its own sub tasks.
+    void waitUntil(const std::function<bool()>& done);
+
+private:
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool hasTask(uint32_t index);
+    bool popTask(std::function<void()>& task, uint32_t index);
+    bool stealTask(std::function<void()>& task, uint32_t index);
+
+    void runTask(std::function<void()>& task);
+
+    void workerLoop(uint32_t index);
+
+    std::vector<std::unique_ptr<WorkQueue>> workQueues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable workCondition;
+    std::condition_variable idleCondition;
+
+    std::atomic<size_t> queuedCount{0};
+    std::atomic<uint32_t> nextQueue{0};
+    size_t pendingCount = 0;
+    size_t helpingCount = 0;
+    bool stopping = false;
+};
+
+// Group of tasks, which can be waited for independently of the other tasks of the pool.
+class TaskGroup {
+public:
+
+    explicit TaskGroup(ThreadPool& threadPool);
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+
+    // Helps executing tasks of the pool, until all tasks of this group are finished.
+    // The first exception thrown by a task of this group is rethrown.
+    void wait();
+
+private:
+
+    void waitForTasks();
+
+    ThreadPool& threadPool;
+
+    std::atomic<size_t> pendingCount{0};
+
+    std::mutex exceptionMutex;
+    std::exception_ptr exception;
+};
+
+#endif /* THREADPOOL_H_ */
@@ -0,0 +1,312 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Helper.h"
+
+namespace {
+
+struct TraceRecord {
+    const char* stage = "";
+    std::string subject = "";
+    uint64_t beginMicroseconds = 0;
+    uint64_t durationMicroseconds = 0;
+    uint32_t threadIndex = 0;
+
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t pixels = 0;
+    uint64_t peakResidentSize = 0;
+};
+
+std::atomic<bool> traceEnabled{false};
+
+std::mutex traceMutex;
+std::vector<TraceRecord> traceRecords;
+
+std::atomic<uint32_t> nextThreadIndex{0};
+
+std::chrono::steady_clock::time_point getTraceOrigin()
+{
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    return origin;
+}
+
+uint64_t getMicroseconds()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - getTraceOrigin()).count());
+}
+
+// Small index of the calling thread in the order the threads recorded their first span.
+uint32_t getThreadIndex()
+{
+    thread_local uint32_t threadIndex = nextThreadIndex++;
+
+    return threadIndex;
+}
+
+double toMebibytes(uint64_t byteCount)
+{
+    return static_cast<double>(byteCount) / (1024.0 * 1024.0);
+}
+
+// Name of the span in the trace viewer: The stage and the last part of the path.
+std::string getEventName(const TraceRecord& traceRecord)
+{
+    std::string name = fs::path(traceRecord.subject).filename().generic_string();
+    if (name.empty()) {
+        name = traceRecord.subject;
+    }
+
+    return std::string(traceRecord.stage) + " " + name;
+}
+
+}
+
+void enableTrace()
+{
+    getTraceOrigin();
+
+    traceEnabled = true;
+}
+
+bool isTraceEnabled()
+{
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+TraceSpan::TraceSpan(const char* stage, const std::string& subject)
+{
+    if (!isTraceEnabled()) {
+        return;
+    }
+
+    active = true;
+
+    this->stage = stage;
+    this->subject = subject;
+    beginMicroseconds = getMicroseconds();
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (!active) {
+        return;
+    }
+
+    TraceRecord traceRecord;
+    traceRecord.stage = stage;
+    traceRecord.subject = std::move(subject);
+    traceRecord.beginMicroseconds = beginMicroseconds;
+    traceRecord.durationMicroseconds = getMicroseconds() - beginMicroseconds;
+    traceRecord.threadIndex = getThreadIndex();
+    traceRecord.bytesRead = bytesRead;
+    traceRecord.bytesWritten = bytesWritten;
+    traceRecord.pixels = pixels;
+    traceRecord.peakResidentSize = getPeakResidentSize();
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceRecords.push_back(std::move(traceRecord));
+}
+
+void TraceSpan::addFileRead(const std::string& filename)
+{
+    if (!active) {
+        return;
+    }
+
+    std::error_code errorCode;
+    uintmax_t fileSize = fs::file_size(filename, errorCode);
+    if (!errorCode) {
+        bytesRead += static_cast<uint64_t>(fileSize);
+    }
+}
+
+void TraceSpan::addFileWritten(const std::string& filename)
+{
+    if (!active) {
+        return;
+    }
+
+    std::error_code errorCode;
+    uintmax_t fileSize = fs::file_size(filename, errorCode);
+    if (!errorCode) {
+        bytesWritten += static_cast<uint64_t>(fileSize);
+    }
+}
+
+void takeStageTotals(std::vector<StageTotal>& stageTotals)
+{
+    std::vector<TraceRecord> takenRecords;
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        takenRecords.swap(traceRecords);
+    }
+
+    std::stable_sort(takenRecords.begin(), takenRecords.end(), [](const TraceRecord& a, const TraceRecord& b) { return a.beginMicroseconds < b.beginMicroseconds; });
+
+    stageTotals.clear();
+
+    std::map<std::string, size_t> stageIndices;
+    for (const TraceRecord& traceRecord : takenRecords) {
+        auto it = stageIndices.find(traceRecord.stage);
+        if (it == stageIndices.end()) {
+            it = stageIndices.emplace(traceRecord.stage, stageTotals.size()).first;
+
+            StageTotal stageTotal;
+            stageTotal.stage = traceRecord.stage;
+            stageTotals.push_back(stageTotal);
+        }
+
+        StageTotal& stageTotal = stageTotals[it->second];
+        stageTotal.count++;
+        stageTotal.milliseconds += traceRecord.durationMicroseconds / 1000.0;
+    }
+}
+
+uint64_t getPeakResidentSize()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS processMemoryCounters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &processMemoryCounters, sizeof(processMemoryCounters))) {
+        return 0;
+    }
+
+    return static_cast<uint64_t>(processMemoryCounters.PeakWorkingSetSize);
+#else
+    struct rusage resourceUsage;
+    if (getrusage(RUSAGE_SELF, &resourceUsage) != 0) {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    return static_cast<uint64_t>(resourceUsage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(resourceUsage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void printTraceStats()
+{
+    std::vector<TraceRecord> sortedRecords;
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        sortedRecords = traceRecords;
+    }
+
+    std::stable_sort(sortedRecords.begin(), sortedRecords.end(), [](const TraceRecord& a, const TraceRecord& b) { return a.beginMicroseconds < b.beginMicroseconds; });
+
+    struct StageTotal {
+        size_t count = 0;
+        uint64_t durationMicroseconds = 0;
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t pixels = 0;
+    };
+
+    std::vector<std::string> stages;
+    std::map<std::string, StageTotal> stageTotals;
+
+    for (const TraceRecord& traceRecord : sortedRecords) {
+        printf("Stats: %s '%s' %.3f ms, %" PRIu64 " bytes read, %" PRIu64 " bytes written, %" PRIu64 " pixels, peak RSS %.1f MiB\n", traceRecord.stage, traceRecord.subject.c_str(), traceRecord.durationMicroseconds / 1000.0, traceRecord.bytesRead, traceRecord.bytesWritten, traceRecord.pixels, toMebibytes(traceRecord.peakResidentSize));
+
+        if (stageTotals.find(traceRecord.stage) == stageTotals.end()) {
+            stages.push_back(traceRecord.stage);
+        }
+
+        StageTotal& stageTotal = stageTotals[traceRecord.stage];
+        stageTotal.count++;
+        stageTotal.durationMicroseconds += traceRecord.durationMicroseconds;
+        stageTotal.bytesRead += traceRecord.bytesRead;
+        stageTotal.bytesWritten += traceRecord.bytesWritten;
+        stageTotal.pixels += traceRecord.pixels;
+    }
+
+    // Spans of parallel tasks overlap, so the summed time can exceed the wall time
+
+    for (const std::string& stage : stages) {
+        const StageTotal& stageTotal = stageTotals[stage];
+
+        printf("Stats: Total %s %.3f ms in %zu spans, %" PRIu64 " bytes read, %" PRIu64 " bytes written, %" PRIu64 " pixels\n", stage.c_str(), stageTotal.durationMicroseconds / 1000.0, stageTotal.count, stageTotal.bytesRead, stageTotal.bytesWritten, stageTotal.pixels);
+    }
+
+    printf("Stats: Peak RSS %.1f MiB\n", toMebibytes(getPeakResidentSize()));
+}
+
+bool saveTrace(const std::string& filename)
+{
+    std::vector<TraceRecord> records;
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        records = traceRecords;
+    }
+
+    json traceEvents = json::array();
+
+    json processName = json::object();
+    processName["name"] = "process_name";
+    processName["ph"] = "M";
+    processName["pid"] = 1;
+    processName["args"] = json::object({ { "name", "pbr2gltf2" } });
+    traceEvents.push_back(processName);
+
+    std::set<uint32_t> threadIndices;
+
+    for (const TraceRecord& traceRecord : records) {
+        json args = json::object();
+        args["subject"] = traceRecord.subject;
+        args["bytesRead"] = traceRecord.bytesRead;
+        args["bytesWritten"] = traceRecord.bytesWritten;
+        args["pixels"] = traceRecord.pixels;
+        args["peakResidentSize"] = traceRecord.peakResidentSize;
+
+        json traceEvent = json::object();
+        traceEvent["name"] = getEventName(traceRecord);
+        traceEvent["cat"] = traceRecord.stage;
+        traceEvent["ph"] = "X";
+        traceEvent["ts"] = traceRecord.beginMicroseconds;
+        traceEvent["dur"] = traceRecord.durationMicroseconds;
+        traceEvent["pid"] = 1;
+        traceEvent["tid"] = traceRecord.threadIndex;
+        traceEvent["args"] = args;
+        traceEvents.push_back(traceEvent);
+
+        threadIndices.insert(traceRecord.threadIndex);
+    }
+
+    for (uint32_t threadIndex : threadIndices) {
+        json threadName = json::object();
+        threadName["name"] = "thread_name";
+        threadName["ph"] = "M";
+        threadName["pid"] = 1;
+        threadName["tid"] = threadIndex;
+        threadName["args"] = json::object({ { "name", "thread " + std::to_string(threadIndex) } });
+        traceEvents.push_back(threadName);
+    }
+
+    json trace = json::object();
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = "ms";
+
+    return saveFile(trace.dump(), filename);
+}
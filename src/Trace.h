@@ -0,0 +1,81 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Enables recording of the spans. Has to be called before the first span is created.
+void enableTrace();
+
+bool isTraceEnabled();
+
+// Timed stage of one material or file, which also counts the bytes read and written and the pixels processed.
+// If tracing is disabled, a span costs one branch and records nothing.
+class TraceSpan {
+public:
+
+    TraceSpan(const char* stage, const std::string& subject);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    bool isActive() const
+    {
+        return active;
+    }
+
+    void addBytesRead(uint64_t byteCount)
+    {
+        bytesRead += byteCount;
+    }
+
+    void addBytesWritten(uint64_t byteCount)
+    {
+        bytesWritten += byteCount;
+    }
+
+    void addPixels(uint64_t pixelCount)
+    {
+        pixels += pixelCount;
+    }
+
+    // Counts the size of the file, if the span is active.
+    void addFileRead(const std::string& filename);
+    void addFileWritten(const std::string& filename);
+
+private:
+
+    bool active = false;
+
+    const char* stage = "";
+    std::string subject = "";
+    uint64_t beginMicroseconds = 0;
+
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t pixels = 0;
+};
+
+// Summed duration of the recorded spans of one stage. Spans of parallel tasks overlap, so the sum can exceed the wall time.
+struct StageTotal {
+    std::string stage = "";
+    size_t count = 0;
+    double milliseconds = 0.0;
+};
+
+// Returns the totals of the stages in the order they were first recorded and clears the recorded spans, so the next run
+// is measured on its own.
+void takeStageTotals(std::vector<StageTotal>& stageTotals);
+
+// Peak resident set size of the process in bytes or zero, if unknown.
+uint64_t getPeakResidentSize();
+
+// Prints the recorded spans in the order they started and the totals of each stage.
+void printTraceStats();
+
+// Saves the recorded spans in the Chrome trace event format.
+bool saveTrace(const std::string& filename);
+
+#endif /* TRACE_H_ */
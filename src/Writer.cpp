@@ -0,0 +1,362 @@
+#include "Writer.h"
+
+#include <atomic>
+#include <set>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Trace.h"
+
+namespace {
+
+std::atomic<uint64_t> nextTemporaryIndex{0};
+
+// Flushes the data of a written file to the disk.
+bool syncFileData(const std::string& filename)
+{
+#ifdef _WIN32
+    int fileDescriptor = _open(filename.c_str(), _O_WRONLY | _O_BINARY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    bool result = (_commit(fileDescriptor) == 0);
+    result = (_close(fileDescriptor) == 0) && result;
+#else
+    int fileDescriptor = open(filename.c_str(), O_WRONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    bool result = (fsync(fileDescriptor) == 0);
+    result = (close(fileDescriptor) == 0) && result;
+#endif
+
+    return result;
+}
+
+#ifdef __linux__
+// Starts writing the data of a file to the disk without waiting, so the following flush of a batch overlaps the writes of its files.
+void startFileWriteback(const std::string& filename)
+{
+    int fileDescriptor = open(filename.c_str(), O_WRONLY);
+    if (fileDescriptor < 0) {
+        return;
+    }
+
+    sync_file_range(fileDescriptor, 0, 0, SYNC_FILE_RANGE_WRITE);
+    close(fileDescriptor);
+}
+#endif
+
+// Flushes the renames in a folder. Windows has no folder handles for this, the renames are journaled there.
+void syncFolder(const std::string& folder)
+{
+#ifndef _WIN32
+    int fileDescriptor = open(folder.empty() ? "." : folder.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        return;
+    }
+
+    fsync(fileDescriptor);
+    close(fileDescriptor);
+#else
+    (void)folder;
+#endif
+}
+
+std::string getFolder(const std::string& filename)
+{
+    return fs::path(filename).parent_path().string();
+}
+
+bool renameFile(const std::string& temporaryFilename, const std::string& filename)
+{
+    std::error_code errorCode;
+    fs::rename(temporaryFilename, filename, errorCode);
+    if (errorCode) {
+        fs::remove(temporaryFilename, errorCode);
+
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+std::string getTemporaryFilename(const std::string& filename)
+{
+#ifdef _WIN32
+    int processId = _getpid();
+#else
+    int processId = static_cast<int>(getpid());
+#endif
+
+    return filename + "." + std::to_string(processId) + "-" + std::to_string(nextTemporaryIndex++) + ".tmp";
+}
+
+bool commitFile(const std::string& temporaryFilename, const std::string& filename, bool syncFile)
+{
+    if (syncFile && !syncFileData(temporaryFilename)) {
+        std::error_code errorCode;
+        fs::remove(temporaryFilename, errorCode);
+
+        return false;
+    }
+
+    if (!renameFile(temporaryFilename, filename)) {
+        return false;
+    }
+
+    if (syncFile) {
+        syncFolder(getFolder(filename));
+    }
+
+    return true;
+}
+
+bool saveSegmentsAtomically(const std::vector<DataSegment>& segments, const std::string& filename, bool syncFile)
+{
+    std::string temporaryFilename = getTemporaryFilename(filename);
+    if (!saveSegments(segments, temporaryFilename)) {
+        std::error_code errorCode;
+        fs::remove(temporaryFilename, errorCode);
+
+        return false;
+    }
+
+    return commitFile(temporaryFilename, filename, syncFile);
+}
+
+bool copyFileAtomically(const std::string& sourceFilename, const std::string& filename, bool syncFile)
+{
+    std::string temporaryFilename = getTemporaryFilename(filename);
+    if (!copyFile(sourceFilename, temporaryFilename)) {
+        std::error_code errorCode;
+        fs::remove(temporaryFilename, errorCode);
+
+        return false;
+    }
+
+    return commitFile(temporaryFilename, filename, syncFile);
+}
+
+//
+
+WriteGroup::~WriteGroup()
+{
+    // Queued jobs may point into memory of the material, so they have to be finished before it is released
+    std::string error;
+    wait(error);
+}
+
+bool WriteGroup::wait(std::string& error)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return pendingCount == 0; });
+
+    if (!firstError.empty()) {
+        error = firstError;
+
+        return false;
+    }
+
+    return true;
+}
+
+void WriteGroup::add()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingCount++;
+}
+
+void WriteGroup::complete(const std::string& error)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error.empty() && firstError.empty()) {
+        firstError = error;
+    }
+
+    pendingCount--;
+    if (pendingCount == 0) {
+        doneCondition.notify_all();
+    }
+}
+
+//
+
+OutputWriter::OutputWriter(uint32_t queueDepth, bool syncFiles) :
+    queueDepth(queueDepth > 0 ? static_cast<size_t>(queueDepth) : 1), syncFiles(syncFiles)
+{
+    writer = std::thread(&OutputWriter::writerLoop, this);
+}
+
+OutputWriter::~OutputWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobCondition.notify_all();
+
+    writer.join();
+}
+
+bool OutputWriter::isSyncing() const
+{
+    return syncFiles;
+}
+
+void OutputWriter::write(WriteGroup& writeGroup, const std::string& filename, std::vector<DataSegment> segments, EncodedData data)
+{
+    WriteJob writeJob;
+    writeJob.writeGroup = &writeGroup;
+    writeJob.filename = filename;
+    writeJob.segments = std::move(segments);
+    // Moving the parts keeps their buffers, so the segments stay valid
+    writeJob.data = std::move(data);
+
+    push(std::move(writeJob));
+}
+
+void OutputWriter::copy(WriteGroup& writeGroup, const std::string& sourceFilename, const std::string& filename)
+{
+    WriteJob writeJob;
+    writeJob.writeGroup = &writeGroup;
+    writeJob.filename = filename;
+    writeJob.sourceFilename = sourceFilename;
+    writeJob.copySource = true;
+
+    push(std::move(writeJob));
+}
+
+void OutputWriter::commit(WriteGroup& writeGroup, const std::string& temporaryFilename, const std::string& filename)
+{
+    WriteJob writeJob;
+    writeJob.writeGroup = &writeGroup;
+    writeJob.filename = filename;
+    writeJob.sourceFilename = temporaryFilename;
+
+    push(std::move(writeJob));
+}
+
+void OutputWriter::push(WriteJob&& writeJob)
+{
+    writeJob.writeGroup->add();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        spaceCondition.wait(lock, [this] { return writeJobs.size() < queueDepth; });
+
+        writeJobs.push_back(std::move(writeJob));
+    }
+    jobCondition.notify_one();
+}
+
+void OutputWriter::writeBatch(std::vector<WriteJob>& batchJobs)
+{
+    for (WriteJob& writeJob : batchJobs) {
+        TraceSpan writeSpan("write", writeJob.filename);
+
+        if (!writeJob.copySource && writeJob.sourceFilename.empty()) {
+            writeJob.temporaryFilename = getTemporaryFilename(writeJob.filename);
+            if (!saveSegments(writeJob.segments, writeJob.temporaryFilename)) {
+                writeJob.error = "Could not save '" + writeJob.filename + "'";
+            }
+        } else if (writeJob.copySource) {
+            writeJob.temporaryFilename = getTemporaryFilename(writeJob.filename);
+            if (!copyFile(writeJob.sourceFilename, writeJob.temporaryFilename)) {
+                writeJob.error = "Could not copy '" + writeJob.sourceFilename + "' to '" + writeJob.filename + "'";
+            }
+        } else {
+            writeJob.temporaryFilename = writeJob.sourceFilename;
+        }
+
+        writeSpan.addFileWritten(writeJob.temporaryFilename);
+
+        // The memory of the job is not needed anymore, so it is released before the batch is synced
+        writeJob.segments.clear();
+        writeJob.data.parts.clear();
+    }
+
+    std::set<std::string> folders;
+
+    if (syncFiles) {
+        TraceSpan syncSpan("sync", std::to_string(batchJobs.size()) + " files");
+
+#ifdef __linux__
+        for (const WriteJob& writeJob : batchJobs) {
+            if (writeJob.error.empty()) {
+                startFileWriteback(writeJob.temporaryFilename);
+            }
+        }
+#endif
+
+        // Each file is flushed before its rename, so a crash leaves either the old or the complete new file
+        for (WriteJob& writeJob : batchJobs) {
+            if (writeJob.error.empty() && !syncFileData(writeJob.temporaryFilename)) {
+                writeJob.error = "Could not sync '" + writeJob.filename + "'";
+            }
+        }
+    }
+
+    for (WriteJob& writeJob : batchJobs) {
+        if (!writeJob.error.empty()) {
+            std::error_code errorCode;
+            fs::remove(writeJob.temporaryFilename, errorCode);
+
+            continue;
+        }
+
+        if (!renameFile(writeJob.temporaryFilename, writeJob.filename)) {
+            writeJob.error = "Could not rename '" + writeJob.temporaryFilename + "' to '" + writeJob.filename + "'";
+
+            continue;
+        }
+
+        folders.insert(getFolder(writeJob.filename));
+    }
+
+    // The renames of the batch are flushed once per folder
+    if (syncFiles) {
+        for (const std::string& folder : folders) {
+            syncFolder(folder);
+        }
+    }
+
+    for (WriteJob& writeJob : batchJobs) {
+        writeJob.writeGroup->complete(writeJob.error);
+    }
+}
+
+void OutputWriter::writerLoop()
+{
+    while (true) {
+        std::vector<WriteJob> batchJobs;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobCondition.wait(lock, [this] { return !writeJobs.empty() || stopping; });
+
+            if (writeJobs.empty()) {
+                return;
+            }
+
+            // Jobs queued while the previous batch was written form the next batch
+            while (!writeJobs.empty()) {
+                batchJobs.push_back(std::move(writeJobs.front()));
+                writeJobs.pop_front();
+            }
+        }
+        spaceCondition.notify_all();
+
+        writeBatch(batchJobs);
+    }
+}
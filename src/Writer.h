@@ -0,0 +1,108 @@
+#ifndef WRITER_H_
+#define WRITER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Helper.h"
+
+// Unique name next to the file, which the file is written to, before it is renamed to its final name.
+std::string getTemporaryFilename(const std::string& filename);
+
+// Renames the temporary file to its final name, replacing an existing file. The temporary file is removed on failure.
+bool commitFile(const std::string& temporaryFilename, const std::string& filename, bool syncFile);
+
+// Writes the segments to a temporary file and renames it, so a reader never sees a partial file.
+bool saveSegmentsAtomically(const std::vector<DataSegment>& segments, const std::string& filename, bool syncFile);
+
+bool copyFileAtomically(const std::string& sourceFilename, const std::string& filename, bool syncFile);
+
+// Files of one material, which are queued to the writer. The destructor waits for them.
+class WriteGroup {
+public:
+
+    WriteGroup() = default;
+    ~WriteGroup();
+
+    WriteGroup(const WriteGroup&) = delete;
+    WriteGroup& operator=(const WriteGroup&) = delete;
+
+    // Blocks until all queued files are written and returns the first error.
+    bool wait(std::string& error);
+
+private:
+
+    friend class OutputWriter;
+
+    void add();
+    void complete(const std::string& error);
+
+    std::mutex mutex;
+    std::condition_variable doneCondition;
+    size_t pendingCount = 0;
+    std::string firstError = "";
+};
+
+// Writer stage with its own thread, which takes the encoded outputs from a bounded queue, so the workers continue encoding
+// while the files are written. Each file is written to a temporary name and renamed. All files queued at once form a batch,
+// which is synced together before the renames, if syncing is enabled.
+class OutputWriter {
+public:
+
+    // The queue holds up to queueDepth files, before queuing blocks. Zero allows one file.
+    OutputWriter(uint32_t queueDepth, bool syncFiles);
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    bool isSyncing() const;
+
+    // Queues the segments, which may point into the given data or into memory valid until the group is waited for.
+    void write(WriteGroup& writeGroup, const std::string& filename, std::vector<DataSegment> segments, EncodedData data = EncodedData());
+
+    // Queues a copy of a file e.g. a kept image, which is passed through.
+    void copy(WriteGroup& writeGroup, const std::string& sourceFilename, const std::string& filename);
+
+    // Queues the rename of a temporary file, which the caller has written e.g. a streamed image.
+    void commit(WriteGroup& writeGroup, const std::string& temporaryFilename, const std::string& filename);
+
+private:
+
+    struct WriteJob {
+        WriteGroup* writeGroup = nullptr;
+        std::string filename = "";
+        std::vector<DataSegment> segments;
+        EncodedData data;
+        // Copied file or written temporary file instead of the segments
+        std::string sourceFilename = "";
+        bool copySource = false;
+
+        std::string temporaryFilename = "";
+        std::string error = "";
+    };
+
+    void push(WriteJob&& writeJob);
+
+    void writeBatch(std::vector<WriteJob>& writeJobs);
+
+    void writerLoop();
+
+    size_t queueDepth = 1;
+    bool syncFiles = false;
+
+    std::mutex mutex;
+    std::condition_variable jobCondition;
+    std::condition_variable spaceCondition;
+    std::deque<WriteJob> writeJobs;
+    bool stopping = false;
+
+    std::thread writer;
+};
+
+#endif /* WRITER_H_ */
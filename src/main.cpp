@@ -1,663 +1,382 @@
 #include <algorithm>
 #include <cstdio>
-#include <fstream>
+#include <cstring>
+#include <exception>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
-#include <nlohmann/json.hpp>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
-#ifdef __APPLE__
-#include <Availability.h> // for deployment target to support pre-catalina targets without std::fs
-#endif
-#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || (defined(__cplusplus) && __cplusplus >= 201703L)) && defined(__has_include)
-#if __has_include(<filesystem>) && (!defined(__MAC_OS_X_VERSION_MIN_REQUIRED) || __MAC_OS_X_VERSION_MIN_REQUIRED >= 101500)
-#define GHC_USE_STD_FS
-#include <filesystem>
-namespace fs = std::filesystem;
-#endif
-#endif
-#ifndef GHC_USE_STD_FS
-#include <ghc/filesystem.hpp>
-namespace fs = ghc::filesystem;
-#endif
-
-using json = nlohmann::json;
-
-struct DecomposedPath {
-    std::string parentPath = "";
-    std::string stem = "";
-    std::string extension = "";
-};
-
-struct ImageDataResource {
-    std::vector<uint8_t> pixels;
-    uint32_t width = 0;
-    uint32_t height = 0;
-    uint32_t channels = 0;
-};
-
-float clampf(float x, float minVal, float maxVal)
-{
-    float t = (x > minVal) ? x : minVal;
-
-    return (t < maxVal) ? t : maxVal;
-}
-
-std::string toLowercase(const std::string& input)
-{
-    std::string result = input;
-    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
-    return result;
-}
-
-void decomposePath(DecomposedPath& decomposedPath, const std::string& path)
-{
-    fs::path filesystemPath(path);
-
-    decomposedPath.parentPath = filesystemPath.parent_path().generic_string();
-    decomposedPath.stem = filesystemPath.stem().generic_string();
-    decomposedPath.extension = filesystemPath.extension().generic_string();
-}
-
-bool loadImage(ImageDataResource& imageDataResource, const std::string& filename)
-{
-    DecomposedPath decomposedPath;
-    decomposePath(decomposedPath, filename);
-
-    int x = 0;
-    int y = 0;
-    int comp = 0;
-    int req_comp = 0;
-
-    uint8_t* tempData = static_cast<uint8_t*>(stbi_load(filename.c_str(), &x, &y, &comp, req_comp));
-    if (!tempData) {
-        return false;
-    }
-
-    imageDataResource.width = static_cast<uint32_t>(x);
-    imageDataResource.height = static_cast<uint32_t>(y);
-    imageDataResource.channels = static_cast<uint32_t>(comp);
-    imageDataResource.pixels.resize(imageDataResource.width * imageDataResource.height * imageDataResource.channels);
-    memcpy(imageDataResource.pixels.data(), tempData, imageDataResource.width * imageDataResource.height * imageDataResource.channels);
-
-    free(tempData);
-
-    return true;
-}
-
-bool loadFile(std::string& output, const std::string& filename)
-{
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        return false;
-    }
-
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    file.seekg(0);
-
-    output.resize(fileSize);
-
-    file.read(output.data(), fileSize);
-    file.close();
-
-    return true;
-}
-
-bool saveFile(const std::string& output, const std::string& filename)
-{
-    std::ofstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        return false;
-    }
-
-    file.write(output.data(), output.size());
-    file.close();
-
-    return true;
-}
-
-size_t gatherStem(const std::string& stem)
-{
-    size_t result = std::string::npos;
-
-    result = toLowercase(stem).find("_color");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_base_color");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_basecolor");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_base color");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_opacity");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_metallic");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_roughness");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_rough");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_ao");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_ambientocclusion");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_normal");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_nor");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    result = toLowercase(stem).find("_emissive");
-    if (result != std::string::npos) {
-        return result;
-    }
-
-    return result;
-}
+#include "Archive.h"
+#include "Batch.h"
+#include "Classifier.h"
+#include "Converter.h"
+#include "Dedup.h"
+#include "Helper.h"
+#include "MemoryBudget.h"
+#include "Server.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "Writer.h"
 
 int main(int argc, char* argv[])
 {
     if (argc <= 1) {
-        printf("Usage: pbr2gltf2 folder [-m 1.0 -r 1.0 -n true -e true]\n");
+        printf("Usage: pbr2gltf2 folder [-m 1.0 -r 1.0 -c true -n true -e true -b false -j 0 -s summary.json --stream 0 -z 6 --png-encoder deflate -g false --cache false --dedup off -f true --lod 0 --ktx2 off --stats false --trace trace.json --serve stdin --queue 0 --rules default --passthrough copy -o folder --fsync false --split off --mem-budget 0]\n");
 
         return 0;
     }
 
     //
 
-    float defaultMetallicFactor = 1.0f;
-    float defaultRoughnessFactor = 1.0f;
-    bool keepNormalImageData = true;
-    bool keepEmissiveImageData = true;
+    ConvertOptions convertOptions;
+    BatchOptions batchOptions;
+    ServeOptions serveOptions;
+
+    bool batch = false;
+    bool writeStandardOutput = false;
+    bool printStats = false;
+    bool serveJobs = false;
+    bool syncFiles = false;
+    std::string tracePath = "";
+    std::string rulesName = "";
+    uint64_t memoryBudgetSize = 0;
+    DedupMode dedupMode = DEDUP_MODE_OFF;
 
     for (int i = 0; i < argc; i++) {
         if (strcmp(argv[i], "-m") == 0 && (i + 1 < argc)) {
-            defaultMetallicFactor = clampf(std::stof(argv[i + 1]), 0.0f, 1.0f);
+            convertOptions.defaultMetallicFactor = clampf(std::stof(argv[i + 1]), 0.0f, 1.0f);
         } else if (strcmp(argv[i], "-r") == 0 && (i + 1 < argc)) {
-            defaultRoughnessFactor = clampf(std::stof(argv[i + 1]), 0.0f, 1.0f);
+            convertOptions.defaultRoughnessFactor = clampf(std::stof(argv[i + 1]), 0.0f, 1.0f);
+        } else if (strcmp(argv[i], "-c") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "true") == 0) {
+                convertOptions.keepBaseColorImageData = true;
+            } else if (strcmp(argv[i + 1], "false") == 0) {
+                convertOptions.keepBaseColorImageData = false;
+            }
         } else if (strcmp(argv[i], "-n") == 0 && (i + 1 < argc)) {
             if (strcmp(argv[i + 1], "true") == 0) {
-                keepNormalImageData = true;
+                convertOptions.keepNormalImageData = true;
             } else if (strcmp(argv[i + 1], "false") == 0) {
-                keepNormalImageData = false;
+                convertOptions.keepNormalImageData = false;
             }
         } else if (strcmp(argv[i], "-e") == 0 && (i + 1 < argc)) {
             if (strcmp(argv[i + 1], "true") == 0) {
-                keepEmissiveImageData = true;
+                convertOptions.keepEmissiveImageData = true;
             } else if (strcmp(argv[i + 1], "false") == 0) {
-                keepEmissiveImageData = false;
+                convertOptions.keepEmissiveImageData = false;
             }
-        }
-    }
-
-    //
-
-    std::string stem = "pbr";
-
-    json glTF = json::object();
-
-    json asset = json::object();
-    asset["version"] = "2.0";
-    asset["generator"] = "pbr2gltf2 by UX3D";
-
-    glTF["asset"] = asset;
-
-    json images = json::array();
-    json textures = json::array();
-    json materials = json::array();
-
-    json material = json::object();
-    json pbrMetallicRoughness = json::object();
-
-    //
-
-    bool init = true;
-
-    bool writeBaseColor = false;
-    bool writeOpacity = false;
-    bool writeMetallic = false;
-    bool writeRoughness = false;
-    bool writeOcclusion = false;
-    bool writeNormal = false;
-    bool writeEmissive = false;
-
-    ImageDataResource baseColorImage;
-
-    ImageDataResource metallicRoughnessImage;
-
-    ImageDataResource normalImage;
-
-    std::string normalImageRaw;
-    std::string normalImageRawExtension;
-
-    ImageDataResource emissiveImage;
-
-    std::string emissiveImageRaw;
-    std::string emissiveImageRawExtension;
-
-    std::string path = argv[1];
-    for (const auto& directoryEntry : fs::directory_iterator(path)) {
-        std::string filename = directoryEntry.path().generic_string();
-
-        printf("Info: Processing '%s'\n", filename.c_str());
-
-        DecomposedPath decomposedPath;
-        decomposePath(decomposedPath, filename);
-
-        std::string lowercaseExtension = toLowercase(decomposedPath.extension);
-        if (!(lowercaseExtension == ".png" || lowercaseExtension == ".jpg" || lowercaseExtension == ".jpeg")) {
-            continue;
-        }
-
-        ImageDataResource imageDataResource;
-        if (!loadImage(imageDataResource, filename)) {
-            printf("Warning: Skipping image '%s' because could not load size\n", filename.c_str());
-
-            continue;
-        }
-
-        if (init) {
-            auto it = gatherStem(decomposedPath.stem);
-            if (it != std::string::npos) {
-                stem = decomposedPath.stem.substr(0, it);
+        } else if (strcmp(argv[i], "-b") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "true") == 0) {
+                batch = true;
+            } else if (strcmp(argv[i + 1], "false") == 0) {
+                batch = false;
             }
-
-            //
-
-            baseColorImage.width = imageDataResource.width;
-            baseColorImage.height = imageDataResource.height;
-            baseColorImage.channels = 4;
-            baseColorImage.pixels.resize(baseColorImage.channels * baseColorImage.width * baseColorImage.height);
-
-            for (size_t y = 0; y < baseColorImage.height; y++) {
-                for (size_t x = 0; x < baseColorImage.width; x++) {
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 0] = 255;
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 1] = 255;
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 2] = 255;
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 3] = 255;
-                }
+        } else if (strcmp(argv[i], "-j") == 0 && (i + 1 < argc)) {
+            batchOptions.workerCount = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "-s") == 0 && (i + 1 < argc)) {
+            batchOptions.summaryPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--stream") == 0 && (i + 1 < argc)) {
+            convertOptions.bandHeight = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "-z") == 0 && (i + 1 < argc)) {
+            convertOptions.pngOptions.compressionLevel = std::min(std::max(std::stoi(argv[i + 1]), 0), 9);
+        } else if (strcmp(argv[i], "--png-encoder") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "deflate") == 0) {
+                convertOptions.pngOptions.pngEncoder = PNG_ENCODER_DEFLATE;
+            } else if (strcmp(argv[i + 1], "stb") == 0) {
+                convertOptions.pngOptions.pngEncoder = PNG_ENCODER_STB;
             }
-
-            //
-
-            metallicRoughnessImage.width = imageDataResource.width;
-            metallicRoughnessImage.height = imageDataResource.height;
-            metallicRoughnessImage.channels = 4;
-            metallicRoughnessImage.pixels.resize(metallicRoughnessImage.channels * metallicRoughnessImage.width * metallicRoughnessImage.height);
-
-            for (size_t y = 0; y < metallicRoughnessImage.height; y++) {
-                for (size_t x = 0; x < metallicRoughnessImage.width; x++) {
-                    metallicRoughnessImage.pixels.data()[y * metallicRoughnessImage.width * metallicRoughnessImage.channels + x * metallicRoughnessImage.channels + 0] = 255;
-                    metallicRoughnessImage.pixels.data()[y * metallicRoughnessImage.width * metallicRoughnessImage.channels + x * metallicRoughnessImage.channels + 1] = 255;
-                    metallicRoughnessImage.pixels.data()[y * metallicRoughnessImage.width * metallicRoughnessImage.channels + x * metallicRoughnessImage.channels + 2] = 255;
-                    metallicRoughnessImage.pixels.data()[y * metallicRoughnessImage.width * metallicRoughnessImage.channels + x * metallicRoughnessImage.channels + 3] = 255;
-                }
+        } else if (strcmp(argv[i], "-g") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "true") == 0) {
+                convertOptions.saveBinary = true;
+            } else if (strcmp(argv[i + 1], "false") == 0) {
+                convertOptions.saveBinary = false;
+            } else if (strcmp(argv[i + 1], "stdout") == 0) {
+                convertOptions.saveBinary = true;
+                writeStandardOutput = true;
             }
-
-            if (keepNormalImageData) {
-                // Keeping original byte date
-            } else {
-                normalImage.width = imageDataResource.width;
-                normalImage.height = imageDataResource.height;
-                normalImage.channels = 3;
-                normalImage.pixels.resize(normalImage.channels * normalImage.width * normalImage.height);
-
-                // Not required for normal map
+        } else if (strcmp(argv[i], "--cache") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "true") == 0) {
+                convertOptions.useCache = true;
+            } else if (strcmp(argv[i + 1], "false") == 0) {
+                convertOptions.useCache = false;
             }
-
-            if (keepEmissiveImageData) {
-                // Keeping original byte date
-            } else {
-                emissiveImage.width = imageDataResource.width;
-                emissiveImage.height = imageDataResource.height;
-                emissiveImage.channels = 3;
-                emissiveImage.pixels.resize(emissiveImage.channels * emissiveImage.width * emissiveImage.height);
-
-                // Not required for normal map
+        } else if (strcmp(argv[i], "--dedup") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "off") == 0) {
+                dedupMode = DEDUP_MODE_OFF;
+            } else if (strcmp(argv[i + 1], "reference") == 0) {
+                dedupMode = DEDUP_MODE_REFERENCE;
+            } else if (strcmp(argv[i + 1], "hardlink") == 0) {
+                dedupMode = DEDUP_MODE_HARDLINK;
             }
-
-            //
-
-            init = false;
-        } else {
-            if ((imageDataResource.width != baseColorImage.width) || (imageDataResource.height != baseColorImage.height)) {
-                printf("Warning: Skipping image '%s' because of size\n", filename.c_str());
-
-                continue;
+        } else if (strcmp(argv[i], "-f") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "true") == 0) {
+                convertOptions.foldConstants = true;
+            } else if (strcmp(argv[i + 1], "false") == 0) {
+                convertOptions.foldConstants = false;
             }
-        }
-
-        //
-
-        bool hasBaseColor = ((toLowercase(filename).find("_color.") != std::string::npos) || (toLowercase(filename).find("_base_color.") != std::string::npos) || (toLowercase(filename).find("_basecolor.") != std::string::npos) || (toLowercase(filename).find("_base color.") != std::string::npos));
-        if (hasBaseColor) {
-            for (size_t y = 0; y < baseColorImage.height; y++) {
-                for (size_t x = 0; x < baseColorImage.width; x++) {
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 0] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 0];
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 1] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 1];
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 2] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 2];
-                }
+        } else if (strcmp(argv[i], "--lod") == 0 && (i + 1 < argc)) {
+            convertOptions.lodCount = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "--ktx2") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "off") == 0) {
+                convertOptions.saveKtx2 = false;
+            } else if (strcmp(argv[i + 1], "fast") == 0) {
+                convertOptions.saveKtx2 = true;
+                convertOptions.bc7Quality = BC7_QUALITY_FAST;
+            } else if (strcmp(argv[i + 1], "normal") == 0) {
+                convertOptions.saveKtx2 = true;
+                convertOptions.bc7Quality = BC7_QUALITY_NORMAL;
+            } else if (strcmp(argv[i + 1], "slow") == 0) {
+                convertOptions.saveKtx2 = true;
+                convertOptions.bc7Quality = BC7_QUALITY_SLOW;
             }
-
-            printf("Info: Found base color\n");
-
-            writeBaseColor = true;
-        }
-
-        bool hasOpacity = (toLowercase(filename).find("_opacity.") != std::string::npos);
-        if (hasOpacity) {
-            for (size_t y = 0; y < baseColorImage.height; y++) {
-                for (size_t x = 0; x < baseColorImage.width; x++) {
-                    baseColorImage.pixels.data()[y * baseColorImage.width * baseColorImage.channels + x * baseColorImage.channels + 3] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 0];
-                }
+        } else if (strcmp(argv[i], "--stats") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "true") == 0) {
+                printStats = true;
+            } else if (strcmp(argv[i + 1], "false") == 0) {
+                printStats = false;
             }
-
-            printf("Info: Found alpha\n");
-
-            writeOpacity = true;
-        }
-
-        bool hasMetallic = (toLowercase(filename).find("_metallic.") != std::string::npos);
-        if (hasMetallic) {
-            for (size_t y = 0; y < metallicRoughnessImage.height; y++) {
-                for (size_t x = 0; x < metallicRoughnessImage.width; x++) {
-                    metallicRoughnessImage.pixels.data()[y * metallicRoughnessImage.width * metallicRoughnessImage.channels + x * metallicRoughnessImage.channels + 2] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 0];
-                }
+        } else if (strcmp(argv[i], "--trace") == 0 && (i + 1 < argc)) {
+            tracePath = argv[i + 1];
+        } else if (strcmp(argv[i], "--serve") == 0 && (i + 1 < argc)) {
+            serveJobs = true;
+            if (strcmp(argv[i + 1], "stdin") == 0) {
+                serveOptions.socketPath = "";
+            } else {
+                serveOptions.socketPath = argv[i + 1];
             }
-
-            printf("Info: Found metallic\n");
-
-            writeMetallic = true;
-        }
-
-        bool hasRoughness = ((toLowercase(filename).find("_roughness.") != std::string::npos) || (toLowercase(filename).find("_rough_") != std::string::npos));
-        if (hasRoughness) {
-            for (size_t y = 0; y < metallicRoughnessImage.height; y++) {
-                for (size_t x = 0; x < metallicRoughnessImage.width; x++) {
-                    metallicRoughnessImage.pixels.data()[y * metallicRoughnessImage.width * metallicRoughnessImage.channels + x * metallicRoughnessImage.channels + 1] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 0];
-                }
+        } else if (strcmp(argv[i], "--queue") == 0 && (i + 1 < argc)) {
+            serveOptions.queueDepth = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else if (strcmp(argv[i], "--rules") == 0 && (i + 1 < argc)) {
+            rulesName = argv[i + 1];
+        } else if (strcmp(argv[i], "--passthrough") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "copy") == 0) {
+                convertOptions.passthroughMode = PASSTHROUGH_MODE_COPY;
+            } else if (strcmp(argv[i + 1], "hardlink") == 0) {
+                convertOptions.passthroughMode = PASSTHROUGH_MODE_HARDLINK;
             }
-
-            printf("Info: Found roughness\n");
-
-            writeRoughness = true;
-        }
-
-        bool hasOcclusion = ((toLowercase(filename).find("_ao.") != std::string::npos) || (toLowercase(filename).find("_ambientocclusion.") != std::string::npos) || (toLowercase(filename).find("_ao_") != std::string::npos));
-        if (hasOcclusion) {
-            for (size_t y = 0; y < metallicRoughnessImage.height; y++) {
-                for (size_t x = 0; x < metallicRoughnessImage.width; x++) {
-                    metallicRoughnessImage.pixels.data()[y * metallicRoughnessImage.width * metallicRoughnessImage.channels + x * metallicRoughnessImage.channels + 0] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 0];
-                }
+        } else if (strcmp(argv[i], "-o") == 0 && (i + 1 < argc)) {
+            convertOptions.outputFolder = argv[i + 1];
+        } else if (strcmp(argv[i], "--split") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "off") == 0) {
+                batchOptions.splitMode = SPLIT_MODE_OFF;
+            } else if (strcmp(argv[i + 1], "separate") == 0) {
+                batchOptions.splitMode = SPLIT_MODE_SEPARATE;
+            } else if (strcmp(argv[i + 1], "shared") == 0) {
+                batchOptions.splitMode = SPLIT_MODE_SHARED;
             }
+        } else if (strcmp(argv[i], "--fsync") == 0 && (i + 1 < argc)) {
+            if (strcmp(argv[i + 1], "true") == 0) {
+                syncFiles = true;
+            } else if (strcmp(argv[i + 1], "false") == 0) {
+                syncFiles = false;
+            }
+        } else if (strcmp(argv[i], "--mem-budget") == 0 && (i + 1 < argc)) {
+            if (!parseByteCount(memoryBudgetSize, argv[i + 1])) {
+                printf("Error: Invalid memory budget '%s'\n", argv[i + 1]);
 
-            printf("Info: Found occlusion\n");
-
-            writeOcclusion = true;
+                return -1;
+            }
         }
+    }
 
-        bool hasNormal = ((toLowercase(filename).find("_normal.") != std::string::npos) || (toLowercase(filename).find("_nor_") != std::string::npos));
-        if (hasNormal) {
-            if (keepNormalImageData) {
-                if (!loadFile(normalImageRaw, filename)) {
-                    printf("Error: Could not load image raw '%s'\n", filename.c_str());
-
-                    return -1;
-                }
-
-                normalImageRawExtension = decomposedPath.extension;
-            } else {
-                for (size_t y = 0; y < normalImage.height; y++) {
-                    for (size_t x = 0; x < normalImage.width; x++) {
-                        normalImage.pixels.data()[y * normalImage.width * normalImage.channels + x * normalImage.channels + 0] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 0];
-                        normalImage.pixels.data()[y * normalImage.width * normalImage.channels + x * normalImage.channels + 1] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 1];
-                        normalImage.pixels.data()[y * normalImage.width * normalImage.channels + x * normalImage.channels + 2] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 2];
-                    }
-                }
-            }
+    // Images are classified by the rules of a preset or a rules file
 
-            printf("Info: Found normal\n");
+    if (!rulesName.empty()) {
+        std::string error;
+        if (!loadClassifierRules(error, rulesName)) {
+            printf("Error: %s\n", error.c_str());
 
-            writeNormal = true;
+            return -1;
         }
+    }
 
-        bool hasEmissive = (toLowercase(filename).find("_emissive.") != std::string::npos);
-        if (hasEmissive) {
-            if (keepEmissiveImageData) {
-                if (!loadFile(emissiveImageRaw, filename)) {
-                    printf("Error: Could not load image raw '%s'\n", filename.c_str());
+    // stb_image_write only supports a global compression level
 
-                    return -1;
-                }
+    stbi_write_png_compression_level = std::max(convertOptions.pngOptions.compressionLevel, 1);
 
-                emissiveImageRawExtension = decomposedPath.extension;
-            } else {
-                for (size_t y = 0; y < emissiveImage.height; y++) {
-                    for (size_t x = 0; x < emissiveImage.width; x++) {
-                        emissiveImage.pixels.data()[y * emissiveImage.width * emissiveImage.channels + x * emissiveImage.channels + 0] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 0];
-                        emissiveImage.pixels.data()[y * emissiveImage.width * emissiveImage.channels + x * emissiveImage.channels + 1] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 1];
-                        emissiveImage.pixels.data()[y * emissiveImage.width * emissiveImage.channels + x * emissiveImage.channels + 2] = imageDataResource.pixels.data()[y * imageDataResource.width * imageDataResource.channels + x * imageDataResource.channels + 2];
-                    }
-                }
-            }
+    // Levels of detail are downscaled from the images in memory and are saved as separate files
 
-            printf("Info: Found emissive\n");
+    if (convertOptions.lodCount > 0) {
+        if (convertOptions.bandHeight > 0) {
+            printf("Warning: Levels of detail are not created in streaming mode\n");
+            convertOptions.lodCount = 0;
+        } else if (writeStandardOutput) {
+            printf("Error: Levels of detail can not be written to standard output\n");
 
-            writeEmissive = true;
+            return -1;
+        } else if (convertOptions.useCache) {
+            printf("Warning: Cache is not used with levels of detail\n");
+            convertOptions.useCache = false;
         }
     }
 
-    if (writeBaseColor || writeOpacity) {
-        std::string imagePath = stem + "_baseColor.png";
-        if (!stbi_write_png(imagePath.c_str(), baseColorImage.width, baseColorImage.height, baseColorImage.channels, baseColorImage.pixels.data(), 0)) {
-            printf("Error: Could not save image '%s'\n", imagePath.c_str());
+    // KTX2 copies are encoded from the images in memory
 
-            return -1;
+    if (convertOptions.saveKtx2) {
+        if (convertOptions.bandHeight > 0) {
+            printf("Warning: KTX2 copies are not created in streaming mode\n");
+            convertOptions.saveKtx2 = false;
+        } else if (convertOptions.useCache) {
+            printf("Warning: Cache is not used with KTX2 copies\n");
+            convertOptions.useCache = false;
         }
+    }
 
-        size_t index = textures.size();
-
-        json baseColorTexture = json::object();
-        baseColorTexture["index"] = index;
-
-        pbrMetallicRoughness["baseColorTexture"] = baseColorTexture;
+    // A shared glTF is saved, after all materials of the folder are packed
 
-        if (!writeOpacity) {
-            // Do nothing
-        } else {
-            material["alphaMode"] = "MASK";
-            material["doubleSided"] = true;
+    if (batchOptions.splitMode == SPLIT_MODE_SHARED) {
+        if (convertOptions.lodCount > 0) {
+            printf("Warning: Levels of detail are not created for a shared glTF\n");
+            convertOptions.lodCount = 0;
+        }
+        if (convertOptions.useCache) {
+            printf("Warning: Cache is not used for a shared glTF\n");
+            convertOptions.useCache = false;
         }
+    }
 
-        json texture = json::object();
-        texture["source"] = index;
-        textures.push_back(texture);
+    // A binary glTF embeds its images, so there is nothing to share
 
-        json image = json::object();
-        image["uri"] = imagePath;
-        images.push_back(image);
+    std::unique_ptr<OutputRegistry> outputRegistry;
+    if (dedupMode != DEDUP_MODE_OFF && !convertOptions.saveBinary) {
+        outputRegistry.reset(new OutputRegistry(dedupMode));
+        convertOptions.outputRegistry = outputRegistry.get();
     }
 
-    if (writeMetallic || writeRoughness || writeOcclusion) {
-        std::string imagePath = stem + "_metallicRoughness.png";
-        if (!stbi_write_png(imagePath.c_str(), metallicRoughnessImage.width, metallicRoughnessImage.height, metallicRoughnessImage.channels, metallicRoughnessImage.pixels.data(), 0)) {
-            printf("Error: Could not save image '%s'\n", imagePath.c_str());
+    // Outputs are written by a writer stage, so encoding continues while the files are written. The server keeps its outputs
+    // in memory and standard output is written directly
+
+    if (!convertOptions.outputFolder.empty()) {
+        std::error_code errorCode;
+        fs::create_directories(convertOptions.outputFolder, errorCode);
+        if (errorCode) {
+            printf("Error: Could not create output folder '%s'\n", convertOptions.outputFolder.c_str());
 
             return -1;
         }
+    }
+
+    std::unique_ptr<OutputWriter> outputWriter;
+    if (!writeStandardOutput && !serveJobs) {
+        uint32_t workerCount = (batchOptions.workerCount > 0) ? batchOptions.workerCount : std::max(std::thread::hardware_concurrency(), 1u);
 
-        size_t index = textures.size();
+        outputWriter.reset(new OutputWriter(2 * workerCount, syncFiles));
+        convertOptions.outputWriter = outputWriter.get();
+    }
 
-        json metallicRoughnessTexture = json::object();
-        metallicRoughnessTexture["index"] = index;
+    // Materials of a batch or a split folder are admitted by the estimate of their working set, so large materials are converted
+    // with fewer materials next to them. Freed image buffers are cached next to them, so the cache gets a quarter of the budget
 
-        if (!writeMetallic) {
-            pbrMetallicRoughness["metallicFactor"] = defaultMetallicFactor;
-        }
-        if (!writeRoughness) {
-            pbrMetallicRoughness["roughnessFactor"] = defaultRoughnessFactor;
-        }
+    std::unique_ptr<MemoryBudget> memoryBudget;
+    if (memoryBudgetSize > 0) {
+        BufferPool& bufferPool = getImageBufferPool();
 
-        pbrMetallicRoughness["metallicRoughnessTexture"] = metallicRoughnessTexture;
+        uint64_t cacheSize = std::min(memoryBudgetSize / 4, static_cast<uint64_t>(bufferPool.getMaximumCachedBytes()));
+        bufferPool.setMaximumCachedBytes(static_cast<size_t>(cacheSize));
 
-        if (!writeOcclusion) {
-            // Do nothing
-        } else {
-            json occlusionTexture = json::object();
-            occlusionTexture["index"] = index;
+        memoryBudget.reset(new MemoryBudget(memoryBudgetSize - cacheSize, &bufferPool));
+        convertOptions.memoryBudget = memoryBudget.get();
+    }
 
-            material["occlusionTexture"] = occlusionTexture;
-        }
+    // Spans are only recorded, if they are printed or saved. A server does not finish, so its spans would only accumulate
 
-        json texture = json::object();
-        texture["source"] = index;
-        textures.push_back(texture);
+    if (serveJobs && (printStats || !tracePath.empty())) {
+        printf("Error: Statistics and traces are not available in server mode\n");
 
-        json image = json::object();
-        image["uri"] = imagePath;
-        images.push_back(image);
+        return -1;
     }
 
-    if (writeNormal) {
-        std::string imagePath = stem + "_normal";
-        if (keepNormalImageData) {
-            imagePath += normalImageRawExtension;
+    if (printStats || !tracePath.empty()) {
+        enableTrace();
+    }
 
-            if (!saveFile(normalImageRaw, imagePath)) {
-                printf("Error: Could not save image raw '%s'\n", imagePath.c_str());
+    //
 
-                return -1;
-            }
-        } else {
-            imagePath += ".png";
+    std::string path = argv[1];
 
-            if (!stbi_write_png(imagePath.c_str(), normalImage.width, normalImage.height, normalImage.channels, normalImage.pixels.data(), 0)) {
-                printf("Error: Could not save image '%s'\n", imagePath.c_str());
+    std::error_code errorCode;
+    // A file is a folder list, unless it is an archive, which is converted like a folder
+    bool list = fs::is_regular_file(path, errorCode) && !isArchivePath(path);
 
-                return -1;
-            }
-        }
-
-        size_t index = textures.size();
+    if (!tracePath.empty()) {
+        tracePath = fs::absolute(tracePath, errorCode).generic_string();
+    }
 
-        json normalTexture = json::object();
-        normalTexture["index"] = index;
+    if (writeStandardOutput) {
+        if (list || batch || serveJobs || batchOptions.splitMode != SPLIT_MODE_OFF) {
+            printf("Error: Binary glTF can only be written to standard output for one material\n");
 
-        material["normalTexture"] = normalTexture;
+            return -1;
+        }
 
-        json texture = json::object();
-        texture["source"] = index;
-        textures.push_back(texture);
+        // Messages are moved to standard error, so standard output only contains the binary glTF
+        convertOptions.outputDescriptor = redirectStandardOutput();
+        if (convertOptions.outputDescriptor < 0) {
+            printf("Error: Could not redirect standard output\n");
 
-        json image = json::object();
-        image["uri"] = imagePath;
-        images.push_back(image);
+            return -1;
+        }
     }
 
-    if (writeEmissive) {
-        std::string imagePath = stem + "_emissive";
-        if (keepEmissiveImageData) {
-            imagePath += emissiveImageRawExtension;
+    bool result = false;
 
-            if (!saveFile(emissiveImageRaw, imagePath)) {
-                printf("Error: Could not save image raw '%s'\n", imagePath.c_str());
+    if (serveJobs) {
+        serveOptions.syncFiles = syncFiles;
 
-                return -1;
-            }
-        } else {
-            imagePath += ".png";
-
-            if (!stbi_write_png(imagePath.c_str(), emissiveImage.width, emissiveImage.height, emissiveImage.channels, emissiveImage.pixels.data(), 0)) {
-                printf("Error: Could not save image '%s'\n", imagePath.c_str());
+        ThreadPool threadPool(batchOptions.workerCount);
 
-                return -1;
-            }
+        result = serve(serveOptions, convertOptions, threadPool);
+    } else if (list) {
+        // A file is a list of material folders
+        std::vector<std::string> folders;
+        if (!loadFolderList(folders, path)) {
+            return -1;
         }
 
-        size_t index = textures.size();
-
-        json emissiveTexture = json::object();
-        emissiveTexture["index"] = index;
+        result = convertBatch(folders, convertOptions, batchOptions);
+    } else if (batch) {
+        std::vector<std::string> folders;
+        if (!gatherMaterialFolders(folders, path)) {
+            return -1;
+        }
 
-        material["emissiveTexture"] = emissiveTexture;
+        batchOptions.rootFolder = path;
 
-        json emissiveFactor = json::array();
-        emissiveFactor.push_back(1.0f);
-        emissiveFactor.push_back(1.0f);
-        emissiveFactor.push_back(1.0f);
-        material["emissiveFactor"] = emissiveFactor;
+        result = convertBatch(folders, convertOptions, batchOptions);
+    } else if (batchOptions.splitMode != SPLIT_MODE_OFF) {
+        // The materials of one flat folder are reported like a batch
+        result = convertBatch({ path }, convertOptions, batchOptions);
+    } else {
+        ThreadPool threadPool(batchOptions.workerCount);
 
-        json texture = json::object();
-        texture["source"] = index;
-        textures.push_back(texture);
+        ConvertResult convertResult;
+        try {
+            result = convertMaterial(convertResult, path, convertOptions, threadPool);
+        } catch (const std::exception& exception) {
+            printf("Error: %s\n", exception.what());
 
-        json image = json::object();
-        image["uri"] = imagePath;
-        images.push_back(image);
+            result = false;
+        }
     }
 
-    material["name"] = stem;
-
-    material["pbrMetallicRoughness"] = pbrMetallicRoughness;
-    materials.push_back(material);
-    glTF["materials"] = materials;
+    // Failed conversions are recorded as well, so they are output in any case
 
-    if (textures.size() > 0) {
-        glTF["textures"] = textures;
-    }
-    if (images.size() > 0) {
-        glTF["images"] = images;
+    if (printStats) {
+        printTraceStats();
     }
 
-    //
-
-    std::string savename = stem + ".gltf";
+    if (!tracePath.empty()) {
+        if (!saveTrace(tracePath)) {
+            printf("Error: Could not save '%s'\n", tracePath.c_str());
 
-    if (!saveFile(glTF.dump(3), savename)) {
-        printf("Error: Could not save '%s'\n", savename.c_str());
+            return -1;
+        }
 
-        return -1;
+        printf("Info: Saved trace '%s'\n", tracePath.c_str());
     }
 
-    printf("Success: Converted to '%s'\n", savename.c_str());
-
-    return 0;
+    return result ? 0 : -1;
 }